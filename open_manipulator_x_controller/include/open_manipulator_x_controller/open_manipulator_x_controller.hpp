@@ -19,11 +19,19 @@
 #ifndef OPEN_MANIPULATOR_X_CONTROLLER_HPP
 #define OPEN_MANIPULATOR_X_CONTROLLER_HPP
 
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
+#include <functional>
+#include <future>
 #include <memory>
+#include <pthread.h>
+#include <thread>
+#include <time.h>
 #include <unistd.h>
 
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
 #include "geometry_msgs/msg/pose_stamped.hpp"
 #include <rclcpp/rclcpp.hpp>
 #include "sensor_msgs/msg/joint_state.hpp"
@@ -40,22 +48,128 @@
 #include "open_manipulator_msgs/srv/get_joint_position.hpp"
 #include "open_manipulator_msgs/srv/get_kinematics_pose.hpp"
 #include "open_manipulator_msgs/msg/open_manipulator_state.hpp"
+#include "open_manipulator_x_libs/grasp_detector.hpp"
 #include "open_manipulator_x_libs/open_manipulator_x.hpp"
+#include "open_manipulator_x_controller/realtime_thread.hpp"
+#include "open_manipulator_x_controller/seqlock.hpp"
+#include "open_manipulator_x_controller/spsc_queue.hpp"
+#include "open_manipulator_x_controller/telemetry_recorder.hpp"
 
 namespace open_manipulator_x_controller
 {
+#define SNAPSHOT_JOINT_SIZE 4
+#define SNAPSHOT_TOOL_SIZE 1
+
+// Everything the publishers need from one control tick
+typedef struct
+{
+  double time;
+  bool is_moving;
+  bool is_actuator_enabled;
+  double joint_position[SNAPSHOT_JOINT_SIZE];
+  double joint_velocity[SNAPSHOT_JOINT_SIZE];
+  double joint_effort[SNAPSHOT_JOINT_SIZE];
+  double tool_position[SNAPSHOT_TOOL_SIZE];
+  double tool_velocity[SNAPSHOT_TOOL_SIZE];
+  double tool_effort[SNAPSHOT_TOOL_SIZE];
+  double tool_pose_position[SNAPSHOT_TOOL_SIZE][3];
+  double tool_pose_orientation[SNAPSHOT_TOOL_SIZE][4];   // w, x, y, z
+  uint32_t collision_count;   // setpoints dropped by the collision check
+  uint8_t collision_link[2];  // pair of the last one
+  uint8_t grasp_state;        // GRASP_STATE_*
+  uint8_t grasp_event;        // last GRASP_EVENT_*
+  uint32_t grasp_event_count;
+} StateSnapshot;
+
+#define STREAM_BUFFER_SIZE 64
+
+// One streamed joint setpoint, handed from the subscribers to the control loop.
+// Pose setpoints are solved to joints in their callback before they are queued
+typedef struct
+{
+  bool replace;             // first point of a new message: drops the points not started yet
+  double time_from_start;   // unit: s, from the reception
+  bool joint_given[SNAPSHOT_JOINT_SIZE];
+  double joint_position[SNAPSHOT_JOINT_SIZE];
+  double joint_velocity[SNAPSHOT_JOINT_SIZE];
+  double joint_acceleration[SNAPSHOT_JOINT_SIZE];
+  bool tool_given;
+  double tool_position;
+} Setpoint;
+
+#define LOOP_STAGE_PERIOD LOOP_STAGE_SIZE   // time between two process calls (executor / thread wake-up)
+#define COMMAND_TIMEOUT_CYCLES 5   // control periods a service waits for the loop to take its command
+
+// Loop timing of one diagnostics period
+typedef struct
+{
+  loop_timing::Statistics stage[LOOP_STAGE_SIZE + 1];
+} LoopTimingSnapshot;
+
 class OpenManipulatorXController : public rclcpp::Node
 {
  public:
   OpenManipulatorXController(std::string usb_port, std::string baud_rate);
+  // One arm of a multi-arm process: with shared_bus the owner of the bus drives control_step
+  OpenManipulatorXController(
+    std::string usb_port,
+    std::string baud_rate,
+    std::vector<uint8_t> dxl_id,
+    dynamixel::DynamixelBus *shared_bus,
+    std::string node_name,
+    std::string name_space);
   virtual ~OpenManipulatorXController();
 
+  // Runs the queued commands, then one control cycle
+  void control_step(double time);
+  // control_period parameter of this arm (unit: s), the period control_step has to be called at
+  double get_control_period() const;
+
  private:  
   /*****************************************************************************
   ** Parameters
   *****************************************************************************/
   bool sim_;
   double control_period_;
+  double publish_period_;
+  double joint_states_publish_period_;
+  double kinematics_pose_publish_period_;
+  double states_publish_period_;
+  std::string kinematics_solver_;
+  bool precompute_task_trajectory_;
+  std::string dxl_transfer_mode_;
+  bool dxl_pipeline_;
+  bool dxl_warm_start_;
+  bool dxl_baud_rate_rewrite_;
+  int dxl_max_retry_;
+  double dxl_retry_budget_;
+  bool use_control_thread_;
+  int control_thread_priority_;
+  int control_thread_cpu_;
+  bool externally_driven_;
+  bool enable_loop_timing_;
+  double diagnostics_period_;
+  double stream_setpoint_time_;
+  std::string reachability_map_file_;
+  int ik_num_seeds_;
+  double ik_deadline_;
+  bool ik_prefer_closest_;
+  bool time_optimal_trajectory_;
+  std::vector<double> joint_max_velocity_;
+  std::vector<double> joint_max_acceleration_;
+  std::vector<double> joint_max_jerk_;
+  bool blend_trajectory_;
+  bool collision_check_;
+  double collision_padding_;
+  double ground_height_;
+  std::vector<double> collision_boxes_;
+  bool simulated_actuator_;
+  double sim_time_scale_;
+  double sim_read_latency_;
+  double sim_write_latency_;
+  std::string telemetry_file_;
+  int telemetry_capacity_;
+  grasp::GraspOption grasp_option_;
 
   /*****************************************************************************
   ** Variables
@@ -63,6 +177,19 @@ class OpenManipulatorXController : public rclcpp::Node
   // Robotis_manipulator related 
   OpenManipulatorX open_manipulator_x_;
 
+  // Control time of the simulated actuators, advanced by control_period every cycle
+  simulation::VirtualClock virtual_clock_;
+
+  // Written by the control loop once per tick, read by the publishers
+  SeqLock<StateSnapshot> state_snapshot_;
+
+  // Fed with the gripper values of every tick in update_state_snapshot
+  grasp::GraspDetector grasp_detector_;
+  uint8_t grasp_event_;
+  uint32_t grasp_event_count_;
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> tool_names_;
+
   /*****************************************************************************
   ** Init Functions
   *****************************************************************************/
@@ -77,9 +204,68 @@ class OpenManipulatorXController : public rclcpp::Node
   rclcpp::TimerBase::SharedPtr process_timer_;
   rclcpp::TimerBase::SharedPtr publish_timer_;
 
+  // Publishers run every n-th publish_callback
+  uint32_t publish_tick_;
+  uint32_t joint_states_decimation_;
+  uint32_t kinematics_pose_decimation_;
+  uint32_t states_decimation_;
+  uint32_t reported_collision_count_;
+  uint32_t reported_grasp_event_count_;
+
   void process_callback(); 
+  double get_wall_control_period() const;
   void publish_callback();  
   void process(double time);
+  void update_state_snapshot(double time);
+  // Measured joints of the last control cycle, to plan on outside the loop
+  JointWaypoint get_snapshot_joint_value() const;
+
+  /*****************************************************************************
+  ** Loop Timing and Bus Diagnostics
+  *****************************************************************************/
+  rclcpp::TimerBase::SharedPtr diagnostics_timer_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub_;
+
+  loop_timing::StageTimer period_timer_;
+  std::chrono::steady_clock::time_point last_process_time_;
+  double last_period_;
+
+  // Raw record of every control cycle, written by the control loop
+  TelemetryRecorder telemetry_recorder_;
+  void record_telemetry(double time);
+  uint32_t loop_timing_tick_;
+  SeqLock<LoopTimingSnapshot> loop_timing_snapshot_;
+
+  void update_loop_timing();
+  void diagnostics_callback();
+
+  // Bus errors up to the last diagnostics_callback
+  std::vector<uint8_t> dxl_id_;
+  dynamixel::BusErrorCounter reported_bus_error_counter_;
+
+  /*****************************************************************************
+  ** Control Thread
+  *****************************************************************************/
+  // Work handed from the ROS callbacks to the control loop. Whichever side sets
+  // taken first owns the command: the loop runs it, or the caller cancels it
+  typedef struct
+  {
+    std::function<bool()> run;
+    std::shared_ptr<std::promise<bool>> result;
+    std::shared_ptr<std::atomic<bool>> taken;
+  } ControlCommand;
+
+  std::thread control_thread_;
+  std::atomic<bool> control_thread_running_;
+  SPSCQueue<ControlCommand, 32> command_queue_;
+
+  void start_control_thread();
+  void stop_control_thread();
+  void control_thread_loop();
+  // Runs command on the control loop (or right away without the control thread) and returns its result
+  bool run_command(std::function<bool()> command);
+  // Blend toward goal_pose with its IK solved by the caller, only the blend runs on the loop
+  bool run_blended_task_command(Name tool_name, KinematicPose goal_pose, double path_time);
 
   /*****************************************************************************
   ** ROS Publishers, Callback Functions and Relevant Functions
@@ -88,18 +274,62 @@ class OpenManipulatorXController : public rclcpp::Node
   std::vector<rclcpp::Publisher<open_manipulator_msgs::msg::KinematicsPose>::SharedPtr> open_manipulator_x_kinematics_pose_pub_;
   rclcpp::Publisher<sensor_msgs::msg::JointState>::SharedPtr open_manipulator_x_joint_states_pub_;
   std::vector<rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr> gazebo_goal_joint_position_pub_;
+  rclcpp::Publisher<std_msgs::msg::String>::SharedPtr gripper_event_pub_;
+
+  // Sized once in init_publisher and refilled in place
+  open_manipulator_msgs::msg::OpenManipulatorState open_manipulator_x_states_msg_;
+  open_manipulator_msgs::msg::KinematicsPose kinematics_pose_msg_;
+  sensor_msgs::msg::JointState joint_states_msg_;
+  std_msgs::msg::Float64 gazebo_goal_joint_position_msg_;
 
-  void publish_open_manipulator_x_states();
-  void publish_kinematics_pose();
-  void publish_joint_states();
-  void publish_gazebo_command();
+  void publish_open_manipulator_x_states(const StateSnapshot &state);
+  void publish_kinematics_pose(const StateSnapshot &state);
+  void publish_joint_states(const StateSnapshot &state);
+  void publish_gazebo_command(const StateSnapshot &state);
+
+  // Publish a middleware loaned message when the publisher supports it (fixed-size types
+  // on a shared memory transport), otherwise the preallocated msg
+  template <typename MessageT, typename FillT>
+  void publish_message(const typename rclcpp::Publisher<MessageT>::SharedPtr &publisher, MessageT *msg, FillT fill)
+  {
+    if (publisher->can_loan_messages())
+    {
+      auto loaned_msg = publisher->borrow_loaned_message();
+      fill(&loaned_msg.get());
+      publisher->publish(std::move(loaned_msg));
+      return;
+    }
+    fill(msg);
+    publisher->publish(*msg);
+  }
 
   /*****************************************************************************
   ** ROS Subscribers and Callback Functions
   *****************************************************************************/
   rclcpp::Subscription<std_msgs::msg::String>::SharedPtr open_manipulator_x_option_sub_;
+  rclcpp::Subscription<trajectory_msgs::msg::JointTrajectory>::SharedPtr joint_trajectory_sub_;
+  rclcpp::Subscription<geometry_msgs::msg::PoseStamped>::SharedPtr kinematics_pose_setpoint_sub_;
 
   void open_manipulator_x_option_callback(const std_msgs::msg::String::SharedPtr msg);
+  void joint_trajectory_callback(const trajectory_msgs::msg::JointTrajectory::SharedPtr msg);
+  void kinematics_pose_setpoint_callback(const geometry_msgs::msg::PoseStamped::SharedPtr msg);
+
+  /*****************************************************************************
+  ** Setpoint Stream
+  *****************************************************************************/
+  // Filled by the subscribers without waiting on the control loop
+  SPSCQueue<Setpoint, STREAM_BUFFER_SIZE> setpoint_queue_;
+
+  // Owned by the control loop: points queued back to back, each started when
+  // the previous one is due, retargeted from the present goal so it blends
+  Setpoint stream_[STREAM_BUFFER_SIZE];
+  double stream_target_time_[STREAM_BUFFER_SIZE];
+  uint8_t stream_head_;
+  uint8_t stream_size_;
+  double stream_segment_end_time_;
+
+  void update_setpoint_stream(double time);
+  void start_stream_segment(const Setpoint &setpoint, double move_time);
 
   /*****************************************************************************
   ** ROS Servers and Callback Functions
@@ -118,6 +348,7 @@ class OpenManipulatorXController : public rclcpp::Node
   rclcpp::Service<open_manipulator_msgs::srv::SetJointPosition>::SharedPtr goal_tool_control_server_;
   rclcpp::Service<open_manipulator_msgs::srv::SetActuatorState>::SharedPtr set_actuator_state_server_;
   rclcpp::Service<open_manipulator_msgs::srv::SetDrawingTrajectory>::SharedPtr goal_drawing_trajectory_server_;
+  rclcpp::Service<open_manipulator_msgs::srv::SetKinematicsPose>::SharedPtr is_reachable_server_;
 
   void goal_joint_space_path_callback(
     const std::shared_ptr<open_manipulator_msgs::srv::SetJointPosition::Request> req,
@@ -161,6 +392,10 @@ class OpenManipulatorXController : public rclcpp::Node
   void goal_drawing_trajectory_callback(
     const std::shared_ptr<open_manipulator_msgs::srv::SetDrawingTrajectory::Request> req,
     const std::shared_ptr<open_manipulator_msgs::srv::SetDrawingTrajectory::Response> res);
+  // is_planned tells if the pose is in the reachability map, without solving IK
+  void is_reachable_callback(
+    const std::shared_ptr<open_manipulator_msgs::srv::SetKinematicsPose::Request> req,
+    const std::shared_ptr<open_manipulator_msgs::srv::SetKinematicsPose::Response> res);
 };
 }  // namespace open_manipulator_x_controller
 #endif //OPEN_MANIPULATOR_X_CONTROLLER_HPP
@@ -0,0 +1,78 @@
+/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef REALTIME_THREAD_HPP
+#define REALTIME_THREAD_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+namespace open_manipulator_x_controller
+{
+/*****************************************************************************
+** Real-Time Thread Helpers
+*****************************************************************************/
+// SCHED_FIFO priority (> 0) and CPU affinity (>= 0) of the calling thread, false if refused
+inline bool set_realtime_scheduling(int priority, int cpu)
+{
+  bool result = true;
+
+  if (priority > 0)
+  {
+    sched_param param;
+    param.sched_priority = priority;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) result = false;
+  }
+
+  if (cpu >= 0)
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) != 0) result = false;
+  }
+  return result;
+}
+
+inline double get_monotonic_time()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Sleep until the next absolute deadline, dropping the missed ones instead of catching up
+inline void wait_for_next_period(struct timespec *deadline, long period_ns)
+{
+  deadline->tv_nsec += period_ns;
+  while (deadline->tv_nsec >= 1000000000L)
+  {
+    deadline->tv_nsec -= 1000000000L;
+    deadline->tv_sec++;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec > deadline->tv_nsec))
+    *deadline = now;
+
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+}
+}  // namespace open_manipulator_x_controller
+#endif // REALTIME_THREAD_HPP
@@ -0,0 +1,73 @@
+/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace open_manipulator_x_controller
+{
+/*****************************************************************************
+** Sequence Lock
+*****************************************************************************/
+// One writer stores a POD value, any number of readers copy it out. Neither
+// side locks or allocates; a reader retries if the writer was in between.
+template <typename T>
+class SeqLock
+{
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+ public:
+  SeqLock() : sequence_(0)
+  {
+    std::memset(&value_, 0, sizeof(T));
+  }
+
+  void store(const T &value)
+  {
+    std::size_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);   // odd : write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(&value_, &value, sizeof(T));
+
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  void load(T *value) const
+  {
+    std::size_t before, after;
+    do
+    {
+      before = sequence_.load(std::memory_order_acquire);
+      std::memcpy(value, &value_, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+  }
+
+ private:
+  alignas(64) std::atomic<std::size_t> sequence_;
+  T value_;
+};
+}  // namespace open_manipulator_x_controller
+#endif // SEQLOCK_HPP
@@ -0,0 +1,70 @@
+/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace open_manipulator_x_controller
+{
+/*****************************************************************************
+** Lock-Free Single-Producer Single-Consumer Queue
+*****************************************************************************/
+// Fixed-capacity ring buffer. push() may only be called from one thread and
+// pop() from one other thread; neither blocks nor allocates.
+template <typename T, std::size_t Capacity>
+class SPSCQueue
+{
+ public:
+  SPSCQueue() : head_(0), tail_(0) {}
+
+  bool push(T &&item)
+  {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t next = (tail + 1) % (Capacity + 1);
+    if (next == head_.load(std::memory_order_acquire))
+      return false;  // full
+
+    buffer_[tail] = std::move(item);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T *item)
+  {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;  // empty
+
+    *item = std::move(buffer_[head]);
+    buffer_[head] = T();
+    head_.store((head + 1) % (Capacity + 1), std::memory_order_release);
+    return true;
+  }
+
+ private:
+  std::array<T, Capacity + 1> buffer_;
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+};
+}  // namespace open_manipulator_x_controller
+#endif // SPSC_QUEUE_HPP
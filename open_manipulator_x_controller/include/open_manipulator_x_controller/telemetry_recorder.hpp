@@ -0,0 +1,172 @@
+/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef TELEMETRY_RECORDER_HPP
+#define TELEMETRY_RECORDER_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace open_manipulator_x_controller
+{
+#define TELEMETRY_MAGIC      "OMXTLM1"
+#define TELEMETRY_VERSION    1
+#define TELEMETRY_AXIS_SIZE  5   // joint1 ~ joint4, gripper
+#define TELEMETRY_STAGE_SIZE 6   // LOOP_STAGE_* and the loop period
+
+// First 64 bytes of the file, little-endian as written by the host
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t record_size;
+  uint32_t capacity;       // records in the ring
+  uint32_t axis_size;
+  uint32_t stage_size;
+  uint8_t id[8];           // Dynamixel id of each axis
+  uint64_t record_count;   // records written so far, the newest is at (record_count - 1) % capacity
+  uint8_t reserved[16];
+} TelemetryHeader;
+
+// One control cycle
+typedef struct
+{
+  uint64_t sequence;                              // record_count after this record, 0 : never written
+  double time;                                    // control time (unit: s)
+  double goal_position[TELEMETRY_AXIS_SIZE];      // unit: rad (gripper: m)
+  double goal_velocity[TELEMETRY_AXIS_SIZE];
+  double present_position[TELEMETRY_AXIS_SIZE];
+  double present_velocity[TELEMETRY_AXIS_SIZE];
+  double present_current[TELEMETRY_AXIS_SIZE];    // effort as read (unit: mA on the Dynamixels)
+  double stage_time[TELEMETRY_STAGE_SIZE];        // unit: s
+} TelemetryRecord;
+
+static_assert(sizeof(TelemetryHeader) == 64, "TelemetryHeader layout changed");
+static_assert(sizeof(TelemetryRecord) == 264, "TelemetryRecord layout changed");
+
+/*****************************************************************************
+** Telemetry Recorder
+*****************************************************************************/
+// Ring of fixed size records in a memory-mapped file. The file is sized and
+// touched in open, so append is a copy into mapped memory: no system call, no
+// allocation. The kernel writes the pages back; the file stays after close.
+// scripts/read_telemetry converts it to CSV or Parquet.
+class TelemetryRecorder
+{
+ public:
+  TelemetryRecorder() : fd_(-1), map_(nullptr), map_size_(0), header_(nullptr), record_(nullptr), record_count_(0) {}
+  virtual ~TelemetryRecorder() { close(); }
+
+  bool open(const std::string &file_path, uint32_t capacity, const std::vector<uint8_t> &id)
+  {
+    close();
+    if (capacity == 0) return false;
+
+    fd_ = ::open(file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) return false;
+
+    map_size_ = sizeof(TelemetryHeader) + static_cast<size_t>(capacity) * sizeof(TelemetryRecord);
+    if (ftruncate(fd_, map_size_) != 0)
+    {
+      close();
+      return false;
+    }
+
+    map_ = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map_ == MAP_FAILED)
+    {
+      map_ = nullptr;
+      close();
+      return false;
+    }
+    std::memset(map_, 0, map_size_);   // fault every page in before the control loop writes
+
+    header_ = static_cast<TelemetryHeader *>(map_);
+    record_ = reinterpret_cast<TelemetryRecord *>(static_cast<uint8_t *>(map_) + sizeof(TelemetryHeader));
+    std::memcpy(header_->magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+    header_->version = TELEMETRY_VERSION;
+    header_->header_size = sizeof(TelemetryHeader);
+    header_->record_size = sizeof(TelemetryRecord);
+    header_->capacity = capacity;
+    header_->axis_size = TELEMETRY_AXIS_SIZE;
+    header_->stage_size = TELEMETRY_STAGE_SIZE;
+    for (uint8_t index = 0; index < id.size() && index < sizeof(header_->id); index++)
+      header_->id[index] = id.at(index);
+    record_count_ = 0;
+    return true;
+  }
+
+  void close()
+  {
+    if (map_ != nullptr)
+    {
+      msync(map_, map_size_, MS_ASYNC);
+      munmap(map_, map_size_);
+    }
+    if (fd_ >= 0) ::close(fd_);
+
+    fd_ = -1;
+    map_ = nullptr;
+    header_ = nullptr;
+    record_ = nullptr;
+  }
+
+  bool is_open() const
+  {
+    return map_ != nullptr;
+  }
+
+  void append(const TelemetryRecord &record)
+  {
+    if (map_ == nullptr) return;
+
+    TelemetryRecord *slot = &record_[record_count_ % header_->capacity];
+    record_count_++;
+
+    // Seqlock: the slot reads as never written while it is copied, so a reader
+    // that finds the same sequence before and after its copy has a whole record
+    const size_t payload = offsetof(TelemetryRecord, time);
+    __atomic_store_n(&slot->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    std::memcpy(reinterpret_cast<uint8_t *>(slot) + payload,
+                reinterpret_cast<const uint8_t *>(&record) + payload,
+                sizeof(TelemetryRecord) - payload);
+    __atomic_store_n(&slot->sequence, record_count_, __ATOMIC_RELEASE);
+
+    // A reader of the live file takes the records up to this count
+    __atomic_store_n(&header_->record_count, record_count_, __ATOMIC_RELEASE);
+  }
+
+ private:
+  int fd_;
+  void *map_;
+  size_t map_size_;
+  TelemetryHeader *header_;
+  TelemetryRecord *record_;
+  uint64_t record_count_;
+};
+}  // namespace open_manipulator_x_controller
+#endif // TELEMETRY_RECORDER_HPP
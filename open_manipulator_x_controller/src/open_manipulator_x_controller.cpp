@@ -19,12 +19,34 @@
 #include "open_manipulator_x_controller/open_manipulator_x_controller.hpp"
 
 using namespace std::placeholders;
-using namespace std::chrono_literals;
 
 namespace open_manipulator_x_controller
 {
 OpenManipulatorXController::OpenManipulatorXController(std::string usb_port, std::string baud_rate)
-: Node("open_manipulator_x_controller")
+: OpenManipulatorXController(usb_port, baud_rate, {11, 12, 13, 14, 15}, nullptr, "open_manipulator_x_controller", "")
+{
+}
+
+OpenManipulatorXController::OpenManipulatorXController(
+  std::string usb_port,
+  std::string baud_rate,
+  std::vector<uint8_t> dxl_id,
+  dynamixel::DynamixelBus *shared_bus,
+  std::string node_name,
+  std::string name_space)
+: Node(node_name, name_space),
+  externally_driven_(shared_bus != nullptr),
+  grasp_event_(GRASP_EVENT_NONE),
+  grasp_event_count_(0),
+  publish_tick_(0),
+  reported_collision_count_(0),
+  reported_grasp_event_count_(0),
+  last_period_(0.0),
+  loop_timing_tick_(0),
+  control_thread_running_(false),
+  stream_head_(0),
+  stream_size_(0),
+  stream_segment_end_time_(0.0)
 {
   /************************************************************
   ** Initialise ROS parameters
@@ -34,9 +56,60 @@ OpenManipulatorXController::OpenManipulatorXController(std::string usb_port, std
   /************************************************************
   ** Initialise variables
   ************************************************************/
-  open_manipulator_x_.init_open_manipulator_x(sim_, usb_port, baud_rate, control_period_);
+  if (sim_ && simulated_actuator_)
+    open_manipulator_x_.use_simulated_actuator(&virtual_clock_, sim_read_latency_, sim_write_latency_);
+  open_manipulator_x_.enable_warm_start(dxl_warm_start_);
+  open_manipulator_x_.enable_baud_rate_rewrite(dxl_baud_rate_rewrite_);
+  if (open_manipulator_x_.init_open_manipulator_x(sim_, usb_port, baud_rate, control_period_, dxl_id, kinematics_solver_, dxl_transfer_mode_, shared_bus) == false)
+  {
+    RCLCPP_ERROR(this->get_logger(), "Failed to initialize OpenManipulator-X on %s", usb_port.c_str());
+    rclcpp::shutdown();
+    return;
+  }
+  if (dxl_pipeline_ && sim_ == false && open_manipulator_x_.enable_bus_pipeline(true) == false)
+    RCLCPP_WARN(this->get_logger(), "dxl_pipeline needs a bus of its own, the bus transfers stay in series");
+  open_manipulator_x_.set_bus_retry_policy(static_cast<uint8_t>(dxl_max_retry_), dxl_retry_budget_);
+  dxl_id_ = dxl_id;
+  reported_bus_error_counter_ = dynamixel::BusErrorCounter();
+  if (!telemetry_file_.empty())
+  {
+    if (telemetry_recorder_.open(telemetry_file_, static_cast<uint32_t>(telemetry_capacity_), dxl_id))
+      RCLCPP_INFO(this->get_logger(), "Recording telemetry to %s (%d cycles)", telemetry_file_.c_str(), telemetry_capacity_);
+    else
+      RCLCPP_WARN(this->get_logger(), "Failed to open the telemetry file %s", telemetry_file_.c_str());
+  }
+  // The records carry the stage times of every cycle
+  open_manipulator_x_.enable_loop_timing(enable_loop_timing_ || telemetry_recorder_.is_open());
+  open_manipulator_x_.set_multi_start_ik_option(ik_num_seeds_, ik_deadline_, ik_prefer_closest_);
+  open_manipulator_x_.set_joint_limit(joint_max_velocity_, joint_max_acceleration_, joint_max_jerk_);
+  open_manipulator_x_.enable_time_optimal_trajectory(time_optimal_trajectory_);
+  if (!reachability_map_file_.empty())
+  {
+    if (open_manipulator_x_.load_reachability_map(reachability_map_file_))
+      RCLCPP_INFO(this->get_logger(), "Loaded the reachability map %s", reachability_map_file_.c_str());
+    else
+      RCLCPP_WARN(this->get_logger(), "Failed to load the reachability map %s", reachability_map_file_.c_str());
+  }
+  collision::CollisionChecker *collision_checker = open_manipulator_x_.get_collision_checker();
+  collision_checker->set_padding(collision_padding_);
+  collision_checker->set_ground_height(ground_height_);
+  // x_min, y_min, z_min, x_max, y_max, z_max of each box in the world frame
+  if (collision_boxes_.size() % 6 != 0)
+    RCLCPP_WARN(this->get_logger(), "collision_boxes needs 6 values per box, the last %zu are ignored", collision_boxes_.size() % 6);
+  for (size_t index = 0; index + 6 <= collision_boxes_.size(); index += 6)
+    collision_checker->add_box(
+      Eigen::Vector3d(collision_boxes_.at(index), collision_boxes_.at(index + 1), collision_boxes_.at(index + 2)),
+      Eigen::Vector3d(collision_boxes_.at(index + 3), collision_boxes_.at(index + 4), collision_boxes_.at(index + 5)));
+  open_manipulator_x_.enable_collision_check(collision_check_);
+  grasp_detector_.set_option(grasp_option_);
+  period_timer_.set_budget(1.5 * control_period_);
+
+  joint_names_ = open_manipulator_x_.getManipulator()->getAllActiveJointComponentName();
+  tool_names_ = open_manipulator_x_.getManipulator()->getAllToolComponentName();
+  update_state_snapshot(0.0);
 
   if (sim_ == false) RCLCPP_INFO(this->get_logger(), "Succeeded to Initialise OpenManipulator-X Controller");
+  else if (simulated_actuator_) RCLCPP_INFO(this->get_logger(), "Ready to Simulate OpenManipulator-X at %.1fx real time", sim_time_scale_);
   else RCLCPP_INFO(this->get_logger(), "Ready to Simulate OpenManipulator-X on Gazebo");
 
   /************************************************************
@@ -49,13 +122,24 @@ OpenManipulatorXController::OpenManipulatorXController(std::string usb_port, std
   /************************************************************
   ** Initialise ROS timers
   ************************************************************/
-  process_timer_ = this->create_wall_timer(10ms, std::bind(&OpenManipulatorXController::process_callback, this));
-  publish_timer_ = this->create_wall_timer(10ms, std::bind(&OpenManipulatorXController::publish_callback, this));  
+  if (externally_driven_) {}  // control_step is called by the thread of the shared bus
+  else if (use_control_thread_) start_control_thread();
+  else process_timer_ = this->create_wall_timer(
+    std::chrono::duration<double>(get_wall_control_period()), std::bind(&OpenManipulatorXController::process_callback, this));
+  publish_timer_ = this->create_wall_timer(
+    std::chrono::duration<double>(publish_period_), std::bind(&OpenManipulatorXController::publish_callback, this));
+  if (enable_loop_timing_ || sim_ == false)
+  {
+    diagnostics_timer_ = this->create_wall_timer(
+      std::chrono::duration<double>(diagnostics_period_), std::bind(&OpenManipulatorXController::diagnostics_callback, this));
+  }
 }
 
 OpenManipulatorXController::~OpenManipulatorXController()
 {
   RCLCPP_INFO(this->get_logger(), "OpenManipulator-X Controller Terminated");
+  stop_control_thread();
+  open_manipulator_x_.wait_bus_transfer();
   open_manipulator_x_.disableAllActuator();
 }
 
@@ -67,10 +151,120 @@ void OpenManipulatorXController::init_parameters()
   // Declare parameters that may be set on this node
   this->declare_parameter("sim");
   this->declare_parameter("control_period");
+  this->declare_parameter("publish_period");
+  this->declare_parameter("joint_states_publish_period");
+  this->declare_parameter("kinematics_pose_publish_period");
+  this->declare_parameter("states_publish_period");
+  this->declare_parameter("kinematics_solver");
+  this->declare_parameter("precompute_task_trajectory");
+  this->declare_parameter("dxl_transfer_mode");
+  this->declare_parameter("dxl_pipeline");
+  this->declare_parameter("dxl_warm_start");
+  this->declare_parameter("dxl_baud_rate_rewrite");
+  this->declare_parameter("dxl_max_retry");
+  this->declare_parameter("dxl_retry_budget");
+  this->declare_parameter("use_control_thread");
+  this->declare_parameter("control_thread_priority");
+  this->declare_parameter("control_thread_cpu");
+  this->declare_parameter("enable_loop_timing");
+  this->declare_parameter("diagnostics_period");
+  this->declare_parameter("stream_setpoint_time");
+  this->declare_parameter("reachability_map");
+  this->declare_parameter("ik_num_seeds");
+  this->declare_parameter("ik_deadline");
+  this->declare_parameter("ik_prefer_closest");
+  this->declare_parameter("time_optimal_trajectory");
+  this->declare_parameter("joint_max_velocity");
+  this->declare_parameter("joint_max_acceleration");
+  this->declare_parameter("joint_max_jerk");
+  this->declare_parameter("blend_trajectory");
+  this->declare_parameter("collision_check");
+  this->declare_parameter("collision_padding");
+  this->declare_parameter("ground_height");
+  this->declare_parameter("collision_boxes");
+  this->declare_parameter("simulated_actuator");
+  this->declare_parameter("sim_time_scale");
+  this->declare_parameter("sim_read_latency");
+  this->declare_parameter("sim_write_latency");
+  this->declare_parameter("telemetry_file");
+  this->declare_parameter("telemetry_capacity");
+  this->declare_parameter("grasp_current");
+  this->declare_parameter("grasp_release_current");
+  this->declare_parameter("grasp_stall_velocity");
+  this->declare_parameter("grasp_goal_tolerance");
+  this->declare_parameter("grasp_slip_distance");
+  this->declare_parameter("grasp_settle_time");
 
   // Get parameter from yaml
   this->get_parameter_or<bool>("sim", sim_, false);
   this->get_parameter_or<double>("control_period", control_period_, 0.010);
+  this->get_parameter_or<double>("publish_period", publish_period_, 0.010);
+  this->get_parameter_or<double>("joint_states_publish_period", joint_states_publish_period_, publish_period_);
+  this->get_parameter_or<double>("kinematics_pose_publish_period", kinematics_pose_publish_period_, publish_period_);
+  this->get_parameter_or<double>("states_publish_period", states_publish_period_, publish_period_);
+
+  // Nothing is published faster than once per control period
+  if (!(control_period_ > 0.0)) control_period_ = 0.010;
+  if (!(publish_period_ >= control_period_)) publish_period_ = control_period_;
+  if (!(joint_states_publish_period_ >= publish_period_)) joint_states_publish_period_ = publish_period_;
+  if (!(kinematics_pose_publish_period_ >= publish_period_)) kinematics_pose_publish_period_ = publish_period_;
+  if (!(states_publish_period_ >= publish_period_)) states_publish_period_ = publish_period_;
+
+  // Each publisher period is rounded to a multiple of publish_period
+  auto decimation = [this](double period) -> uint32_t
+  {
+    long ratio = std::lround(period / publish_period_);
+    return (ratio < 1) ? 1 : static_cast<uint32_t>(ratio);
+  };
+  joint_states_decimation_ = decimation(joint_states_publish_period_);
+  kinematics_pose_decimation_ = decimation(kinematics_pose_publish_period_);
+  states_decimation_ = decimation(states_publish_period_);
+  this->get_parameter_or<std::string>("kinematics_solver", kinematics_solver_, KINEMATICS_SOLVER_OM_CHAIN_ANALYTIC);
+  this->get_parameter_or<bool>("precompute_task_trajectory", precompute_task_trajectory_, false);
+  this->get_parameter_or<std::string>("dxl_transfer_mode", dxl_transfer_mode_, "sync");
+  this->get_parameter_or<bool>("dxl_pipeline", dxl_pipeline_, false);
+  this->get_parameter_or<bool>("dxl_warm_start", dxl_warm_start_, false);
+  this->get_parameter_or<bool>("dxl_baud_rate_rewrite", dxl_baud_rate_rewrite_, false);
+  this->get_parameter_or<int>("dxl_max_retry", dxl_max_retry_, 1);
+  this->get_parameter_or<double>("dxl_retry_budget", dxl_retry_budget_, 0.3 * control_period_);
+  this->get_parameter_or<bool>("use_control_thread", use_control_thread_, false);
+  this->get_parameter_or<int>("control_thread_priority", control_thread_priority_, 0);
+  this->get_parameter_or<int>("control_thread_cpu", control_thread_cpu_, -1);
+  this->get_parameter_or<bool>("enable_loop_timing", enable_loop_timing_, false);
+  this->get_parameter_or<double>("diagnostics_period", diagnostics_period_, 1.0);
+  this->get_parameter_or<double>("stream_setpoint_time", stream_setpoint_time_, 0.1);
+  this->get_parameter_or<std::string>("reachability_map", reachability_map_file_, "");
+  this->get_parameter_or<int>("ik_num_seeds", ik_num_seeds_, 8);
+  this->get_parameter_or<double>("ik_deadline", ik_deadline_, -1.0);
+  this->get_parameter_or<bool>("ik_prefer_closest", ik_prefer_closest_, false);
+  this->get_parameter_or<bool>("time_optimal_trajectory", time_optimal_trajectory_, false);
+  this->get_parameter_or<std::vector<double>>("joint_max_velocity", joint_max_velocity_, std::vector<double>(4, 4.8));
+  this->get_parameter_or<std::vector<double>>("joint_max_acceleration", joint_max_acceleration_, std::vector<double>(4, 8.0));
+  this->get_parameter_or<std::vector<double>>("joint_max_jerk", joint_max_jerk_, std::vector<double>(4, 80.0));
+  this->get_parameter_or<bool>("blend_trajectory", blend_trajectory_, false);
+  this->get_parameter_or<bool>("collision_check", collision_check_, false);
+  this->get_parameter_or<double>("collision_padding", collision_padding_, 0.005);
+  this->get_parameter_or<double>("ground_height", ground_height_, 0.0);
+  this->get_parameter_or<std::vector<double>>("collision_boxes", collision_boxes_, std::vector<double>());
+  this->get_parameter_or<bool>("simulated_actuator", simulated_actuator_, false);
+  this->get_parameter_or<double>("sim_time_scale", sim_time_scale_, 1.0);
+  this->get_parameter_or<double>("sim_read_latency", sim_read_latency_, 0.0015);
+  this->get_parameter_or<double>("sim_write_latency", sim_write_latency_, 0.0005);
+  this->get_parameter_or<std::string>("telemetry_file", telemetry_file_, "");
+  this->get_parameter_or<int>("telemetry_capacity", telemetry_capacity_, 60000);
+  grasp_option_ = grasp_detector_.get_option();
+  this->get_parameter_or<double>("grasp_current", grasp_option_.grasp_current, grasp_option_.grasp_current);
+  this->get_parameter_or<double>("grasp_release_current", grasp_option_.release_current, grasp_option_.release_current);
+  this->get_parameter_or<double>("grasp_stall_velocity", grasp_option_.stall_velocity, grasp_option_.stall_velocity);
+  this->get_parameter_or<double>("grasp_goal_tolerance", grasp_option_.goal_tolerance, grasp_option_.goal_tolerance);
+  this->get_parameter_or<double>("grasp_slip_distance", grasp_option_.slip_distance, grasp_option_.slip_distance);
+  this->get_parameter_or<double>("grasp_settle_time", grasp_option_.settle_time, grasp_option_.settle_time);
+  if (sim_ == false) simulated_actuator_ = false;
+  if (sim_time_scale_ <= 0.0) sim_time_scale_ = 1.0;
+  if (telemetry_capacity_ < 1) telemetry_capacity_ = 1;
+  if (dxl_max_retry_ < 0) dxl_max_retry_ = 0;
+  if (dxl_max_retry_ > 255) dxl_max_retry_ = 255;
+  if (ik_deadline_ < 0.0) ik_deadline_ = 0.5 * control_period_;
 }
 
 void OpenManipulatorXController::init_publisher()
@@ -80,10 +274,14 @@ void OpenManipulatorXController::init_publisher()
   // Publish States
   open_manipulator_x_states_pub_ = this->create_publisher<open_manipulator_msgs::msg::OpenManipulatorState>("states", qos);
 
+  // Publish Loop Timing and Bus Errors
+  if (enable_loop_timing_ || sim_ == false)
+    diagnostics_pub_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("diagnostics", qos);
+
   // Publish Joint States
   auto tools_name = open_manipulator_x_.getManipulator()->getAllToolComponentName();
 
-  if (sim_ == false) // for actual robot
+  if (sim_ == false || simulated_actuator_) // for actual or simulated actuators
   {
     open_manipulator_x_joint_states_pub_ = this->create_publisher<sensor_msgs::msg::JointState>("joint_states", qos);
   }
@@ -100,12 +298,29 @@ void OpenManipulatorXController::init_publisher()
     }
   }
   
+  // Publish Gripper Events (grasped, empty, slipped)
+  gripper_event_pub_ = this->create_publisher<std_msgs::msg::String>("gripper_event", qos);
+
   // Publish Kinematics Pose
   for (auto const & name:tools_name)
   {
     auto pb = this->create_publisher<open_manipulator_msgs::msg::KinematicsPose>("kinematics_pose", qos);
     open_manipulator_x_kinematics_pose_pub_.push_back(pb);
   }
+
+  // Preallocate the joint states once; only values and stamp change per publish
+  joint_states_msg_.name.clear();
+  for (uint8_t i = 0; i < SNAPSHOT_JOINT_SIZE && i < joint_names_.size(); i ++)
+    joint_states_msg_.name.push_back(joint_names_.at(i));
+  for (uint8_t i = 0; i < SNAPSHOT_TOOL_SIZE && i < tool_names_.size(); i ++)
+    joint_states_msg_.name.push_back(tool_names_.at(i));
+  joint_states_msg_.position.assign(joint_states_msg_.name.size(), 0.0);
+  joint_states_msg_.velocity.assign(joint_states_msg_.name.size(), 0.0);
+  joint_states_msg_.effort.assign(joint_states_msg_.name.size(), 0.0);
+
+  // Reserve the longest state strings so switching between them doesn't reallocate
+  open_manipulator_x_states_msg_.open_manipulator_moving_state.reserve(16);
+  open_manipulator_x_states_msg_.open_manipulator_actuator_state.reserve(32);
 }
 
 void OpenManipulatorXController::init_subscriber()
@@ -114,6 +329,10 @@ void OpenManipulatorXController::init_subscriber()
 
   open_manipulator_x_option_sub_ = this->create_subscription<std_msgs::msg::String>(
     "option", qos, std::bind(&OpenManipulatorXController::open_manipulator_x_option_callback, this, _1));
+  joint_trajectory_sub_ = this->create_subscription<trajectory_msgs::msg::JointTrajectory>(
+    "joint_trajectory", qos, std::bind(&OpenManipulatorXController::joint_trajectory_callback, this, _1));
+  kinematics_pose_setpoint_sub_ = this->create_subscription<geometry_msgs::msg::PoseStamped>(
+    "kinematics_pose_setpoint", qos, std::bind(&OpenManipulatorXController::kinematics_pose_setpoint_callback, this, _1));
 }
 
 void OpenManipulatorXController::init_server()
@@ -146,6 +365,8 @@ void OpenManipulatorXController::init_server()
     "set_actuator_state", std::bind(&OpenManipulatorXController::set_actuator_state_callback, this, _1, _2));
   goal_drawing_trajectory_server_ = this->create_service<open_manipulator_msgs::srv::SetDrawingTrajectory>(
     "goal_drawing_trajectory", std::bind(&OpenManipulatorXController::goal_drawing_trajectory_callback, this, _1, _2));
+  is_reachable_server_ = this->create_service<open_manipulator_msgs::srv::SetKinematicsPose>(
+    "is_reachable", std::bind(&OpenManipulatorXController::is_reachable_callback, this, _1, _2));
 }
 
 /*****************************************************************************
@@ -154,7 +375,85 @@ void OpenManipulatorXController::init_server()
 void OpenManipulatorXController::open_manipulator_x_option_callback(const std_msgs::msg::String::SharedPtr msg)
 {
   if (msg->data == "print_open_manipulator_x_setting")
-    open_manipulator_x_.printManipulatorSetting();
+  {
+    run_command([this]() -> bool
+    {
+      open_manipulator_x_.printManipulatorSetting();
+      return true;
+    });
+  }
+}
+
+void OpenManipulatorXController::joint_trajectory_callback(const trajectory_msgs::msg::JointTrajectory::SharedPtr msg)
+{
+  uint32_t dropped = 0;
+
+  for (uint32_t point = 0; point < msg->points.size(); point ++)
+  {
+    const trajectory_msgs::msg::JointTrajectoryPoint &p = msg->points.at(point);
+    Setpoint setpoint = {};
+    setpoint.replace = (point == 0);
+    setpoint.time_from_start = p.time_from_start.sec + p.time_from_start.nanosec * 1e-9;
+
+    for (uint8_t i = 0; i < msg->joint_names.size() && i < p.positions.size(); i ++)
+    {
+      for (uint8_t j = 0; j < SNAPSHOT_JOINT_SIZE && j < joint_names_.size(); j ++)
+      {
+        if (msg->joint_names.at(i) != joint_names_.at(j)) continue;
+        setpoint.joint_given[j] = true;
+        setpoint.joint_position[j] = p.positions.at(i);
+        if (i < p.velocities.size()) setpoint.joint_velocity[j] = p.velocities.at(i);
+        if (i < p.accelerations.size()) setpoint.joint_acceleration[j] = p.accelerations.at(i);
+      }
+      if (tool_names_.size() != 0 && msg->joint_names.at(i) == tool_names_.at(0))
+      {
+        setpoint.tool_given = true;
+        setpoint.tool_position = p.positions.at(i);
+      }
+    }
+
+    if (setpoint_queue_.push(std::move(setpoint)) == false) dropped++;
+  }
+
+  if (dropped != 0)
+    RCLCPP_WARN(this->get_logger(), "Setpoint buffer is full, dropped %u of %zu points", dropped, msg->points.size());
+}
+
+void OpenManipulatorXController::kinematics_pose_setpoint_callback(const geometry_msgs::msg::PoseStamped::SharedPtr msg)
+{
+  if (tool_names_.size() == 0) return;
+
+  KinematicPose target_pose;
+  target_pose.position[0] = msg->pose.position.x;
+  target_pose.position[1] = msg->pose.position.y;
+  target_pose.position[2] = msg->pose.position.z;
+
+  Eigen::Quaterniond q(msg->pose.orientation.w,
+                       msg->pose.orientation.x,
+                       msg->pose.orientation.y,
+                       msg->pose.orientation.z);
+  target_pose.orientation = math::convertQuaternionToRotationMatrix(q);
+
+  // IK is solved here like run_blended_task_command, the control loop only gets joint setpoints
+  std::vector<double> goal_joint_position;
+  if (!open_manipulator_x_.plan_blended_task_trajectory(tool_names_.at(0), target_pose, get_snapshot_joint_value(), &goal_joint_position))
+  {
+    RCLCPP_WARN(this->get_logger(), "Pose setpoint (%.3f, %.3f, %.3f) is not reachable, dropped",
+      target_pose.position[0], target_pose.position[1], target_pose.position[2]);
+    return;
+  }
+
+  Setpoint setpoint = {};
+  setpoint.replace = true;
+  setpoint.time_from_start = stream_setpoint_time_;
+  for (uint8_t j = 0; j < SNAPSHOT_JOINT_SIZE && j < joint_names_.size() && j < goal_joint_position.size(); j ++)
+  {
+    setpoint.joint_given[j] = true;
+    setpoint.joint_position[j] = goal_joint_position.at(j);
+  }
+
+  if (setpoint_queue_.push(std::move(setpoint)) == false)
+    RCLCPP_WARN(this->get_logger(), "Setpoint buffer is full, dropped the pose setpoint");
 }
 
 /*****************************************************************************
@@ -169,9 +468,19 @@ void OpenManipulatorXController::goal_joint_space_path_callback(
   for (uint8_t i = 0; i < req->joint_position.joint_name.size(); i ++)
     target_angle.push_back(req->joint_position.position.at(i));
 
-  open_manipulator_x_.makeJointTrajectory(target_angle, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, target_angle, req]() -> bool
+  {
+    if (blend_trajectory_)
+    {
+      return open_manipulator_x_.make_blended_joint_trajectory(target_angle, req->path_time);
+    }
+    if (time_optimal_trajectory_)
+    {
+      return open_manipulator_x_.make_time_optimal_joint_trajectory(target_angle);
+    }
+    open_manipulator_x_.makeJointTrajectory(target_angle, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -191,9 +500,24 @@ void OpenManipulatorXController::goal_joint_space_path_to_kinematics_pose_callba
 
   target_pose.orientation = math::convertQuaternionToRotationMatrix(q);
 
-  open_manipulator_x_.makeJointTrajectory(req->end_effector_name, target_pose, req->path_time);
+  if (!open_manipulator_x_.is_reachable(target_pose))
+  {
+    RCLCPP_WARN(this->get_logger(), "Target pose is out of the reachability map");
+    res->is_planned = false;
+    return;
+  }
+
+  if (blend_trajectory_)
+  {
+    res->is_planned = run_blended_task_command(req->end_effector_name, target_pose, req->path_time);
+    return;
+  }
 
-  res->is_planned = true;
+  res->is_planned = run_command([this, target_pose, req]() -> bool
+  {
+    open_manipulator_x_.makeJointTrajectory(req->end_effector_name, target_pose, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -206,9 +530,11 @@ void OpenManipulatorXController::goal_joint_space_path_to_kinematics_position_ca
   target_pose.position[1] = req->kinematics_pose.pose.position.y;
   target_pose.position[2] = req->kinematics_pose.pose.position.z;
 
-  open_manipulator_x_.makeJointTrajectory(req->end_effector_name, target_pose.position, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, target_pose, req]() -> bool
+  {
+    open_manipulator_x_.makeJointTrajectory(req->end_effector_name, target_pose.position, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -225,9 +551,11 @@ void OpenManipulatorXController::goal_joint_space_path_to_kinematics_orientation
 
   target_pose.orientation = math::convertQuaternionToRotationMatrix(q);
 
-  open_manipulator_x_.makeJointTrajectory(req->end_effector_name, target_pose.orientation, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, target_pose, req]() -> bool
+  {
+    open_manipulator_x_.makeJointTrajectory(req->end_effector_name, target_pose.orientation, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -246,9 +574,44 @@ void OpenManipulatorXController::goal_task_space_path_callback(
                        req->kinematics_pose.pose.orientation.z);
 
   target_pose.orientation = math::convertQuaternionToRotationMatrix(q);
-  open_manipulator_x_.makeTaskTrajectory(req->end_effector_name, target_pose, req->path_time);
 
-  res->is_planned = true;
+  if (!open_manipulator_x_.is_reachable(target_pose))
+  {
+    RCLCPP_WARN(this->get_logger(), "Target pose is out of the reachability map");
+    res->is_planned = false;
+    return;
+  }
+
+  if (precompute_task_trajectory_ && !blend_trajectory_)
+  {
+    // The IK batch is solved here, the control loop only swaps the samples in
+    std::shared_ptr<custom_trajectory::JointSamples> samples = std::make_shared<custom_trajectory::JointSamples>();
+    double move_time = req->path_time;
+    if (!open_manipulator_x_.plan_precomputed_task_trajectory(req->end_effector_name, target_pose, req->path_time,
+                                                              get_snapshot_joint_value(), samples.get(), &move_time))
+    {
+      res->is_planned = false;
+      return;
+    }
+    res->is_planned = run_command([this, samples, move_time]() -> bool
+    {
+      open_manipulator_x_.make_sampled_joint_trajectory(samples.get(), move_time);
+      return true;
+    });
+    return;
+  }
+
+  if (blend_trajectory_)
+  {
+    res->is_planned = run_blended_task_command(req->end_effector_name, target_pose, req->path_time);
+    return;
+  }
+
+  res->is_planned = run_command([this, target_pose, req]() -> bool
+  {
+    open_manipulator_x_.makeTaskTrajectory(req->end_effector_name, target_pose, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -261,9 +624,11 @@ void OpenManipulatorXController::goal_task_space_path_position_only_callback(
   position[1] = req->kinematics_pose.pose.position.y;
   position[2] = req->kinematics_pose.pose.position.z;
 
-  open_manipulator_x_.makeTaskTrajectory(req->end_effector_name, position, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, position, req]() -> bool
+  {
+    open_manipulator_x_.makeTaskTrajectory(req->end_effector_name, position, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -278,9 +643,11 @@ void OpenManipulatorXController::goal_task_space_path_orientation_only_callback(
 
   Eigen::Matrix3d orientation = math::convertQuaternionToRotationMatrix(q);
 
-  open_manipulator_x_.makeTaskTrajectory(req->end_effector_name, orientation, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, orientation, req]() -> bool
+  {
+    open_manipulator_x_.makeTaskTrajectory(req->end_effector_name, orientation, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -293,9 +660,21 @@ void OpenManipulatorXController::goal_joint_space_path_from_present_callback(
   for(uint8_t i = 0; i < req->joint_position.joint_name.size(); i ++)
     target_angle.push_back(req->joint_position.position.at(i));
 
-  open_manipulator_x_.makeJointTrajectoryFromPresentPosition(target_angle, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, target_angle, req]() -> bool
+  {
+    if (blend_trajectory_ || time_optimal_trajectory_)
+    {
+      // Relative to the present goal the new trajectory starts from
+      JointWaypoint present = open_manipulator_x_.get_present_joint_waypoint();
+      std::vector<double> goal_angle;
+      for (uint8_t index = 0; index < present.size(); index++)
+        goal_angle.push_back(present.at(index).position + (index < target_angle.size() ? target_angle.at(index) : 0.0));
+      if (blend_trajectory_) return open_manipulator_x_.make_blended_joint_trajectory(goal_angle, req->path_time);
+      return open_manipulator_x_.make_time_optimal_joint_trajectory(goal_angle);
+    }
+    open_manipulator_x_.makeJointTrajectoryFromPresentPosition(target_angle, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -315,9 +694,33 @@ void OpenManipulatorXController::goal_task_space_path_from_present_callback(
 
   target_pose.orientation = math::convertQuaternionToRotationMatrix(q);
 
-  open_manipulator_x_.makeTaskTrajectoryFromPresentPose(req->planning_group, target_pose, req->path_time);
+  if (blend_trajectory_)
+  {
+    // Relative to the measured pose of the last control cycle
+    StateSnapshot state;
+    state_snapshot_.load(&state);
+    for (uint8_t i = 0; i < SNAPSHOT_TOOL_SIZE && i < tool_names_.size(); i ++)
+    {
+      if (tool_names_.at(i) != req->planning_group) continue;
+
+      KinematicPose goal_pose;
+      Eigen::Quaterniond orientation(state.tool_pose_orientation[i][0], state.tool_pose_orientation[i][1],
+                                     state.tool_pose_orientation[i][2], state.tool_pose_orientation[i][3]);
+      goal_pose.position = Eigen::Vector3d(state.tool_pose_position[i][0], state.tool_pose_position[i][1], state.tool_pose_position[i][2]) +
+                           target_pose.position;
+      goal_pose.orientation = target_pose.orientation * math::convertQuaternionToRotationMatrix(orientation);
+      res->is_planned = run_blended_task_command(req->planning_group, goal_pose, req->path_time);
+      return;
+    }
+    res->is_planned = false;
+    return;
+  }
 
-  res->is_planned = true;
+  res->is_planned = run_command([this, target_pose, req]() -> bool
+  {
+    open_manipulator_x_.makeTaskTrajectoryFromPresentPose(req->planning_group, target_pose, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -330,9 +733,11 @@ void OpenManipulatorXController::goal_task_space_path_from_present_position_only
   position[1] = req->kinematics_pose.pose.position.y;
   position[2] = req->kinematics_pose.pose.position.z;
 
-  open_manipulator_x_.makeTaskTrajectoryFromPresentPose(req->planning_group, position, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, position, req]() -> bool
+  {
+    open_manipulator_x_.makeTaskTrajectoryFromPresentPose(req->planning_group, position, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -347,9 +752,11 @@ void OpenManipulatorXController::goal_task_space_path_from_present_orientation_o
 
   Eigen::Matrix3d orientation = math::convertQuaternionToRotationMatrix(q);
 
-  open_manipulator_x_.makeTaskTrajectoryFromPresentPose(req->planning_group, orientation, req->path_time);
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, orientation, req]() -> bool
+  {
+    open_manipulator_x_.makeTaskTrajectoryFromPresentPose(req->planning_group, orientation, req->path_time);
+    return true;
+  });
   return;
 }
 
@@ -357,10 +764,12 @@ void OpenManipulatorXController::goal_tool_control_callback(
   const std::shared_ptr<open_manipulator_msgs::srv::SetJointPosition::Request> req,
   const std::shared_ptr<open_manipulator_msgs::srv::SetJointPosition::Response> res)
 {
-  for (uint8_t i = 0; i < req->joint_position.joint_name.size(); i ++)
-    open_manipulator_x_.makeToolTrajectory(req->joint_position.joint_name.at(i), req->joint_position.position.at(i));
-
-  res->is_planned = true;
+  res->is_planned = run_command([this, req]() -> bool
+  {
+    for (uint8_t i = 0; i < req->joint_position.joint_name.size(); i ++)
+      open_manipulator_x_.makeToolTrajectory(req->joint_position.joint_name.at(i), req->joint_position.position.at(i));
+    return true;
+  });
   return;
 }
 
@@ -368,18 +777,20 @@ void OpenManipulatorXController::set_actuator_state_callback(
   const std::shared_ptr<open_manipulator_msgs::srv::SetActuatorState::Request> req,
   const std::shared_ptr<open_manipulator_msgs::srv::SetActuatorState::Response> res)
 {
-  if (req->set_actuator_state == true) // enable actuators
-  {
-    log::println("Wait a second for actuator enable", "GREEN");
-    open_manipulator_x_.enableAllActuator();
-  }
-  else // disable actuators
+  res->is_planned = run_command([this, req]() -> bool
   {
-    log::println("Wait a second for actuator disable", "GREEN");
-    open_manipulator_x_.disableAllActuator();
-  }
-
-  res->is_planned = true;
+    if (req->set_actuator_state == true) // enable actuators
+    {
+      log::println("Wait a second for actuator enable", "GREEN");
+      open_manipulator_x_.enableAllActuator();
+    }
+    else // disable actuators
+    {
+      log::println("Wait a second for actuator disable", "GREEN");
+      open_manipulator_x_.disableAllActuator();
+    }
+    return true;
+  });
   return;
 }
 
@@ -387,55 +798,88 @@ void OpenManipulatorXController::goal_drawing_trajectory_callback(
   const std::shared_ptr<open_manipulator_msgs::srv::SetDrawingTrajectory::Request> req,
   const std::shared_ptr<open_manipulator_msgs::srv::SetDrawingTrajectory::Response> res)
 {
-  try
+  Name trajectory_name;
+  if (!req->drawing_trajectory_name.compare("circle")) trajectory_name = CUSTOM_TRAJECTORY_CIRCLE;
+  else if (!req->drawing_trajectory_name.compare("line")) trajectory_name = CUSTOM_TRAJECTORY_LINE;
+  else if (!req->drawing_trajectory_name.compare("rhombus")) trajectory_name = CUSTOM_TRAJECTORY_RHOMBUS;
+  else if (!req->drawing_trajectory_name.compare("heart")) trajectory_name = CUSTOM_TRAJECTORY_HEART;
+  else
   {
-    if (!req->drawing_trajectory_name.compare("circle"))
-    {
-      double draw_circle_arg[3];
-      draw_circle_arg[0] = req->param[0];  // radius (m)
-      draw_circle_arg[1] = req->param[1];  // revolution (rev)
-      draw_circle_arg[2] = req->param[2];  // start angle position (rad)
-      void* p_draw_circle_arg = &draw_circle_arg;
+    res->is_planned = true;
+    return;
+  }
 
-      open_manipulator_x_.makeCustomTrajectory(CUSTOM_TRAJECTORY_CIRCLE, req->end_effector_name, p_draw_circle_arg, req->path_time);
-    }
-    else if (!req->drawing_trajectory_name.compare("line"))
-    {
-      TaskWaypoint draw_line_arg;
-      draw_line_arg.kinematic.position(0) = req->param[0]; // x axis (m)
-      draw_line_arg.kinematic.position(1) = req->param[1]; // y axis (m)
-      draw_line_arg.kinematic.position(2) = req->param[2]; // z axis (m)
-      void *p_draw_line_arg = &draw_line_arg;
+  // Valid until run_command returns: it doesn't while the loop may still run the command
+  double draw_arg[3];
+  TaskWaypoint draw_line_arg;
+  const void *p_draw_arg = &draw_arg;
+  if (trajectory_name == CUSTOM_TRAJECTORY_LINE)
+  {
+    draw_line_arg.kinematic.position(0) = req->param[0]; // x axis (m)
+    draw_line_arg.kinematic.position(1) = req->param[1]; // y axis (m)
+    draw_line_arg.kinematic.position(2) = req->param[2]; // z axis (m)
+    p_draw_arg = &draw_line_arg;
+  }
+  else
+  {
+    draw_arg[0] = req->param[0];  // radius (m)
+    draw_arg[1] = req->param[1];  // revolution (rev)
+    draw_arg[2] = req->param[2];  // start angle position (rad)
+  }
 
-      open_manipulator_x_.makeCustomTrajectory(CUSTOM_TRAJECTORY_LINE, req->end_effector_name, p_draw_line_arg, req->path_time);
-    }
-    else if (!req->drawing_trajectory_name.compare("rhombus"))
+  if (precompute_task_trajectory_)
+  {
+    // The IK batch is solved here, the control loop only swaps the samples in
+    std::shared_ptr<custom_trajectory::JointSamples> samples = std::make_shared<custom_trajectory::JointSamples>();
+    double move_time = req->path_time;
+    if (!open_manipulator_x_.plan_precomputed_custom_trajectory(trajectory_name, req->end_effector_name, p_draw_arg, req->path_time,
+                                                                get_snapshot_joint_value(), samples.get(), &move_time))
     {
-      double draw_rhombus_arg[3];
-      draw_rhombus_arg[0] = req->param[0];  // radius (m)
-      draw_rhombus_arg[1] = req->param[1];  // revolution (rev)
-      draw_rhombus_arg[2] = req->param[2];  // start angle position (rad)
-      void* p_draw_rhombus_arg = &draw_rhombus_arg;
-
-      open_manipulator_x_.makeCustomTrajectory(CUSTOM_TRAJECTORY_RHOMBUS, req->end_effector_name, p_draw_rhombus_arg, req->path_time);
+      res->is_planned = false;
+      return;
     }
-    else if (!req->drawing_trajectory_name.compare("heart"))
+    res->is_planned = run_command([this, samples, move_time]() -> bool
     {
-      double draw_heart_arg[3];
-      draw_heart_arg[0] = req->param[0];  // radius (m)
-      draw_heart_arg[1] = req->param[1];  // revolution (rev)
-      draw_heart_arg[2] = req->param[2];  // start angle position (rad)
-      void* p_draw_heart_arg = &draw_heart_arg;
-
-      open_manipulator_x_.makeCustomTrajectory(CUSTOM_TRAJECTORY_HEART, req->end_effector_name, p_draw_heart_arg, req->path_time);
-    }
-    res->is_planned = true;
+      open_manipulator_x_.make_sampled_joint_trajectory(samples.get(), move_time);
+      return true;
+    });
     return;
   }
-  catch (rclcpp::exceptions::RCLError &e)
+
+  res->is_planned = run_command([this, trajectory_name, p_draw_arg, req]() -> bool
   {
-    log::error("Failed to Create a Custom Trajectory");
-  }
+    try
+    {
+      open_manipulator_x_.makeCustomTrajectory(trajectory_name, req->end_effector_name, p_draw_arg, req->path_time);
+      return true;
+    }
+    catch (rclcpp::exceptions::RCLError &e)
+    {
+      log::error("Failed to Create a Custom Trajectory");
+    }
+    return false;
+  });
+  return;
+}
+
+void OpenManipulatorXController::is_reachable_callback(
+  const std::shared_ptr<open_manipulator_msgs::srv::SetKinematicsPose::Request> req,
+  const std::shared_ptr<open_manipulator_msgs::srv::SetKinematicsPose::Response> res)
+{
+  KinematicPose target_pose;
+  target_pose.position[0] = req->kinematics_pose.pose.position.x;
+  target_pose.position[1] = req->kinematics_pose.pose.position.y;
+  target_pose.position[2] = req->kinematics_pose.pose.position.z;
+
+  Eigen::Quaterniond q(req->kinematics_pose.pose.orientation.w,
+                       req->kinematics_pose.pose.orientation.x,
+                       req->kinematics_pose.pose.orientation.y,
+                       req->kinematics_pose.pose.orientation.z);
+
+  target_pose.orientation = math::convertQuaternionToRotationMatrix(q);
+
+  // The map is read-only once loaded, so this does not wait on the control loop
+  res->is_planned = open_manipulator_x_.is_reachable(target_pose);
   return;
 }
 
@@ -444,137 +888,558 @@ void OpenManipulatorXController::goal_drawing_trajectory_callback(
 ********************************************************************************/
 void OpenManipulatorXController::process_callback()   
 {
+  if (simulated_actuator_)
+  {
+    virtual_clock_.advance(control_period_);
+    this->process(virtual_clock_.now());
+    return;
+  }
+
   rclcpp::Clock clock(RCL_SYSTEM_TIME);
   rclcpp::Time present_time = clock.now();
   this->process(present_time.seconds());
 }
 
+double OpenManipulatorXController::get_control_period() const
+{
+  return control_period_;
+}
+
+double OpenManipulatorXController::get_wall_control_period() const
+{
+  // The simulated actuators run sim_time_scale control periods per wall clock period
+  return simulated_actuator_ ? control_period_ / sim_time_scale_ : control_period_;
+}
+
 void OpenManipulatorXController::process(double time)
 {
+  if (enable_loop_timing_ || telemetry_recorder_.is_open())
+  {
+    std::chrono::steady_clock::time_point present = std::chrono::steady_clock::now();
+    if (last_process_time_.time_since_epoch().count() != 0)
+    {
+      last_period_ = std::chrono::duration<double>(present - last_process_time_).count();
+      period_timer_.add(last_period_);
+    }
+    last_process_time_ = present;
+  }
+
+  update_setpoint_stream(time);
   open_manipulator_x_.process_open_manipulator_x(time);
+  update_state_snapshot(time);
+  if (telemetry_recorder_.is_open()) record_telemetry(time);
+
+  if (enable_loop_timing_) update_loop_timing();
+}
+
+void OpenManipulatorXController::update_setpoint_stream(double time)
+{
+  bool retarget = false;
+
+  Setpoint setpoint;
+  while (setpoint_queue_.pop(&setpoint))
+  {
+    if (setpoint.replace)
+    {
+      stream_size_ = 0;
+      retarget = true;
+    }
+    if (stream_size_ == STREAM_BUFFER_SIZE) continue;
+
+    uint8_t index = (stream_head_ + stream_size_) % STREAM_BUFFER_SIZE;
+    stream_[index] = setpoint;
+    stream_target_time_[index] = time + setpoint.time_from_start;
+    stream_size_++;
+  }
+
+  if (stream_size_ == 0) return;
+  if (retarget == false && time < stream_segment_end_time_) return;
+
+  // Skip the points that are already due, keeping the last one
+  while (stream_size_ > 1 && stream_target_time_[(stream_head_ + 1) % STREAM_BUFFER_SIZE] <= time)
+  {
+    stream_head_ = (stream_head_ + 1) % STREAM_BUFFER_SIZE;
+    stream_size_--;
+  }
+
+  double move_time = stream_target_time_[stream_head_] - time;
+  if (move_time < 2.0 * control_period_) move_time = 2.0 * control_period_;
+
+  start_stream_segment(stream_[stream_head_], move_time);
+  stream_segment_end_time_ = time + move_time;
+  stream_head_ = (stream_head_ + 1) % STREAM_BUFFER_SIZE;
+  stream_size_--;
+}
+
+void OpenManipulatorXController::start_stream_segment(const Setpoint &setpoint, double move_time)
+{
+  // The trajectory starts from the present goal position, velocity and acceleration,
+  // so a retargeted segment blends into the one it replaces. Joints missing in the
+  // message keep their present goal.
+  JointWaypoint present_goal = open_manipulator_x_.getTrajectory()->getPresentJointWaypoint();
+  std::vector<JointValue> goal_value;
+  bool joint_given = false;
+  for (uint8_t i = 0; i < SNAPSHOT_JOINT_SIZE && i < joint_names_.size() && i < present_goal.size(); i ++)
+  {
+    JointValue value = {};
+    value.position = present_goal.at(i).position;
+    if (setpoint.joint_given[i])
+    {
+      value.position = setpoint.joint_position[i];
+      value.velocity = setpoint.joint_velocity[i];
+      value.acceleration = setpoint.joint_acceleration[i];
+      joint_given = true;
+    }
+    goal_value.push_back(value);
+  }
+  if (joint_given) open_manipulator_x_.makeJointTrajectory(goal_value, move_time);
+
+  if (setpoint.tool_given && tool_names_.size() != 0)
+    open_manipulator_x_.makeToolTrajectory(tool_names_.at(0), setpoint.tool_position);
+}
+
+void OpenManipulatorXController::update_loop_timing()
+{
+  // Hand over and restart the statistics once per diagnostics period
+  loop_timing_tick_++;
+  if (loop_timing_tick_ < diagnostics_period_ / control_period_) return;
+
+  LoopTimingSnapshot snapshot;
+  for (uint8_t stage = 0; stage < LOOP_STAGE_SIZE; stage++)
+    snapshot.stage[stage] = open_manipulator_x_.get_loop_timing(stage);
+  snapshot.stage[LOOP_STAGE_PERIOD] = period_timer_.get_statistics();
+  loop_timing_snapshot_.store(snapshot);
+
+  open_manipulator_x_.reset_loop_timing();
+  period_timer_.reset();
+  loop_timing_tick_ = 0;
+}
+
+JointWaypoint OpenManipulatorXController::get_snapshot_joint_value() const
+{
+  StateSnapshot state;
+  state_snapshot_.load(&state);
+
+  JointWaypoint joint_value(joint_names_.size() < SNAPSHOT_JOINT_SIZE ? joint_names_.size() : SNAPSHOT_JOINT_SIZE);
+  for (uint8_t i = 0; i < joint_value.size(); i ++)
+  {
+    joint_value.at(i).position = state.joint_position[i];
+    joint_value.at(i).velocity = state.joint_velocity[i];
+    joint_value.at(i).acceleration = 0.0;
+    joint_value.at(i).effort = state.joint_effort[i];
+  }
+  return joint_value;
+}
+
+void OpenManipulatorXController::update_state_snapshot(double time)
+{
+  StateSnapshot state = {};
+  state.time = time;
+  state.is_moving = open_manipulator_x_.getMovingState();
+  state.is_actuator_enabled = open_manipulator_x_.getActuatorEnabledState(JOINT_DYNAMIXEL);
+
+  auto joint_value = open_manipulator_x_.getAllActiveJointValue();
+  for (uint8_t i = 0; i < SNAPSHOT_JOINT_SIZE && i < joint_value.size(); i ++)
+  {
+    state.joint_position[i] = joint_value.at(i).position;
+    state.joint_velocity[i] = joint_value.at(i).velocity;
+    state.joint_effort[i] = joint_value.at(i).effort;
+  }
+
+  auto tool_value = open_manipulator_x_.getAllToolValue();
+  for (uint8_t i = 0; i < SNAPSHOT_TOOL_SIZE && i < tool_value.size(); i ++)
+  {
+    state.tool_position[i] = tool_value.at(i).position;
+    state.tool_velocity[i] = tool_value.at(i).velocity;
+    state.tool_effort[i] = tool_value.at(i).effort;
+
+    KinematicPose pose = open_manipulator_x_.getKinematicPose(tool_names_.at(i));
+    Eigen::Quaterniond orientation = math::convertRotationMatrixToQuaternion(pose.orientation);
+    state.tool_pose_position[i][0] = pose.position[0];
+    state.tool_pose_position[i][1] = pose.position[1];
+    state.tool_pose_position[i][2] = pose.position[2];
+    state.tool_pose_orientation[i][0] = orientation.w();
+    state.tool_pose_orientation[i][1] = orientation.x();
+    state.tool_pose_orientation[i][2] = orientation.y();
+    state.tool_pose_orientation[i][3] = orientation.z();
+  }
+
+  // Actual or simulated actuators only, a Gazebo gripper just follows its goal
+  const JointWaypoint &goal_tool_value = open_manipulator_x_.get_last_goal_tool_value();
+  if (state.is_actuator_enabled && goal_tool_value.size() != 0 && tool_value.size() != 0)
+  {
+    uint8_t event = grasp_detector_.update(time, goal_tool_value.at(0).position,
+      state.tool_position[0], state.tool_velocity[0], state.tool_effort[0]);
+    if (event != GRASP_EVENT_NONE)
+    {
+      grasp_event_ = event;
+      grasp_event_count_++;
+    }
+  }
+  state.grasp_state = grasp_detector_.get_state();
+  state.grasp_event = grasp_event_;
+  state.grasp_event_count = grasp_event_count_;
+
+  state.collision_count = open_manipulator_x_.get_collision_count();
+  open_manipulator_x_.get_last_collision(&state.collision_link[0], &state.collision_link[1]);
+
+  state_snapshot_.store(state);
+}
+
+void OpenManipulatorXController::record_telemetry(double time)
+{
+  StateSnapshot state;
+  state_snapshot_.load(&state);
+
+  TelemetryRecord record = {};
+  record.time = time;
+
+  const JointWaypoint &goal_joint_value = open_manipulator_x_.get_last_goal_joint_value();
+  for (uint8_t i = 0; i < SNAPSHOT_JOINT_SIZE && i < goal_joint_value.size(); i++)
+  {
+    record.goal_position[i] = goal_joint_value.at(i).position;
+    record.goal_velocity[i] = goal_joint_value.at(i).velocity;
+  }
+  const JointWaypoint &goal_tool_value = open_manipulator_x_.get_last_goal_tool_value();
+  for (uint8_t i = 0; i < SNAPSHOT_TOOL_SIZE && i < goal_tool_value.size(); i++)
+  {
+    record.goal_position[SNAPSHOT_JOINT_SIZE + i] = goal_tool_value.at(i).position;
+    record.goal_velocity[SNAPSHOT_JOINT_SIZE + i] = goal_tool_value.at(i).velocity;
+  }
+
+  for (uint8_t i = 0; i < SNAPSHOT_JOINT_SIZE; i++)
+  {
+    record.present_position[i] = state.joint_position[i];
+    record.present_velocity[i] = state.joint_velocity[i];
+    record.present_current[i] = state.joint_effort[i];
+  }
+  for (uint8_t i = 0; i < SNAPSHOT_TOOL_SIZE; i++)
+  {
+    record.present_position[SNAPSHOT_JOINT_SIZE + i] = state.tool_position[i];
+    record.present_velocity[SNAPSHOT_JOINT_SIZE + i] = state.tool_velocity[i];
+    record.present_current[SNAPSHOT_JOINT_SIZE + i] = state.tool_effort[i];
+  }
+
+  for (uint8_t stage = 0; stage < LOOP_STAGE_SIZE; stage++)
+    record.stage_time[stage] = open_manipulator_x_.get_last_loop_time(stage);
+  record.stage_time[LOOP_STAGE_PERIOD] = last_period_;
+
+  telemetry_recorder_.append(record);
 }
 
 /********************************************************************************
-** Callback function for publish timer
+** Control Thread
 ********************************************************************************/
-void OpenManipulatorXController::publish_callback()   
+void OpenManipulatorXController::start_control_thread()
 {
-  if (sim_ == false) publish_joint_states();
-  else publish_gazebo_command();
+  control_thread_running_ = true;
+  control_thread_ = std::thread(&OpenManipulatorXController::control_thread_loop, this);
+}
 
-  publish_open_manipulator_x_states();
-  publish_kinematics_pose();
+void OpenManipulatorXController::stop_control_thread()
+{
+  control_thread_running_ = false;
+  if (control_thread_.joinable()) control_thread_.join();
 }
 
-void OpenManipulatorXController::publish_open_manipulator_x_states()
+void OpenManipulatorXController::control_thread_loop()
 {
-  open_manipulator_msgs::msg::OpenManipulatorState msg;
-  if(open_manipulator_x_.getMovingState())
-    msg.open_manipulator_moving_state = msg.IS_MOVING;
-  else
-    msg.open_manipulator_moving_state = msg.STOPPED;
+  if (set_realtime_scheduling(control_thread_priority_, control_thread_cpu_) == false)
+    RCLCPP_WARN(this->get_logger(), "Failed to set priority %d / CPU %d of the control thread (needs rtprio limit or CAP_SYS_NICE)",
+      control_thread_priority_, control_thread_cpu_);
 
-  if(open_manipulator_x_.getActuatorEnabledState(JOINT_DYNAMIXEL))
-    msg.open_manipulator_actuator_state = msg.ACTUATOR_ENABLED;
-  else
-    msg.open_manipulator_actuator_state = msg.ACTUATOR_DISABLED;
+  const long period_ns = static_cast<long>(get_wall_control_period() * 1e9);
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
 
-  open_manipulator_x_states_pub_->publish(msg);
+  while (control_thread_running_)
+  {
+    if (simulated_actuator_)
+    {
+      virtual_clock_.advance(control_period_);
+      control_step(virtual_clock_.now());
+    }
+    else
+    {
+      control_step(get_monotonic_time());
+    }
+    wait_for_next_period(&deadline, period_ns);
+  }
 }
 
-void OpenManipulatorXController::publish_kinematics_pose()
+void OpenManipulatorXController::control_step(double time)
 {
-  open_manipulator_msgs::msg::KinematicsPose msg;
-  auto tools_name = open_manipulator_x_.getManipulator()->getAllToolComponentName();
+  ControlCommand command;
+  while (command_queue_.pop(&command))
+  {
+    // Cancelled by run_command after its timeout
+    if (command.taken->exchange(true)) continue;
 
-  uint8_t index = 0;
-  for (auto const & tools:tools_name)
+    open_manipulator_x_.wait_bus_transfer();
+    command.result->set_value(command.run());
+  }
+
+  this->process(time);
+}
+
+bool OpenManipulatorXController::run_command(std::function<bool()> command)
+{
+  if (use_control_thread_ == false && externally_driven_ == false)
   {
-    KinematicPose pose = open_manipulator_x_.getKinematicPose(tools);
-    msg.pose.position.x = pose.position[0];
-    msg.pose.position.y = pose.position[1];
-    msg.pose.position.z = pose.position[2];
-    Eigen::Quaterniond orientation = math::convertRotationMatrixToQuaternion(pose.orientation);
-    msg.pose.orientation.w = orientation.w();
-    msg.pose.orientation.x = orientation.x();
-    msg.pose.orientation.y = orientation.y();
-    msg.pose.orientation.z = orientation.z();
+    open_manipulator_x_.wait_bus_transfer();
+    return command();
+  }
+
+  // The ROS callbacks are the only producer (single-threaded executor)
+  ControlCommand control_command;
+  control_command.run = command;
+  control_command.result = std::make_shared<std::promise<bool>>();
+  control_command.taken = std::make_shared<std::atomic<bool>>(false);
+  std::shared_ptr<std::atomic<bool>> taken = control_command.taken;
+  std::future<bool> result = control_command.result->get_future();
 
-    open_manipulator_x_kinematics_pose_pub_.at(index)->publish(msg);
-    index++;
+  if (command_queue_.push(std::move(control_command)) == false)
+  {
+    RCLCPP_WARN(this->get_logger(), "Control command queue is full");
+    return false;
   }
+
+  // The loop takes it at the start of its next cycle. A few periods at most, so a late loop
+  // stalls the executor (and the other arms sharing it) no longer than that
+  if (result.wait_for(std::chrono::duration<double>(COMMAND_TIMEOUT_CYCLES * get_wall_control_period())) != std::future_status::ready)
+  {
+    if (taken->exchange(true) == false)
+    {
+      RCLCPP_WARN(this->get_logger(), "Control loop did not take the command in time, cancelled");
+      return false;
+    }
+    // Already running, so report what it does
+  }
+  return result.get();
+}
+
+bool OpenManipulatorXController::run_blended_task_command(Name tool_name, KinematicPose goal_pose, double path_time)
+{
+  // IK is solved here, the control loop only blends toward the joint goal
+  std::vector<double> goal_joint_position;
+  if (!open_manipulator_x_.plan_blended_task_trajectory(tool_name, goal_pose, get_snapshot_joint_value(), &goal_joint_position))
+    return false;
+
+  return run_command([this, goal_joint_position, path_time]() -> bool
+  {
+    return open_manipulator_x_.make_blended_joint_trajectory(goal_joint_position, path_time);
+  });
 }
 
-void OpenManipulatorXController::publish_joint_states()
+/********************************************************************************
+** Callback function for diagnostics timer
+********************************************************************************/
+void OpenManipulatorXController::diagnostics_callback()
 {
-  sensor_msgs::msg::JointState msg;
+  const char *stage_name[LOOP_STAGE_SIZE + 1] = {"planning", "bus read", "bus write", "forward kinematics", "total", "period"};
+
+  diagnostic_msgs::msg::DiagnosticArray msg;
   msg.header.stamp = rclcpp::Clock().now();
 
-  auto joints_name = open_manipulator_x_.getManipulator()->getAllActiveJointComponentName();
-  auto tools_name = open_manipulator_x_.getManipulator()->getAllToolComponentName();
+  if (enable_loop_timing_)
+  {
+    LoopTimingSnapshot snapshot;
+    loop_timing_snapshot_.load(&snapshot);
 
-  auto joint_value = open_manipulator_x_.getAllActiveJointValue();
-  auto tool_value = open_manipulator_x_.getAllToolValue();
+    for (uint8_t stage = 0; stage < LOOP_STAGE_SIZE + 1; stage++)
+    {
+      // The thread of the shared bus does the transfers of externally driven arms
+      if (externally_driven_ && (stage == LOOP_STAGE_READ || stage == LOOP_STAGE_WRITE)) continue;
+      const loop_timing::Statistics &statistics = snapshot.stage[stage];
+
+      diagnostic_msgs::msg::DiagnosticStatus status;
+      status.name = std::string("open_manipulator_x_controller: loop ") + stage_name[stage];
+      status.hardware_id = "open_manipulator_x";
+      status.level = (statistics.overrun > 0) ? diagnostic_msgs::msg::DiagnosticStatus::WARN : diagnostic_msgs::msg::DiagnosticStatus::OK;
+      status.message = (statistics.overrun > 0) ? "overrun" : "ok";
+
+      // unit: ms
+      const char *key[6] = {"count", "overrun", "min", "avg", "p99", "max"};
+      double value[6] = {(double)statistics.count, (double)statistics.overrun,
+                         statistics.min * 1e3, statistics.avg * 1e3, statistics.p99 * 1e3, statistics.max * 1e3};
+      for (uint8_t index = 0; index < 6; index++)
+      {
+        char str[32];
+        snprintf(str, sizeof(str), (index < 2) ? "%.0f" : "%.3f", value[index]);
+
+        diagnostic_msgs::msg::KeyValue key_value;
+        key_value.key = key[index];
+        key_value.value = str;
+        status.values.push_back(key_value);
+      }
+      msg.status.push_back(status);
+    }
+  }
 
-  for(uint8_t i = 0; i < joints_name.size(); i ++)
+  // Counted by the bus, nothing is logged from the control loop
+  dynamixel::BusErrorCounter bus_counter;
+  const char *last_error = nullptr;
+  if (open_manipulator_x_.get_bus_error_counter(&bus_counter, &last_error))
   {
-    msg.name.push_back(joints_name.at(i));
-    msg.position.push_back(joint_value.at(i).position);
-    msg.velocity.push_back(joint_value.at(i).velocity);
-    msg.effort.push_back(joint_value.at(i).effort);
+    bool bus_error = bus_counter.read_error != reported_bus_error_counter_.read_error ||
+                     bus_counter.write_error != reported_bus_error_counter_.write_error;
+    reported_bus_error_counter_ = bus_counter;
+
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.name = "open_manipulator_x_controller: dynamixel bus";
+    status.hardware_id = "open_manipulator_x";
+    status.level = bus_error ? diagnostic_msgs::msg::DiagnosticStatus::WARN : diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.message = (bus_error && last_error != nullptr) ? last_error : "ok";
+
+    const char *key[5] = {"read", "read_error", "write", "write_error", "retry"};
+    uint32_t value[5] = {bus_counter.read, bus_counter.read_error, bus_counter.write, bus_counter.write_error, bus_counter.retry};
+    for (uint8_t index = 0; index < 5; index++)
+    {
+      diagnostic_msgs::msg::KeyValue key_value;
+      key_value.key = key[index];
+      key_value.value = std::to_string(value[index]);
+      status.values.push_back(key_value);
+    }
+    msg.status.push_back(status);
   }
 
-  for(uint8_t i = 0; i < tools_name.size(); i ++)
+  for (uint8_t id : dxl_id_)
   {
-    msg.name.push_back(tools_name.at(i));
-    msg.position.push_back(tool_value.at(i).position);
-    msg.velocity.push_back(0.0);
-    msg.effort.push_back(0.0);
+    dynamixel::ActuatorErrorCounter counter;
+    if (open_manipulator_x_.get_actuator_error_counter(id, &counter) == false) continue;
+
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.name = "open_manipulator_x_controller: dynamixel " + std::to_string(id);
+    status.hardware_id = "open_manipulator_x";
+    status.level = (counter.stale_cycle > 0) ? diagnostic_msgs::msg::DiagnosticStatus::WARN : diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.message = (counter.stale_cycle > 0) ? "holding the last good value" : "ok";
+
+    const char *key[4] = {"timeout", "crc_error", "packet_loss", "stale_cycle"};
+    uint32_t value[4] = {counter.timeout, counter.crc_error, counter.packet_loss, counter.stale_cycle};
+    for (uint8_t index = 0; index < 4; index++)
+    {
+      diagnostic_msgs::msg::KeyValue key_value;
+      key_value.key = key[index];
+      key_value.value = std::to_string(value[index]);
+      status.values.push_back(key_value);
+    }
+    msg.status.push_back(status);
   }
-  open_manipulator_x_joint_states_pub_->publish(msg);
+
+  diagnostics_pub_->publish(msg);
 }
 
-void OpenManipulatorXController::publish_gazebo_command()
+/********************************************************************************
+** Callback function for publish timer
+********************************************************************************/
+void OpenManipulatorXController::publish_callback()   
 {
-  JointWaypoint joint_value = open_manipulator_x_.getAllActiveJointValue();
-  JointWaypoint tool_value = open_manipulator_x_.getAllToolValue();
+  StateSnapshot state;
+  state_snapshot_.load(&state);
+
+  if (publish_tick_ % joint_states_decimation_ == 0)
+  {
+    if (sim_ == false || simulated_actuator_) publish_joint_states(state);
+    else publish_gazebo_command(state);
+  }
+
+  if (publish_tick_ % states_decimation_ == 0) publish_open_manipulator_x_states(state);
+  if (publish_tick_ % kinematics_pose_decimation_ == 0) publish_kinematics_pose(state);
 
-  for(uint8_t i = 0; i < joint_value.size(); i ++)
+  // Only the last one if several came within one publish period
+  if (state.grasp_event_count != reported_grasp_event_count_)
   {
-    std_msgs::msg::Float64 msg;
-    msg.data = joint_value.at(i).position;
-    gazebo_goal_joint_position_pub_.at(i)->publish(msg);
+    std_msgs::msg::String msg;
+    msg.data = grasp::GraspDetector::get_event_name(state.grasp_event);
+    gripper_event_pub_->publish(msg);
+    reported_grasp_event_count_ = state.grasp_event_count;
   }
 
-  for(uint8_t i = 0; i < tool_value.size(); i ++)
+  // Logged here, the control loop only counts
+  if (state.collision_count != reported_collision_count_)
   {
-    std_msgs::msg::Float64 msg;
-    msg.data = tool_value.at(i).position;
-    gazebo_goal_joint_position_pub_.at(joint_value.size() + i)->publish(msg);
+    RCLCPP_WARN(this->get_logger(), "Stopped before a collision of %s and %s (%u setpoints dropped)",
+      collision::CollisionChecker::get_link_name(state.collision_link[0]),
+      collision::CollisionChecker::get_link_name(state.collision_link[1]),
+      state.collision_count - reported_collision_count_);
+    reported_collision_count_ = state.collision_count;
   }
+
+  publish_tick_++;
 }
-}  // namespace open_manipulator_x_controller;
 
-/*****************************************************************************
-** Main
-*****************************************************************************/
-int main(int argc, char **argv)
+void OpenManipulatorXController::publish_open_manipulator_x_states(const StateSnapshot &state)
+{
+  open_manipulator_msgs::msg::OpenManipulatorState &msg = open_manipulator_x_states_msg_;
+  if(state.is_moving)
+    msg.open_manipulator_moving_state = msg.IS_MOVING;
+  else
+    msg.open_manipulator_moving_state = msg.STOPPED;
+
+  if(state.is_actuator_enabled)
+    msg.open_manipulator_actuator_state = msg.ACTUATOR_ENABLED;
+  else
+    msg.open_manipulator_actuator_state = msg.ACTUATOR_DISABLED;
+
+  open_manipulator_x_states_pub_->publish(msg);
+}
+
+void OpenManipulatorXController::publish_kinematics_pose(const StateSnapshot &state)
+{
+  for (uint8_t index = 0; index < SNAPSHOT_TOOL_SIZE && index < open_manipulator_x_kinematics_pose_pub_.size(); index++)
+  {
+    publish_message(open_manipulator_x_kinematics_pose_pub_.at(index), &kinematics_pose_msg_,
+      [&state, index](open_manipulator_msgs::msg::KinematicsPose *msg)
+      {
+        msg->pose.position.x = state.tool_pose_position[index][0];
+        msg->pose.position.y = state.tool_pose_position[index][1];
+        msg->pose.position.z = state.tool_pose_position[index][2];
+        msg->pose.orientation.w = state.tool_pose_orientation[index][0];
+        msg->pose.orientation.x = state.tool_pose_orientation[index][1];
+        msg->pose.orientation.y = state.tool_pose_orientation[index][2];
+        msg->pose.orientation.z = state.tool_pose_orientation[index][3];
+      });
+  }
+}
+
+void OpenManipulatorXController::publish_joint_states(const StateSnapshot &state)
 {
-  rclcpp::init(argc, argv);
+  // JointState has unbounded fields, so it can't be loaned; fill the preallocated one in place
+  sensor_msgs::msg::JointState &msg = joint_states_msg_;
+  // Simulated actuators stamp with the virtual clock, so timing can be checked from the messages
+  if (simulated_actuator_) msg.header.stamp = rclcpp::Time(static_cast<int64_t>(state.time * 1e9));
+  else msg.header.stamp = rclcpp::Clock().now();
+
+  uint8_t joint_size = joint_names_.size() < SNAPSHOT_JOINT_SIZE ? joint_names_.size() : SNAPSHOT_JOINT_SIZE;
+  for(uint8_t i = 0; i < joint_size; i ++)
+  {
+    msg.position[i] = state.joint_position[i];
+    msg.velocity[i] = state.joint_velocity[i];
+    msg.effort[i] = state.joint_effort[i];
+  }
 
-  std::string usb_port = "/dev/ttyUSB0";
-  std::string baud_rate = "1000000";
-  if (argc >= 3)
+  for(uint8_t i = 0; joint_size + i < msg.name.size(); i ++)
   {
-    usb_port = argv[1];
-    baud_rate = argv[2];
-    printf("port_name and baud_rate are set to %s, %s \n", usb_port.c_str(), baud_rate.c_str());
+    msg.position[joint_size + i] = state.tool_position[i];
+    msg.velocity[joint_size + i] = state.tool_velocity[i];
+    msg.effort[joint_size + i] = state.tool_effort[i];
   }
-  else
-    printf("default port_name and baud_rate are set to %s, %s \n", usb_port.c_str(), baud_rate.c_str());
+  open_manipulator_x_joint_states_pub_->publish(msg);
+}
 
-  rclcpp::spin(std::make_shared<open_manipulator_x_controller::OpenManipulatorXController>(usb_port, baud_rate));
-  rclcpp::shutdown();
+void OpenManipulatorXController::publish_gazebo_command(const StateSnapshot &state)
+{
+  uint8_t joint_size = joint_names_.size() < SNAPSHOT_JOINT_SIZE ? joint_names_.size() : SNAPSHOT_JOINT_SIZE;
+  uint8_t tool_size = tool_names_.size() < SNAPSHOT_TOOL_SIZE ? tool_names_.size() : SNAPSHOT_TOOL_SIZE;
 
-  return 0;
+  for(uint8_t i = 0; i < joint_size + tool_size; i ++)
+  {
+    double position = (i < joint_size) ? state.joint_position[i] : state.tool_position[i - joint_size];
+    publish_message(gazebo_goal_joint_position_pub_.at(i), &gazebo_goal_joint_position_msg_,
+      [position](std_msgs::msg::Float64 *msg)
+      {
+        msg->data = position;
+      });
+  }
 }
+}  // namespace open_manipulator_x_controller;
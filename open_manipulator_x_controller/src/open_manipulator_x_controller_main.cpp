@@ -0,0 +1,43 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "open_manipulator_x_controller/open_manipulator_x_controller.hpp"
+
+/*****************************************************************************
+** Main
+*****************************************************************************/
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+
+  std::string usb_port = "/dev/ttyUSB0";
+  std::string baud_rate = "1000000";
+  if (argc >= 3)
+  {
+    usb_port = argv[1];
+    baud_rate = argv[2];
+    printf("port_name and baud_rate are set to %s, %s \n", usb_port.c_str(), baud_rate.c_str());
+  }
+  else
+    printf("default port_name and baud_rate are set to %s, %s \n", usb_port.c_str(), baud_rate.c_str());
+
+  rclcpp::spin(std::make_shared<open_manipulator_x_controller::OpenManipulatorXController>(usb_port, baud_rate));
+  rclcpp::shutdown();
+
+  return 0;
+}
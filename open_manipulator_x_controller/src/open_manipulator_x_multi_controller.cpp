@@ -0,0 +1,193 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include <map>
+
+#include "open_manipulator_x_controller/open_manipulator_x_controller.hpp"
+
+using namespace open_manipulator_x_controller;
+
+/*****************************************************************************
+** Multi-Arm Controller
+*****************************************************************************/
+// Every arm on one U2D2 port shares a single DynamixelBus, so the whole port is
+// read and written with one packet each per cycle by the thread of that port.
+typedef struct
+{
+  std::string usb_port;
+  std::string baud_rate;
+  double control_period = 0.0;   // of the arms on the port, all the same
+  dynamixel::DynamixelBus *bus = nullptr;
+  std::vector<std::string> arm_name;
+  std::vector<std::vector<uint8_t>> arm_dxl_id;
+  std::vector<std::shared_ptr<OpenManipulatorXController>> arm;
+  std::thread thread;
+} Port;
+
+static std::atomic<bool> g_running(true);
+
+static void port_loop(Port *port, int priority, int cpu, rclcpp::Logger logger)
+{
+  if (set_realtime_scheduling(priority, cpu) == false)
+    RCLCPP_WARN(logger, "Failed to set priority %d / CPU %d of the thread of %s", priority, cpu, port->usb_port.c_str());
+
+  const long period_ns = static_cast<long>(port->control_period * 1e9);
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  while (g_running)
+  {
+    port->bus->read_all();
+    double time = get_monotonic_time();
+    for (auto & arm : port->arm)
+      arm->control_step(time);
+    port->bus->write_all();
+
+    wait_for_next_period(&deadline, period_ns);
+  }
+}
+
+/*****************************************************************************
+** Main
+*****************************************************************************/
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+
+  auto node = std::make_shared<rclcpp::Node>("open_manipulator_x_multi_controller");
+
+  std::vector<std::string> arm_names;
+  int control_thread_priority, control_thread_cpu;
+  bool dxl_baud_rate_rewrite;
+  node->declare_parameter("arm_names");
+  node->declare_parameter("control_thread_priority");
+  node->declare_parameter("control_thread_cpu");
+  node->declare_parameter("dxl_baud_rate_rewrite");
+  node->get_parameter_or<std::vector<std::string>>("arm_names", arm_names, {});
+  node->get_parameter_or<int>("control_thread_priority", control_thread_priority, 0);
+  node->get_parameter_or<int>("control_thread_cpu", control_thread_cpu, -1);
+  node->get_parameter_or<bool>("dxl_baud_rate_rewrite", dxl_baud_rate_rewrite, false);
+
+  if (arm_names.empty())
+  {
+    RCLCPP_ERROR(node->get_logger(), "No arm_names are given");
+    rclcpp::shutdown();
+    return 1;
+  }
+
+  // Group the arms by port
+  std::map<std::string, Port> port;
+  for (const auto & name : arm_names)
+  {
+    std::string usb_port, baud_rate;
+    std::vector<int64_t> id;
+    node->declare_parameter(name + ".usb_port");
+    node->declare_parameter(name + ".baud_rate");
+    node->declare_parameter(name + ".dxl_id");
+    node->get_parameter_or<std::string>(name + ".usb_port", usb_port, "/dev/ttyUSB0");
+    node->get_parameter_or<std::string>(name + ".baud_rate", baud_rate, "1000000");
+    node->get_parameter_or<std::vector<int64_t>>(name + ".dxl_id", id, {11, 12, 13, 14, 15});
+
+    if (id.size() != 5)
+    {
+      RCLCPP_ERROR(node->get_logger(), "%s.dxl_id needs 4 joint ids and 1 gripper id", name.c_str());
+      rclcpp::shutdown();
+      return 1;
+    }
+    std::vector<uint8_t> dxl_id(id.begin(), id.end());
+
+    Port & p = port[usb_port];
+    if (p.bus == nullptr)
+    {
+      p.usb_port = usb_port;
+      p.baud_rate = baud_rate;
+      p.bus = new dynamixel::DynamixelBus();
+      if (p.bus->initialize(usb_port, baud_rate) == false)
+      {
+        RCLCPP_ERROR(node->get_logger(), "Failed to open %s", usb_port.c_str());
+        rclcpp::shutdown();
+        return 1;
+      }
+      p.bus->set_transfer_mode(DXL_TRANSFER_MODE_SYNC);
+    }
+    else if (p.baud_rate != baud_rate)
+      RCLCPP_WARN(node->get_logger(), "%s shares %s at %s bps, ignoring %s bps",
+        name.c_str(), usb_port.c_str(), p.baud_rate.c_str(), baud_rate.c_str());
+
+    p.arm_name.push_back(name);
+    p.arm_dxl_id.push_back(dxl_id);
+  }
+
+  // Once per port with the ids of every arm on it, before any arm configures its actuators
+  for (auto & p : port)
+  {
+    std::vector<uint8_t> dxl_id;
+    for (const auto & id : p.second.arm_dxl_id)
+      dxl_id.insert(dxl_id.end(), id.begin(), id.end());
+
+    if (p.second.bus->negotiate_baud_rate(dxl_id, p.second.baud_rate, dxl_baud_rate_rewrite) == false)
+    {
+      RCLCPP_ERROR(node->get_logger(), "The Dynamixels on %s don't answer at %s bps", p.first.c_str(), p.second.baud_rate.c_str());
+      rclcpp::shutdown();
+      return 1;
+    }
+
+    for (uint8_t index = 0; index < p.second.arm_name.size(); index++)
+    {
+      const std::string & name = p.second.arm_name.at(index);
+      auto arm = std::make_shared<OpenManipulatorXController>(p.first, p.second.baud_rate, p.second.arm_dxl_id.at(index), p.second.bus,
+        "open_manipulator_x_controller_" + name, name);
+
+      // The thread of the port calls control_step, so its period is the control_period of the arms
+      if (index == 0)
+        p.second.control_period = arm->get_control_period();
+      else if (arm->get_control_period() != p.second.control_period)
+      {
+        RCLCPP_ERROR(node->get_logger(), "%s runs every %.4f s but shares %s with arms running every %.4f s",
+          name.c_str(), arm->get_control_period(), p.first.c_str(), p.second.control_period);
+        rclcpp::shutdown();
+        return 1;
+      }
+      p.second.arm.push_back(arm);
+      RCLCPP_INFO(node->get_logger(), "%s is on %s every %.4f s", name.c_str(), p.first.c_str(), p.second.control_period);
+    }
+  }
+
+  // Every node on one executor keeps a single producer for each command queue
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+  for (auto & p : port)
+    for (auto & arm : p.second.arm)
+      executor.add_node(arm);
+
+  for (auto & p : port)
+    p.second.thread = std::thread(port_loop, &p.second, control_thread_priority, control_thread_cpu, node->get_logger());
+
+  executor.spin();
+
+  g_running = false;
+  for (auto & p : port)
+  {
+    if (p.second.thread.joinable()) p.second.thread.join();
+    p.second.arm.clear();
+    delete p.second.bus;
+  }
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef OPEN_MANIPULATOR_X_SYSTEM_HPP
+#define OPEN_MANIPULATOR_X_SYSTEM_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hardware_interface/base_interface.hpp"
+#include "hardware_interface/handle.hpp"
+#include "hardware_interface/hardware_info.hpp"
+#include "hardware_interface/system_interface.hpp"
+#include "hardware_interface/types/hardware_interface_return_values.hpp"
+#include "hardware_interface/types/hardware_interface_status_values.hpp"
+#include <rclcpp/rclcpp.hpp>
+
+#include "open_manipulator_x_libs/open_manipulator_x.hpp"
+
+namespace open_manipulator_x_hardware
+{
+#define NUM_OF_ARM_JOINT 4
+#define NUM_OF_SYSTEM_JOINT (NUM_OF_ARM_JOINT + 1)   // joint1-4, gripper
+
+/*****************************************************************************
+** ros2_control System Interface
+*****************************************************************************/
+// Exposes joint1-4 and the gripper to ros2_control. Each controller_manager
+// cycle is one SyncRead and one SyncWrite on the bus of the arm, through the
+// same JointDynamixelProfileControl and GripperDynamixel paths as the controller.
+class OpenManipulatorXSystem
+  : public hardware_interface::BaseInterface<hardware_interface::SystemInterface>
+{
+ public:
+  RCLCPP_SHARED_PTR_DEFINITIONS(OpenManipulatorXSystem)
+
+  OpenManipulatorXSystem();
+  virtual ~OpenManipulatorXSystem();
+
+  hardware_interface::return_type configure(const hardware_interface::HardwareInfo &info) override;
+  std::vector<hardware_interface::StateInterface> export_state_interfaces() override;
+  std::vector<hardware_interface::CommandInterface> export_command_interfaces() override;
+
+  hardware_interface::return_type start() override;
+  hardware_interface::return_type stop() override;
+
+  hardware_interface::return_type read() override;
+  hardware_interface::return_type write() override;
+
+ private:
+  /*****************************************************************************
+  ** Parameters
+  *****************************************************************************/
+  std::string usb_port_;
+  std::string baud_rate_;
+  std::string dxl_transfer_mode_;
+  bool dxl_baud_rate_rewrite_;
+  double control_period_;
+  std::vector<uint8_t> dxl_id_;
+
+  /*****************************************************************************
+  ** Variables
+  *****************************************************************************/
+  OpenManipulatorX open_manipulator_x_;
+  std::unique_ptr<dynamixel::DynamixelBus> dxl_bus_;   // open_manipulator_x_ does not own the bus
+  bool initialized_;
+
+  std::vector<JointValue> goal_joint_value_;
+  std::vector<JointValue> goal_tool_value_;
+  std::chrono::steady_clock::time_point previous_write_time_;
+  bool previous_write_valid_;   // false until the first write after start()
+
+  double hw_position_[NUM_OF_SYSTEM_JOINT];
+  double hw_velocity_[NUM_OF_SYSTEM_JOINT];
+  double hw_effort_[NUM_OF_SYSTEM_JOINT];
+  double hw_position_command_[NUM_OF_SYSTEM_JOINT];
+};
+}  // namespace open_manipulator_x_hardware
+#endif // OPEN_MANIPULATOR_X_SYSTEM_HPP
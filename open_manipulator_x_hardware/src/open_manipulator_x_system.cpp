@@ -0,0 +1,244 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "open_manipulator_x_hardware/open_manipulator_x_system.hpp"
+
+#include <algorithm>
+
+#include "hardware_interface/types/hardware_interface_type_values.hpp"
+#include "pluginlib/class_list_macros.hpp"
+
+namespace open_manipulator_x_hardware
+{
+static rclcpp::Logger logger = rclcpp::get_logger("OpenManipulatorXSystem");
+
+OpenManipulatorXSystem::OpenManipulatorXSystem()
+: initialized_(false),
+  previous_write_valid_(false)
+{
+  for (uint8_t i = 0; i < NUM_OF_SYSTEM_JOINT; i ++)
+  {
+    hw_position_[i] = 0.0;
+    hw_velocity_[i] = 0.0;
+    hw_effort_[i] = 0.0;
+    hw_position_command_[i] = 0.0;
+  }
+}
+
+OpenManipulatorXSystem::~OpenManipulatorXSystem()
+{
+  if (initialized_) open_manipulator_x_.disableAllActuator();
+  dxl_bus_.reset();
+}
+
+/*****************************************************************************
+** Configure
+*****************************************************************************/
+hardware_interface::return_type OpenManipulatorXSystem::configure(const hardware_interface::HardwareInfo &info)
+{
+  if (configure_default(info) != hardware_interface::return_type::OK)
+    return hardware_interface::return_type::ERROR;
+
+  // Hardware parameters of the <ros2_control> tag
+  auto get_parameter = [this](const std::string &name, const std::string &default_value) -> std::string
+  {
+    auto it = info_.hardware_parameters.find(name);
+    return (it == info_.hardware_parameters.end()) ? default_value : it->second;
+  };
+  usb_port_ = get_parameter("usb_port", "/dev/ttyUSB0");
+  baud_rate_ = get_parameter("baud_rate", "1000000");
+  dxl_transfer_mode_ = get_parameter("dxl_transfer_mode", DXL_TRANSFER_MODE_SYNC);
+  dxl_baud_rate_rewrite_ = (get_parameter("dxl_baud_rate_rewrite", "false") == "true");
+  control_period_ = std::stod(get_parameter("control_period", "0.010"));
+
+  if (info_.joints.size() != NUM_OF_SYSTEM_JOINT)
+  {
+    RCLCPP_ERROR(logger, "Expected %d joints (joint1-4, gripper), got %zu", NUM_OF_SYSTEM_JOINT, info_.joints.size());
+    return hardware_interface::return_type::ERROR;
+  }
+
+  dxl_id_.clear();
+  for (const hardware_interface::ComponentInfo &joint : info_.joints)
+  {
+    if (joint.command_interfaces.size() != 1 ||
+        joint.command_interfaces[0].name != hardware_interface::HW_IF_POSITION)
+    {
+      RCLCPP_ERROR(logger, "Joint '%s' needs exactly one position command interface", joint.name.c_str());
+      return hardware_interface::return_type::ERROR;
+    }
+    for (const hardware_interface::InterfaceInfo &state : joint.state_interfaces)
+    {
+      if (state.name != hardware_interface::HW_IF_POSITION &&
+          state.name != hardware_interface::HW_IF_VELOCITY &&
+          state.name != hardware_interface::HW_IF_EFFORT)
+      {
+        RCLCPP_ERROR(logger, "Joint '%s' has an unknown state interface '%s'", joint.name.c_str(), state.name.c_str());
+        return hardware_interface::return_type::ERROR;
+      }
+    }
+
+    auto id = joint.parameters.find("id");
+    if (id == joint.parameters.end())
+    {
+      RCLCPP_ERROR(logger, "Joint '%s' has no Dynamixel id parameter", joint.name.c_str());
+      return hardware_interface::return_type::ERROR;
+    }
+    dxl_id_.push_back(static_cast<uint8_t>(std::stoi(id->second)));
+  }
+
+  status_ = hardware_interface::status::CONFIGURED;
+  return hardware_interface::return_type::OK;
+}
+
+std::vector<hardware_interface::StateInterface> OpenManipulatorXSystem::export_state_interfaces()
+{
+  std::vector<hardware_interface::StateInterface> state_interfaces;
+  for (uint8_t i = 0; i < NUM_OF_SYSTEM_JOINT; i ++)
+  {
+    for (const hardware_interface::InterfaceInfo &state : info_.joints[i].state_interfaces)
+    {
+      double *value = &hw_position_[i];
+      if (state.name == hardware_interface::HW_IF_VELOCITY) value = &hw_velocity_[i];
+      else if (state.name == hardware_interface::HW_IF_EFFORT) value = &hw_effort_[i];
+      state_interfaces.emplace_back(info_.joints[i].name, state.name, value);
+    }
+  }
+  return state_interfaces;
+}
+
+std::vector<hardware_interface::CommandInterface> OpenManipulatorXSystem::export_command_interfaces()
+{
+  std::vector<hardware_interface::CommandInterface> command_interfaces;
+  for (uint8_t i = 0; i < NUM_OF_SYSTEM_JOINT; i ++)
+    command_interfaces.emplace_back(info_.joints[i].name, hardware_interface::HW_IF_POSITION, &hw_position_command_[i]);
+  return command_interfaces;
+}
+
+/*****************************************************************************
+** Start / Stop
+*****************************************************************************/
+hardware_interface::return_type OpenManipulatorXSystem::start()
+{
+  if (initialized_ == false)
+  {
+    // The system owns the bus, so read() and write() frame every transaction. A failed
+    // start() frees it again, so the port is closed and a retry opens it anew
+    dxl_bus_.reset(new dynamixel::DynamixelBus());
+    if (dxl_bus_->initialize(usb_port_, baud_rate_) == false)
+    {
+      RCLCPP_ERROR(logger, "Failed to open %s", usb_port_.c_str());
+      dxl_bus_.reset();
+      return hardware_interface::return_type::ERROR;
+    }
+    dxl_bus_->set_transfer_mode(dxl_transfer_mode_);
+    if (dxl_bus_->negotiate_baud_rate(dxl_id_, baud_rate_, dxl_baud_rate_rewrite_) == false)
+    {
+      RCLCPP_ERROR(logger, "The Dynamixels on %s don't answer at %s bps", usb_port_.c_str(), baud_rate_.c_str());
+      dxl_bus_.reset();
+      return hardware_interface::return_type::ERROR;
+    }
+
+    if (open_manipulator_x_.init_open_manipulator_x(false, usb_port_, baud_rate_, control_period_, dxl_id_,
+      KINEMATICS_SOLVER_OM_CHAIN_ANALYTIC, dxl_transfer_mode_, dxl_bus_.get()) == false)
+    {
+      RCLCPP_ERROR(logger, "Failed to initialize OpenManipulator-X on %s", usb_port_.c_str());
+      dxl_bus_.reset();
+      return hardware_interface::return_type::ERROR;
+    }
+    goal_joint_value_.resize(NUM_OF_ARM_JOINT);
+    goal_tool_value_.resize(1);
+    initialized_ = true;
+  }
+  else
+    open_manipulator_x_.enableAllActuator();
+
+  // Hold the present position until the first command
+  if (read() != hardware_interface::return_type::OK)
+    return hardware_interface::return_type::ERROR;
+  for (uint8_t i = 0; i < NUM_OF_SYSTEM_JOINT; i ++)
+    hw_position_command_[i] = hw_position_[i];
+  for (uint8_t i = 0; i < NUM_OF_ARM_JOINT; i ++)
+    goal_joint_value_[i].position = hw_position_[i];
+  previous_write_valid_ = false;
+
+  status_ = hardware_interface::status::STARTED;
+  RCLCPP_INFO(logger, "OpenManipulator-X on %s started", usb_port_.c_str());
+  return hardware_interface::return_type::OK;
+}
+
+hardware_interface::return_type OpenManipulatorXSystem::stop()
+{
+  if (initialized_) open_manipulator_x_.disableAllActuator();
+  status_ = hardware_interface::status::STOPPED;
+  return hardware_interface::return_type::OK;
+}
+
+/*****************************************************************************
+** Read / Write
+*****************************************************************************/
+hardware_interface::return_type OpenManipulatorXSystem::read()
+{
+  if (dxl_bus_->read_all() == false) return hardware_interface::return_type::ERROR;
+
+  std::vector<JointValue> joint_value = open_manipulator_x_.receiveAllJointActuatorValue();
+  std::vector<JointValue> tool_value = open_manipulator_x_.receiveAllToolActuatorValue();
+
+  for (uint8_t i = 0; i < NUM_OF_ARM_JOINT && i < joint_value.size(); i ++)
+  {
+    hw_position_[i] = joint_value.at(i).position;
+    hw_velocity_[i] = joint_value.at(i).velocity;
+    hw_effort_[i] = joint_value.at(i).effort;
+  }
+  if (tool_value.size() != 0)
+    hw_position_[NUM_OF_ARM_JOINT] = tool_value.at(0).position;
+
+  return hardware_interface::return_type::OK;
+}
+
+hardware_interface::return_type OpenManipulatorXSystem::write()
+{
+  // Velocity of the commanded position over the period that actually elapsed since the last
+  // write feeds the profile feed-forward, bounded so a stall doesn't overshoot
+  std::chrono::steady_clock::time_point write_time = std::chrono::steady_clock::now();
+  double write_period = control_period_;
+  if (previous_write_valid_)
+  {
+    double elapsed = std::chrono::duration<double>(write_time - previous_write_time_).count();
+    if (elapsed > 0.0) write_period = std::min(elapsed, 2.0 * control_period_);
+  }
+  previous_write_time_ = write_time;
+  previous_write_valid_ = true;
+
+  for (uint8_t i = 0; i < NUM_OF_ARM_JOINT; i ++)
+  {
+    goal_joint_value_[i].velocity = (hw_position_command_[i] - goal_joint_value_[i].position) / write_period;
+    goal_joint_value_[i].position = hw_position_command_[i];
+    goal_joint_value_[i].acceleration = 0.0;
+    goal_joint_value_[i].effort = 0.0;
+  }
+  goal_tool_value_[0].position = hw_position_command_[NUM_OF_ARM_JOINT];
+
+  open_manipulator_x_.sendAllJointActuatorValue(goal_joint_value_);
+  open_manipulator_x_.sendAllToolActuatorValue(goal_tool_value_);
+
+  if (dxl_bus_->write_all() == false) return hardware_interface::return_type::ERROR;
+  return hardware_interface::return_type::OK;
+}
+}  // namespace open_manipulator_x_hardware
+
+PLUGINLIB_EXPORT_CLASS(open_manipulator_x_hardware::OpenManipulatorXSystem, hardware_interface::SystemInterface)
@@ -0,0 +1,300 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+// Micro-benchmarks of the kinematics, drawing trajectories and Dynamixel value conversions.
+// Build with -DBUILD_BENCHMARKS=ON and keep the results as JSON to compare runs:
+//   ros2 run open_manipulator_x_libs open_manipulator_x_libs_benchmark --benchmark_format=json --benchmark_out=result.json
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include "open_manipulator_x_libs/open_manipulator_x.hpp"
+
+#define NUM_OF_TARGET 256
+#define TOOL_NAME "gripper"
+
+namespace
+{
+/*****************************************************************************
+** Fixtures
+*****************************************************************************/
+// Chain of OpenManipulatorX in simulation, so no actuator is touched
+Manipulator &get_manipulator()
+{
+  static OpenManipulatorX open_manipulator_x;
+  static bool initialized = false;
+  if (!initialized)
+  {
+    open_manipulator_x.init_open_manipulator_x(true);
+    initialized = true;
+  }
+  return *open_manipulator_x.getManipulator();
+}
+
+// Same joint sets and target poses on every run (fixed seed, within the joint limits)
+const std::vector<std::vector<double>> &get_joint_set()
+{
+  static std::vector<std::vector<double>> joint_set;
+  if (joint_set.empty())
+  {
+    Manipulator &manipulator = get_manipulator();
+    std::vector<Name> joint_name = manipulator.getAllActiveJointComponentName();
+    std::mt19937 generator(20190101);
+
+    for (uint32_t index = 0; index < NUM_OF_TARGET; index++)
+    {
+      std::vector<double> joint_position;
+      for (uint8_t joint = 0; joint < joint_name.size(); joint++)
+      {
+        std::uniform_real_distribution<double> distribution(manipulator.getJointMinLimit(joint_name.at(joint)),
+                                                            manipulator.getJointMaxLimit(joint_name.at(joint)));
+        joint_position.push_back(distribution(generator));
+      }
+      joint_set.push_back(joint_position);
+    }
+  }
+  return joint_set;
+}
+
+const std::vector<Pose> &get_target_pose()
+{
+  static std::vector<Pose> target_pose;
+  if (target_pose.empty())
+  {
+    Manipulator manipulator = get_manipulator();
+    kinematics::SolverUsingCRAndJacobian solver;
+    for (const std::vector<double> &joint_position : get_joint_set())
+    {
+      manipulator.setAllActiveJointPosition(joint_position);
+      solver.solveForwardKinematics(&manipulator);
+      target_pose.push_back(manipulator.getComponentPoseFromWorld(TOOL_NAME));
+    }
+  }
+  return target_pose;
+}
+
+/*****************************************************************************
+** Kinematics
+*****************************************************************************/
+template <class Solver>
+void BM_ForwardKinematics(benchmark::State &state)
+{
+  Manipulator manipulator = get_manipulator();
+  const std::vector<std::vector<double>> &joint_set = get_joint_set();
+  Solver solver;
+  uint32_t index = 0;
+
+  for (auto _ : state)
+  {
+    manipulator.setAllActiveJointPosition(joint_set.at(index++ % NUM_OF_TARGET));
+    solver.solveForwardKinematics(&manipulator);
+    benchmark::DoNotOptimize(manipulator);
+  }
+}
+
+template <class Solver>
+void BM_Jacobian(benchmark::State &state)
+{
+  Manipulator manipulator = get_manipulator();
+  const std::vector<std::vector<double>> &joint_set = get_joint_set();
+  Solver solver;
+  uint32_t index = 0;
+
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    manipulator.setAllActiveJointPosition(joint_set.at(index++ % NUM_OF_TARGET));
+    solver.solveForwardKinematics(&manipulator);
+    state.ResumeTiming();
+
+    Eigen::MatrixXd jacobian = solver.jacobian(&manipulator, TOOL_NAME);
+    benchmark::DoNotOptimize(jacobian.data());
+  }
+}
+
+// Every target is solved from the zero pose; success_rate is the share of converged targets
+template <class Solver>
+void BM_InverseKinematics(benchmark::State &state)
+{
+  Manipulator manipulator = get_manipulator();
+  const std::vector<Pose> &target_pose = get_target_pose();
+  std::vector<double> zero_position(manipulator.getDOF(), 0.0);
+  Solver solver;
+  uint32_t index = 0;
+  uint32_t success = 0;
+
+  for (auto _ : state)
+  {
+    manipulator.setAllActiveJointPosition(zero_position);
+    solver.solveForwardKinematics(&manipulator);
+
+    std::vector<JointValue> goal_joint_value;
+    if (solver.solveInverseKinematics(&manipulator, TOOL_NAME, target_pose.at(index++ % NUM_OF_TARGET), &goal_joint_value))
+      success++;
+    benchmark::DoNotOptimize(goal_joint_value.data());
+  }
+  state.counters["success_rate"] = benchmark::Counter(static_cast<double>(success) / state.iterations());
+}
+
+void BM_OMChainKernelForward(benchmark::State &state)
+{
+  kinematics::OMChainKernel chain;
+  chain.load(&get_manipulator());
+  const std::vector<std::vector<double>> &joint_set = get_joint_set();
+  uint32_t index = 0;
+
+  for (auto _ : state)
+  {
+    const std::vector<double> &joint_position = joint_set.at(index++ % NUM_OF_TARGET);
+    chain.forward(Eigen::Map<const Eigen::Matrix<double, 4, 1>>(joint_position.data()));
+    benchmark::DoNotOptimize(chain.get_frame_position(4).data());
+  }
+}
+
+#define KINEMATICS_BENCHMARK(solver) \
+  BENCHMARK_TEMPLATE(BM_ForwardKinematics, solver); \
+  BENCHMARK_TEMPLATE(BM_Jacobian, solver); \
+  BENCHMARK_TEMPLATE(BM_InverseKinematics, solver)->UseRealTime()   // multi-start solves on worker threads
+
+KINEMATICS_BENCHMARK(kinematics::SolverUsingCRAndJacobian);
+KINEMATICS_BENCHMARK(kinematics::SolverUsingCRAndSRJacobian);
+KINEMATICS_BENCHMARK(kinematics::SolverUsingCRAndSRPositionOnlyJacobian);
+KINEMATICS_BENCHMARK(kinematics::SolverCustomizedforOMChain);
+KINEMATICS_BENCHMARK(kinematics::SolverAnalyticOMChain);
+KINEMATICS_BENCHMARK(kinematics::SolverMultiStartOMChain);
+BENCHMARK(BM_OMChainKernelForward);
+
+/*****************************************************************************
+** Drawing Trajectories
+*****************************************************************************/
+TaskWaypoint get_drawing_start()
+{
+  TaskWaypoint start;
+  start.kinematic.position = Eigen::Vector3d(0.2, 0.0, 0.2);
+  start.kinematic.orientation = Eigen::Matrix3d::Identity();
+  return start;
+}
+
+// One evaluation of the path at a tick swept over the move time
+template <class Trajectory, TaskWaypoint (Trajectory::*draw)(double)>
+void BM_Drawing(benchmark::State &state, const void *arg)
+{
+  const double move_time = 4.0;
+  Trajectory trajectory;
+  trajectory.makeTaskTrajectory(move_time, get_drawing_start(), arg);
+  uint32_t index = 0;
+
+  for (auto _ : state)
+  {
+    TaskWaypoint pose = (trajectory.*draw)((index++ % 400) * move_time / 400);
+    benchmark::DoNotOptimize(pose.kinematic.position.data());
+  }
+}
+
+void BM_DrawLine(benchmark::State &state)
+{
+  TaskWaypoint delta;
+  delta.kinematic.position = Eigen::Vector3d(0.0, 0.05, 0.0);
+  BM_Drawing<custom_trajectory::Line, &custom_trajectory::Line::draw_line>(state, &delta);
+}
+
+void BM_DrawCircle(benchmark::State &state)
+{
+  double arg[3] = {0.02, 1.0, 0.0};   // radius, revolution, start angular position
+  BM_Drawing<custom_trajectory::Circle, &custom_trajectory::Circle::draw_circle>(state, arg);
+}
+
+void BM_DrawRhombus(benchmark::State &state)
+{
+  double arg[3] = {0.02, 1.0, 0.0};
+  BM_Drawing<custom_trajectory::Rhombus, &custom_trajectory::Rhombus::draw_rhombus>(state, arg);
+}
+
+void BM_DrawHeart(benchmark::State &state)
+{
+  double arg[3] = {0.02, 1.0, 0.0};
+  BM_Drawing<custom_trajectory::Heart, &custom_trajectory::Heart::draw_heart>(state, arg);
+}
+
+BENCHMARK(BM_DrawLine);
+BENCHMARK(BM_DrawCircle);
+BENCHMARK(BM_DrawRhombus);
+BENCHMARK(BM_DrawHeart);
+
+/*****************************************************************************
+** Dynamixel Value Conversion
+*****************************************************************************/
+// X series position range, as the control table of XM430-W350 (no port needed)
+#define X_SERIES_MAX_POSITION 4095
+#define X_SERIES_MIN_POSITION 0
+#define X_SERIES_MAX_RADIAN   3.14159265
+#define X_SERIES_MIN_RADIAN   -3.14159265
+
+void BM_ConvertRadian2Value(benchmark::State &state)
+{
+  DynamixelWorkbench dynamixel_workbench;
+  const std::vector<std::vector<double>> &joint_set = get_joint_set();
+  uint32_t index = 0;
+
+  for (auto _ : state)
+  {
+    const std::vector<double> &joint_position = joint_set.at(index++ % NUM_OF_TARGET);
+    int32_t value[4];
+    for (uint8_t joint = 0; joint < 4; joint++)
+      value[joint] = dynamixel_workbench.convertRadian2Value(joint_position.at(joint),
+        X_SERIES_MAX_POSITION, X_SERIES_MIN_POSITION, X_SERIES_MAX_RADIAN, X_SERIES_MIN_RADIAN);
+    benchmark::DoNotOptimize(value);
+  }
+}
+
+void BM_ConvertValue2Radian(benchmark::State &state)
+{
+  DynamixelWorkbench dynamixel_workbench;
+  int32_t value = 0;
+
+  for (auto _ : state)
+  {
+    float radian[4];
+    for (uint8_t joint = 0; joint < 4; joint++)
+      radian[joint] = dynamixel_workbench.convertValue2Radian((value++) & X_SERIES_MAX_POSITION,
+        X_SERIES_MAX_POSITION, X_SERIES_MIN_POSITION, X_SERIES_MAX_RADIAN, X_SERIES_MIN_RADIAN);
+    benchmark::DoNotOptimize(radian);
+  }
+}
+
+void BM_ConvertValue2Current(benchmark::State &state)
+{
+  DynamixelWorkbench dynamixel_workbench;
+  int16_t value = 0;
+
+  for (auto _ : state)
+  {
+    float current[4];
+    for (uint8_t joint = 0; joint < 4; joint++)
+      current[joint] = dynamixel_workbench.convertValue2Current((int16_t)((value++) & 0x3FF));
+    benchmark::DoNotOptimize(current);
+  }
+}
+
+BENCHMARK(BM_ConvertRadian2Value);
+BENCHMARK(BM_ConvertValue2Radian);
+BENCHMARK(BM_ConvertValue2Current);
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,96 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef COLLISION_CHECKER_HPP
+#define COLLISION_CHECKER_HPP
+
+#include "kinematics.hpp"
+
+#include <vector>
+
+namespace collision
+{
+#define NUM_OF_COLLISION_LINK 7
+#define COLLISION_LINK1            0
+#define COLLISION_LINK2            1
+#define COLLISION_LINK3            2
+#define COLLISION_LINK4            3
+#define COLLISION_LINK5            4
+#define COLLISION_GRIPPER_LINK     5
+#define COLLISION_GRIPPER_LINK_SUB 6
+#define COLLISION_ENVIRONMENT      NUM_OF_COLLISION_LINK   // ground or an obstacle box
+
+// Segment a - b swept by radius, in the frame of its link (unit: m)
+typedef struct
+{
+  Eigen::Vector3d a;
+  Eigen::Vector3d b;
+  double radius;
+} Capsule;
+
+typedef struct
+{
+  Eigen::Vector3d min_corner;
+  Eigen::Vector3d max_corner;
+} Box;
+
+/*****************************************************************************
+** Collision Checker
+*****************************************************************************/
+// One capsule per link of open_manipulator_x_description, fitted to the STL
+// meshes, checked pairwise except the pairs disabled in open_manipulator.srdf,
+// and against the ground and axis-aligned boxes in the world frame.
+class CollisionChecker
+{
+ public:
+  CollisionChecker();
+  virtual ~CollisionChecker(){}
+
+  bool load(Manipulator *manipulator);
+  bool is_loaded() const;
+
+  void set_padding(double padding);               // added to every radius (unit: m)
+  void set_ground_height(double ground_height);   // links past link2 stay above it (unit: m, -INFINITY : off)
+  void add_box(const Eigen::Vector3d &min_corner, const Eigen::Vector3d &max_corner);
+  void clear_boxes();
+
+  // joint1-4 (unit: rad) and gripper opening (unit: m). The first colliding pair is written to link and other
+  bool is_colliding(const Eigen::Matrix<double, 4, 1> &joint_position, double gripper_position, uint8_t *link = nullptr, uint8_t *other = nullptr);
+  static const char *get_link_name(uint8_t index);
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  kinematics::OMChainKernel chain_;
+  Capsule capsule_[NUM_OF_COLLISION_LINK];
+  bool check_pair_[NUM_OF_COLLISION_LINK][NUM_OF_COLLISION_LINK];
+  double padding_;
+  double ground_height_;
+  std::vector<Box> box_;
+
+  // World frame capsule end points of the last check
+  Eigen::Vector3d a_[NUM_OF_COLLISION_LINK];
+  Eigen::Vector3d b_[NUM_OF_COLLISION_LINK];
+
+  void disable_pair(uint8_t link, uint8_t other);
+  bool is_colliding_with_environment(uint8_t link) const;
+  static double get_segment_distance(const Eigen::Vector3d &p1, const Eigen::Vector3d &q1, const Eigen::Vector3d &p2, const Eigen::Vector3d &q2);
+  static double get_box_distance(const Eigen::Vector3d &p, const Eigen::Vector3d &q, const Box &box);
+};
+}  // namespace collision
+#endif // COLLISION_CHECKER_HPP
@@ -36,6 +36,130 @@ enum AXIS{
 	Z_AXIS,
 };
 
+/*****************************************************************************
+** Path Samples
+*****************************************************************************/
+// Planar offsets from the start pose sampled every sample period (x, y, vx, vy per sample).
+// The samples are task space only: a waypoint keeps the start z and orientation, carries
+// no acceleration (linear and angular are zero, as in the drawing functions) and still
+// goes through IK on every tick. Joint positions and velocities are not sampled here;
+// plan_precomputed_custom_trajectory gives those.
+class PathSamples
+{
+ public:
+  PathSamples() : sample_period_(0.0), step_(0.0) {}
+  virtual ~PathSamples() {}
+
+  void set_sample_period(double sample_period);
+  bool is_enabled() const;
+
+  uint32_t begin(double move_time);   // number of samples to push, sample i is at get_tick(i)
+  double get_tick(uint32_t index) const;
+  void push_back(double x, double y);
+  void finish();
+  void lookup(double tick, double *x, double *y, double *vx, double *vy) const;
+  TaskWaypoint get_waypoint(double tick, const TaskWaypoint &start) const;   // start pose moved by the sampled offset
+
+ private:
+  double sample_period_;
+  double step_;
+  std::vector<double> sample_;
+};
+
+/*****************************************************************************
+** Sampled Joint Path
+*****************************************************************************/
+// Joint waypoints sampled every sample_period seconds, starting at tick 0
+typedef struct
+{
+  double sample_period;
+  std::vector<JointWaypoint> waypoint;
+} JointSamples;
+
+class SampledJointPath : public robotis_manipulator::CustomJointTrajectory
+{
+ public:
+  SampledJointPath() {}
+  virtual ~SampledJointPath() {}
+
+  virtual void setOption(const void *arg);
+  virtual void makeJointTrajectory(double move_time, JointWaypoint start, const void *arg);   // arg : JointSamples, swapped with the previous ones
+  virtual JointWaypoint getJointWaypoint(double tick);
+
+ private:
+  JointSamples samples_;
+};
+
+/*****************************************************************************
+** Time-Optimal Parameterization
+*****************************************************************************/
+// Retimes a joint path as fast as the joint velocity and acceleration limits
+// allow (TOPP by reachability analysis: a backward pass for the controllable
+// path speed, then a greedy forward pass). The path ends at rest and starts at
+// start_speed (path points per second), at rest by default.
+class TimeOptimalParameterization
+{
+ public:
+  TimeOptimalParameterization() {}
+  virtual ~TimeOptimalParameterization() {}
+
+  // Per joint (unit: rad/s, rad/s^2)
+  void set_joint_limit(std::vector<double> max_velocity, std::vector<double> max_acceleration);
+  bool is_enabled() const;
+
+  // path holds the joint positions in path order at any spacing; samples is resampled every sample_period
+  bool parameterize(const std::vector<JointWaypoint> &path, double sample_period, JointSamples *samples, double *move_time, double start_speed = 0.0);
+
+ private:
+  std::vector<double> max_velocity_;
+  std::vector<double> max_acceleration_;
+
+  // dq/ds and d2q/ds2 at every path point, s being the path index
+  uint8_t num_of_joint_;
+  std::vector<double> first_derivative_;
+  std::vector<double> second_derivative_;
+
+  // Range of the path acceleration at path point index for the squared path speed x
+  bool get_acceleration_range(uint32_t index, double x, double *lower, double *upper) const;
+  double get_velocity_limit(uint32_t index) const;
+};
+
+/*****************************************************************************
+** Blended Joint Path
+*****************************************************************************/
+// Per joint limits of the blended joint path (unit: rad/s, rad/s^2, rad/s^3)
+typedef struct
+{
+  std::vector<double> max_velocity;
+  std::vector<double> max_acceleration;
+  std::vector<double> max_jerk;
+} JointLimit;
+
+// Quintic from the present goal waypoint to a new goal, keeping position,
+// velocity and acceleration continuous. A goal that arrives mid-motion
+// replaces the tail of the active path instead of stopping first.
+class BlendedJointPath : public robotis_manipulator::CustomJointTrajectory
+{
+ public:
+  BlendedJointPath() : move_time_(0.0) {}
+  virtual ~BlendedJointPath() {}
+
+  // Shortest move time, not under min_move_time, for which the path stays within the joint limits
+  double get_move_time(const JointWaypoint &start, const JointWaypoint &goal, double min_move_time) const;
+
+  virtual void setOption(const void *arg);   // JointLimit
+  virtual void makeJointTrajectory(double move_time, JointWaypoint start, const void *arg);   // arg : goal JointWaypoint
+  virtual JointWaypoint getJointWaypoint(double tick);
+
+ private:
+  JointLimit limit_;
+  double move_time_;
+  std::vector<Matrix<double, 6, 1>, Eigen::aligned_allocator<Matrix<double, 6, 1>>> coefficient_;
+
+  static void calc_coefficient(const JointValue &start, const JointValue &goal, double move_time, Matrix<double, 6, 1> *coefficient);
+  bool is_in_limit(const JointWaypoint &start, const JointWaypoint &goal, double move_time) const;
+};
+
 /*****************************************************************************
 ** Line
 *****************************************************************************/
@@ -73,7 +197,7 @@ class Circle : public robotis_manipulator::CustomTaskTrajectory
   void init_circle(double move_time, TaskWaypoint start, double radius, double revolution, double start_angular_position);
   TaskWaypoint draw_circle(double time_var);
 
-  virtual void setOption(const void *arg);
+  virtual void setOption(const void *arg);   // sample period (sec) of the task space samples, 0.0 : off
   virtual void makeTaskTrajectory(double move_time, TaskWaypoint start, const void *arg);
   virtual TaskWaypoint getTaskWaypoint(double tick);
 
@@ -87,6 +211,8 @@ class Circle : public robotis_manipulator::CustomTaskTrajectory
   double radius_;
   double start_angular_position_;
   double revolution_;
+
+  PathSamples samples_;
 };
 
 /*****************************************************************************
@@ -101,7 +227,7 @@ class Rhombus : public robotis_manipulator::CustomTaskTrajectory
   void init_rhombus(double move_time, TaskWaypoint start, double radius, double revolution, double start_angular_position);
   TaskWaypoint draw_rhombus(double time_var);
 
-  virtual void setOption(const void *arg);
+  virtual void setOption(const void *arg);   // sample period (sec) of the task space samples, 0.0 : off
   virtual void makeTaskTrajectory(double move_time, TaskWaypoint start, const void *arg);
   virtual TaskWaypoint getTaskWaypoint(double tick);
 
@@ -115,6 +241,8 @@ class Rhombus : public robotis_manipulator::CustomTaskTrajectory
   double radius_;
   double start_angular_position_;
   double revolution_;
+
+  PathSamples samples_;
 };
 
 /*****************************************************************************
@@ -129,7 +257,7 @@ class Heart : public robotis_manipulator::CustomTaskTrajectory
   void init_heart(double move_time, TaskWaypoint start, double radius, double revolution, double start_angular_position);
   TaskWaypoint draw_heart(double tick);
 
-  virtual void setOption(const void *arg);
+  virtual void setOption(const void *arg);   // sample period (sec) of the task space samples, 0.0 : off
   virtual void makeTaskTrajectory(double move_time, TaskWaypoint start, const void *arg);
   virtual TaskWaypoint getTaskWaypoint(double tick);
 
@@ -143,6 +271,8 @@ class Heart : public robotis_manipulator::CustomTaskTrajectory
   double radius_;
   double start_angular_position_;
   double revolution_;
+
+  PathSamples samples_;
 };
 } // namespace custom_trajectory
 #endif // CUSTOM_TRAJECTORY_HPP
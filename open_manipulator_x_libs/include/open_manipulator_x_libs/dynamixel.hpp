@@ -27,14 +27,29 @@
   #include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace dynamixel
 {
 #define SYNC_WRITE_HANDLER 0
 #define SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT 0
+#define SYNC_READ_HANDLER_FOR_CONFIGURATION 1
 
 //#define CONTROL_LOOP_TIME 10;    //ms
 
+#define DXL_TRANSFER_MODE_SYNC "sync"
+#define DXL_TRANSFER_MODE_BULK "bulk"
+
 // Protocol 2.0
+#define ADDR_RETURN_DELAY_TIME_2 9
+#define ADDR_DRIVE_MODE_2 10
+#define ADDR_OPERATING_MODE_2 11
+#define ADDR_TORQUE_ENABLE_2 64
+#define ADDR_GOAL_CURRENT_2 102
 #define ADDR_PRESENT_CURRENT_2 126
 #define ADDR_PRESENT_VELOCITY_2 128
 #define ADDR_PRESENT_POSITION_2 132
@@ -44,6 +59,11 @@ namespace dynamixel
 #define ADDR_PROFILE_VELOCITY_2 112
 #define ADDR_GOAL_POSITION_2 116
 
+#define LENGTH_RETURN_DELAY_TIME_2 1
+#define LENGTH_DRIVE_MODE_2 1
+#define LENGTH_OPERATING_MODE_2 1
+#define LENGTH_TORQUE_ENABLE_2 1
+#define LENGTH_GOAL_CURRENT_2 2
 #define LENGTH_PRESENT_CURRENT_2 2
 #define LENGTH_PRESENT_VELOCITY_2 4
 #define LENGTH_PRESENT_POSITION_2 4
@@ -53,6 +73,10 @@ namespace dynamixel
 #define LENGTH_PROFILE_VELOCITY_2 4
 #define LENGTH_GOAL_POSITION_2 4
 
+#define OPERATING_MODE_POSITION 3
+#define OPERATING_MODE_CURRENT_BASED_POSITION 5
+#define DRIVE_MODE_TIME_BASED_PROFILE 0x04
+
 // Protocol 1.0
 #define ADDR_PRESENT_CURRENT_1 = 40;
 #define ADDR_PRESENT_VELOCITY_1 = 38;
@@ -62,12 +86,161 @@ namespace dynamixel
 #define LENGTH_PRESENT_VELOCITY_1 = 2;
 #define LENGTH_PRESENT_POSITION_1 = 2;
 
+#define BUS_ERROR_NONE    0
+#define BUS_ERROR_TIMEOUT 1   // no status packet
+#define BUS_ERROR_CORRUPT 2   // status packet failed the CRC or is malformed
+#define BUS_ERROR_OTHER   3   // port busy, instruction packet not sent, ...
+
 typedef struct
 {
   std::vector<uint8_t> id;
   uint8_t num;
 } Joint;
 
+// Read errors of one actuator on a DynamixelBus since it was added
+typedef struct
+{
+  uint32_t timeout;
+  uint32_t crc_error;
+  uint32_t packet_loss;   // cycles its present values were held from an earlier read
+  uint32_t stale_cycle;   // of them in a row up to now (0: fresh)
+} ActuatorErrorCounter;
+
+// Control table of one actuator as DynamixelBus::read_configuration found it
+typedef struct
+{
+  int32_t return_delay_time;
+  int32_t drive_mode;
+  int32_t operating_mode;
+  int32_t torque_enable;
+  int32_t goal_current;
+  int32_t profile_acceleration;
+  int32_t profile_velocity;
+} ActuatorConfiguration;
+
+// Transactions of a DynamixelBus, retries included
+typedef struct
+{
+  uint32_t read;
+  uint32_t read_error;
+  uint32_t write;
+  uint32_t write_error;
+  uint32_t retry;
+} BusErrorCounter;
+
+/*****************************************************************************
+** Dynamixel Bus
+*****************************************************************************/
+// Owns the port shared by every actuator on it. Present current, velocity and
+// position of all registered ids are read in one transaction per cycle and the
+// staged goal positions are written in one transaction. Pipelined, both run on
+// an I/O thread while the caller computes the next cycle.
+class DynamixelBus
+{
+ public:
+  DynamixelBus();
+  virtual ~DynamixelBus();
+
+  bool initialize(STRING dxl_device_name, STRING dxl_baud_rate);
+  // Ping actuator_id at dxl_baud_rate (e.g. "4000000"). With rewrite, actuators that don't answer
+  // are looked for at the other known rates and moved to dxl_baud_rate (an EEPROM write with the
+  // torque off). Call once per port, with every id on it
+  bool negotiate_baud_rate(std::vector<uint8_t> actuator_id, STRING dxl_baud_rate, bool rewrite = false);
+  // DXL_TRANSFER_MODE_SYNC (Sync Read/Write) or DXL_TRANSFER_MODE_BULK (Bulk Read/Write)
+  bool set_transfer_mode(STRING transfer_mode);
+  DynamixelWorkbench *get_workbench();
+
+  bool add_id(std::vector<uint8_t> actuator_id);
+  // False if some ids hold their last good values
+  bool read_all();
+  bool get_present_value(uint8_t actuator_id, int32_t *current, int32_t *velocity, int32_t *position);
+  bool stage_goal_position(uint8_t actuator_id, int32_t goal_position);
+  bool write_all();
+
+  // Round trip of the last read_all / write_all (unit: s)
+  double get_read_time() const;
+  double get_write_time() const;
+
+  /*****************************************************************************
+  ** Error Accounting
+  *****************************************************************************/
+  // A failed read_all is repeated up to max_retry times, then the ids are read one at a
+  // time so only those that don't answer hold their last good values. A failed write_all
+  // is repeated as often. No attempt starts later than budget after the first (unit: s)
+  void set_retry_policy(uint8_t max_retry, double budget);
+  // Safe from any thread, also during a pipelined transfer
+  bool get_error_counter(uint8_t actuator_id, ActuatorErrorCounter *counter) const;
+  BusErrorCounter get_bus_error_counter() const;
+  // SDK text of the last failed transaction (NULL without one)
+  const char *get_last_error() const;
+
+  /*****************************************************************************
+  ** Warm Start
+  *****************************************************************************/
+  // Read the configuration registers of actuator_id in one transaction. Until
+  // clear_configuration, write_register skips the values they already have
+  bool read_configuration(std::vector<uint8_t> actuator_id);
+  bool get_configuration(uint8_t actuator_id, ActuatorConfiguration *configuration) const;
+  bool is_operating_mode(uint8_t actuator_id, int32_t operating_mode) const;
+  bool write_register(uint8_t actuator_id, const char *item_name, int32_t value, const char **log);
+  void clear_configuration();
+
+  /*****************************************************************************
+  ** Pipelined Transfer
+  *****************************************************************************/
+  bool start_pipeline();
+  void stop_pipeline();
+  bool is_pipelined() const;
+  // Hand the staged goals to the I/O thread, which runs write_all then read_all
+  bool start_transfer();
+  // Block until the transfer in flight is done. The present values and the
+  // staged goals belong to the I/O thread until then
+  bool wait_transfer();
+  // Since the last read_all received the present values (unit: s)
+  double get_present_value_age() const;
+
+ private:
+  DynamixelWorkbench *dynamixel_workbench_;
+  Joint dynamixel_;
+  bool sdk_handler_added_;
+  bool bulk_;
+
+  std::vector<int32_t> present_current_;
+  std::vector<int32_t> present_velocity_;
+  std::vector<int32_t> present_position_;
+  std::vector<int32_t> goal_position_;
+  std::vector<bool> goal_staged_;
+
+  uint8_t max_retry_;
+  double retry_budget_;
+  std::vector<ActuatorErrorCounter> error_counter_;
+  BusErrorCounter bus_error_counter_;
+  const char *last_error_;
+
+  std::map<uint8_t, ActuatorConfiguration> configuration_;
+
+  std::atomic<double> read_time_;
+  std::atomic<double> write_time_;
+  std::chrono::steady_clock::time_point read_end_time_;
+
+  std::thread io_thread_;
+  std::mutex io_mutex_;
+  std::condition_variable io_condition_;
+  bool io_thread_running_;
+  bool transfer_pending_;
+  bool transfer_result_;
+
+  bool ping_all(std::vector<uint8_t> actuator_id);
+  int8_t find_index(uint8_t actuator_id) const;
+  void io_thread_loop();
+  void add_sdk_handler(uint8_t actuator_id);
+  // One transaction for the ids from first_index on, unpacked into the present values on success
+  bool read_block(uint8_t first_index, uint8_t id_num, bool bulk, const char **log);
+  bool write_block(uint8_t *id_array, int32_t *goal_value, uint8_t id_num, const char **log);
+  bool is_within_budget(std::chrono::steady_clock::time_point start) const;
+  void count_error(uint32_t *counter, const char *log);
+};
+
 class JointDynamixel : public robotis_manipulator::JointActuator
 {
  public:
@@ -100,6 +273,9 @@ class JointDynamixel : public robotis_manipulator::JointActuator
  private:
   DynamixelWorkbench *dynamixel_workbench_;
   Joint dynamixel_;
+  // Held when a read fails. Empty until the first good read, so a failed read returns no
+  // values instead of zeros and the manipulator keeps the joint values it has
+  std::vector<robotis_manipulator::ActuatorValue> last_present_value_;
 };
 
 class JointDynamixelProfileControl : public robotis_manipulator::JointActuator
@@ -108,6 +284,15 @@ class JointDynamixelProfileControl : public robotis_manipulator::JointActuator
   JointDynamixelProfileControl(float control_loop_time = 0.010);
   virtual ~JointDynamixelProfileControl(){}
 
+  // Share the port and the combined read of bus (call before init)
+  void set_bus(DynamixelBus *bus);
+  // Elapsed time of the present control cycle, used for the velocity feed-forward (unit: s)
+  void set_present_loop_time(float present_loop_time);
+  // Time the goals wait between planning and the pipelined bus write, added to the feed-forward (unit: s)
+  void set_goal_delay(float goal_delay);
+  // Time-based Profile_Velocity/Profile_Acceleration written in position_mode (unit: ms)
+  static void get_time_based_profile(float control_loop_time, uint32_t *profile_velocity, uint32_t *profile_acceleration);
+
   /*****************************************************************************
   ** Joint Dynamixel Profile Control Functions
   *****************************************************************************/
@@ -133,17 +318,26 @@ class JointDynamixelProfileControl : public robotis_manipulator::JointActuator
 
  private:
   DynamixelWorkbench *dynamixel_workbench_;
+  DynamixelBus *bus_;
   Joint dynamixel_;
-  float control_loop_time_; // unit: ms
+  float control_loop_time_; // unit: s
+  float present_loop_time_; // unit: s
+  float goal_delay_;        // unit: s
   std::map<uint8_t, robotis_manipulator::ActuatorValue> previous_goal_value_;
+  // Held when a read fails. Empty until the first good read, so a failed read returns no
+  // values instead of zeros and the manipulator keeps the joint values it has
+  std::vector<robotis_manipulator::ActuatorValue> last_present_value_;
 };
 
 class GripperDynamixel : public robotis_manipulator::ToolActuator
 {
  public:
-  GripperDynamixel() {}
+  GripperDynamixel() : bus_(nullptr), last_present_value_() {}
   virtual ~GripperDynamixel() {}
 
+  // Share the port and the combined read of bus (call before init)
+  void set_bus(DynamixelBus *bus);
+
   /*****************************************************************************
   ** Tool Dynamixel Control Functions
   *****************************************************************************/
@@ -166,10 +360,14 @@ class GripperDynamixel : public robotis_manipulator::ToolActuator
   bool write_profile_value(STRING profile_mode, uint32_t value);
   bool write_goal_position(double radian);
   double receive_dynamixel_value();
+  // Present current (unit: mA), velocity (unit: rad/s) and position (unit: rad) from one read
+  robotis_manipulator::ActuatorValue receive_all_dynamixel_value();
 
  private:
   DynamixelWorkbench *dynamixel_workbench_;
+  DynamixelBus *bus_;
   Joint dynamixel_;
+  robotis_manipulator::ActuatorValue last_present_value_;  // held when a read fails
 };
 }  // namespace DYNAMIXEL
 #endif // DYNAMIXEL_HPP
@@ -0,0 +1,83 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef GRASP_DETECTOR_HPP
+#define GRASP_DETECTOR_HPP
+
+#include <cstdint>
+
+namespace grasp
+{
+#define GRASP_STATE_IDLE    0   // opening, or no goal yet
+#define GRASP_STATE_CLOSING 1
+#define GRASP_STATE_HOLDING 2
+#define GRASP_STATE_EMPTY   3   // closed to the goal without meeting anything
+#define GRASP_STATE_SLIPPED 4
+
+#define GRASP_EVENT_NONE    0
+#define GRASP_EVENT_GRASPED 1
+#define GRASP_EVENT_EMPTY   2
+#define GRASP_EVENT_SLIPPED 3
+
+typedef struct
+{
+  double grasp_current;     // |current| from which the fingers press on an object (unit: mA)
+  double release_current;   // below it a held object is gone (unit: mA)
+  double stall_velocity;    // fingers slower than this are stopped (unit: m/s)
+  double goal_tolerance;    // closer to the goal than this is closed on nothing (unit: m)
+  double slip_distance;     // closing further than this while holding is a slip (unit: m)
+  double settle_time;       // how long a condition holds before it counts (unit: s)
+} GraspOption;
+
+/*****************************************************************************
+** Grasp Detector
+*****************************************************************************/
+// Gripper in current_based_position_mode: closing on an object stalls the
+// fingers short of the goal with the current at the limit. Fed once per
+// control cycle with the values the loop already has, so it costs no bus traffic.
+class GraspDetector
+{
+ public:
+  GraspDetector();
+  virtual ~GraspDetector(){}
+
+  void set_option(const GraspOption &option);
+  GraspOption get_option() const;
+
+  // Gripper goal, present position (unit: m), velocity (unit: m/s) and current (unit: mA).
+  // Returns the GRASP_EVENT_* of this cycle
+  uint8_t update(double time, double goal_position, double present_position, double present_velocity, double present_current);
+  uint8_t get_state() const;
+
+  static const char *get_state_name(uint8_t state);
+  static const char *get_event_name(uint8_t event);
+
+ private:
+  GraspOption option_;
+  uint8_t state_;
+  bool has_goal_;
+  double goal_position_;
+  double closing_direction_;
+  double grasp_position_;
+  double empty_start_time_;
+  double stall_start_time_;   // also the release timer while holding
+
+  bool is_settled(bool condition, double time, double *start_time);
+};
+}  // namespace GRASP
+#endif // GRASP_DETECTOR_HPP
@@ -25,6 +25,15 @@
   #include <robotis_manipulator/robotis_manipulator.h>
 #endif
 
+#include "reachability_map.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+
 //#define KINEMATICS_DEBUG
 
 using namespace Eigen;
@@ -32,6 +41,54 @@ using namespace robotis_manipulator;
 
 namespace kinematics
 {
+/*****************************************************************************
+** Fixed-Size Kinematics Kernel for OpenManipulator Chain
+*****************************************************************************/
+// Caches the world - joint1 - joint2 - joint3 - joint4 - tool topology once and
+// solves FK and the 6x4 jacobian in one flat loop without heap allocation.
+class OMChainKernel
+{
+ public:
+  OMChainKernel();
+  virtual ~OMChainKernel(){}
+
+  bool load(Manipulator *manipulator);
+  bool is_loaded() const;
+
+  Name get_joint_name(int8_t index) const;
+  Name get_tool_name() const;
+  const Vector3d &get_relative_position(int8_t index) const;   // index 0~3 : joint, 4 : tool
+
+  void read_joint_position(Manipulator *manipulator, Matrix<double, 4, 1> *joint_position) const;
+  void forward(const Matrix<double, 4, 1> &joint_position);
+  void write_back(Manipulator *manipulator) const;
+
+  const Vector3d &get_tool_position() const;
+  const Matrix3d &get_tool_orientation() const;
+  Matrix4d get_tool_transform() const;
+  // Frame of the link moved by joint index (0~3), 4 : tool, -1 : world
+  const Vector3d &get_frame_position(int8_t index) const;
+  const Matrix3d &get_frame_orientation(int8_t index) const;
+  const Matrix<double, 6, 4> &get_jacobian() const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  bool loaded_;
+  Name joint_name_[4];
+  Name tool_name_;
+
+  Vector3d world_position_;
+  Matrix3d world_orientation_;
+  Vector3d relative_position_[5];
+  Matrix3d relative_orientation_[5];
+  Vector3d axis_[4];
+
+  Vector3d position_[5];
+  Matrix3d orientation_[5];
+  Matrix<double, 6, 4> jacobian_;
+};
+
 /*****************************************************************************
 ** Kinematics Solver Using Chain Rule and Jacobian
 *****************************************************************************/
@@ -89,13 +146,82 @@ class SolverUsingCRAndSRPositionOnlyJacobian : public robotis_manipulator::Kinem
   bool inverse_solver_using_position_only_sr_jacobian(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue>* goal_joint_value);
 };
 
+/*****************************************************************************
+** Kinematics Solver Using Multi-Start Singularity Robust Jacobian
+*****************************************************************************/
+// Passed to SolverMultiStartOMChain::setOption
+typedef struct
+{
+  uint8_t num_seeds;      // present configuration + seeds spread inside the joint limits
+  double deadline;        // give up after this long (unit: s, 0 : no deadline)
+  bool prefer_closest;    // wait for every seed and keep the solution closest to the present configuration
+} MultiStartOption;
+
+// Runs the singularity robust jacobian from several seeds on a small pool of
+// worker threads, each with its own copy of the chain kernel. Without
+// prefer_closest it returns as soon as one seed converges. The workers take
+// the scheduling policy and priority of the thread that calls the solver.
+class SolverMultiStartOMChain : public robotis_manipulator::Kinematics
+{
+ public:
+  SolverMultiStartOMChain(bool position_only = false, uint8_t num_threads = 4);
+  virtual ~SolverMultiStartOMChain();
+
+  virtual void setOption(const void *arg);
+  virtual MatrixXd jacobian(Manipulator *manipulator, Name tool_name);
+  virtual void solveForwardKinematics(Manipulator *manipulator);
+  virtual bool solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue>* goal_joint_value);
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  bool position_only_;
+  MultiStartOption option_;
+  OMChainKernel chain_;
+  SolverUsingCRAndSRJacobian sr_solver_;
+  SolverUsingCRAndSRPositionOnlyJacobian position_only_sr_solver_;
+
+  // Job shared with the workers (written by the caller while they are idle)
+  std::vector<OMChainKernel, Eigen::aligned_allocator<OMChainKernel>> worker_chain_;
+  std::vector<Matrix<double, 4, 1>, Eigen::aligned_allocator<Matrix<double, 4, 1>>> seed_;
+  Matrix<double, 4, 1> present_angle_;
+  Matrix<double, 4, 1> min_limit_;
+  Matrix<double, 4, 1> max_limit_;
+  Pose target_pose_;
+  std::chrono::steady_clock::time_point deadline_;
+
+  std::atomic<uint32_t> next_seed_;
+  std::atomic<bool> stop_;
+
+  // Best solution so far, guarded by mutex_
+  bool solved_;
+  double solved_distance_;
+  Matrix<double, 4, 1> solved_angle_;
+
+  std::vector<std::thread> worker_;
+  std::mutex mutex_;
+  std::condition_variable job_condition_;
+  std::condition_variable idle_condition_;
+  uint32_t job_id_;
+  uint8_t busy_workers_;
+  bool shutdown_;
+  int worker_policy_;
+  int worker_priority_;
+
+  void worker_loop(uint8_t worker_index);
+  void match_caller_scheduling();
+  void run_seeds(OMChainKernel *chain);
+  bool solve_from_seed(OMChainKernel *chain, Matrix<double, 4, 1> *angle);
+  bool is_in_joint_limit(const Matrix<double, 4, 1> &angle) const;
+};
+
 /*****************************************************************************
 ** Kinematics Solver Customized for OpenManipulator Chain
 *****************************************************************************/
 class SolverCustomizedforOMChain : public robotis_manipulator::Kinematics
 {
  public:
-  SolverCustomizedforOMChain(){}
+  SolverCustomizedforOMChain() : reachability_map_(nullptr) {}
   virtual ~SolverCustomizedforOMChain(){}
 
   virtual void setOption(const void *arg);
@@ -103,9 +229,47 @@ class SolverCustomizedforOMChain : public robotis_manipulator::Kinematics
   virtual void solveForwardKinematics(Manipulator *manipulator);
   virtual bool solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue>* goal_joint_value);
 
+  // Reject targets outside the map without iterating, and seed far targets from the map (nullptr : off)
+  void set_reachability_map(const reachability::ReachabilityMap *reachability_map);
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
  private:
+  OMChainKernel chain_;
+  const reachability::ReachabilityMap *reachability_map_;
+
   void forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name);
   bool chain_custom_inverse_kinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue>* goal_joint_value);
+  bool chain_custom_inverse_kinematics_using_kernel(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue>* goal_joint_value);
+};
+
+/*****************************************************************************
+** Kinematics Solver Using Closed-Form Geometry for OpenManipulator Chain
+*****************************************************************************/
+// Solves the position and the pitch of the tool. With a yaw joint and three pitch joints the
+// yaw follows from the position and the roll is always zero, so the roll and yaw of the target
+// orientation are not reached (solveInverseKinematics warns when they differ)
+class SolverAnalyticOMChain : public robotis_manipulator::Kinematics
+{
+ public:
+  SolverAnalyticOMChain(){}
+  virtual ~SolverAnalyticOMChain(){}
+
+  virtual void setOption(const void *arg);
+  virtual MatrixXd jacobian(Manipulator *manipulator, Name tool_name);
+  virtual void solveForwardKinematics(Manipulator *manipulator);
+  virtual bool solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue>* goal_joint_value);
+
+  // Every base (front/over-the-shoulder) and elbow (up/down) branch that reaches target_pose within the joint limits
+  bool solve_all_inverse_kinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<std::vector<JointValue>>* solutions);
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  OMChainKernel chain_;
+
+  void forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name);
+  bool chain_analytic_inverse_kinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue>* goal_joint_value);
 };
 }  // namespace KINEMATICS
 #endif // KINEMATICS_HPP
@@ -0,0 +1,67 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef LOOP_TIMING_HPP
+#define LOOP_TIMING_HPP
+
+#include <cstdint>
+
+namespace loop_timing
+{
+#define NUM_OF_HISTOGRAM_BIN 80   // 4 bins per octave from 1 us
+
+// Durations of one stage since the last reset (unit: s)
+typedef struct
+{
+  uint32_t count;
+  uint32_t overrun;
+  double min;
+  double avg;
+  double p99;
+  double max;
+} Statistics;
+
+/*****************************************************************************
+** Stage Timer
+*****************************************************************************/
+// Accumulates durations into a fixed log-spaced histogram, so adding a sample
+// is O(1) and never allocates. p99 is the upper edge of the 99 % bin.
+class StageTimer
+{
+ public:
+  StageTimer();
+  virtual ~StageTimer(){}
+
+  void set_budget(double budget);   // longer samples count as an overrun (unit: s, 0 : off)
+  void add(double duration);
+  Statistics get_statistics() const;
+  void reset();
+
+  static double get_bin_upper_edge(uint8_t bin);
+
+ private:
+  double budget_;
+  uint32_t count_;
+  uint32_t overrun_;
+  double min_;
+  double max_;
+  double sum_;
+  uint32_t histogram_[NUM_OF_HISTOGRAM_BIN];
+};
+}  // namespace LOOP_TIMING
+#endif // LOOP_TIMING_HPP
@@ -19,9 +19,15 @@
 #ifndef OPEN_MANIPULTOR_X_HPP
 #define OPEN_MANIPULTOR_X_HPP
 
+#include "collision_checker.hpp"
 #include "dynamixel.hpp"
 #include "custom_trajectory.hpp"
 #include "kinematics.hpp"
+#include "loop_timing.hpp"
+#include "reachability_map.hpp"
+#include "simulated_dynamixel.hpp"
+
+#include <mutex>
 
 #define CUSTOM_TRAJECTORY_SIZE 4
 #define CUSTOM_TRAJECTORY_LINE    "custom_trajectory_line"
@@ -29,6 +35,31 @@
 #define CUSTOM_TRAJECTORY_RHOMBUS "custom_trajectory_rhombus"
 #define CUSTOM_TRAJECTORY_HEART   "custom_trajectory_heart"
 
+#define CUSTOM_JOINT_TRAJECTORY_SIZE 2
+#define CUSTOM_TRAJECTORY_SAMPLED_JOINT "custom_trajectory_sampled_joint"
+#define CUSTOM_TRAJECTORY_BLENDED_JOINT "custom_trajectory_blended_joint"
+
+#define KINEMATICS_SOLVER_JACOBIAN               "jacobian"
+#define KINEMATICS_SOLVER_SR_JACOBIAN            "sr_jacobian"
+#define KINEMATICS_SOLVER_POSITION_ONLY_JACOBIAN "position_only_sr_jacobian"
+#define KINEMATICS_SOLVER_OM_CHAIN_CUSTOM        "om_chain_custom"
+#define KINEMATICS_SOLVER_OM_CHAIN_ANALYTIC      "om_chain_analytic"
+#define KINEMATICS_SOLVER_MULTI_START_SR_JACOBIAN               "multi_start_sr_jacobian"
+#define KINEMATICS_SOLVER_MULTI_START_POSITION_ONLY_SR_JACOBIAN "multi_start_position_only_sr_jacobian"
+
+#define LOOP_STAGE_SIZE     5
+#define LOOP_STAGE_PLANNING 0
+#define LOOP_STAGE_READ     1
+#define LOOP_STAGE_WRITE    2
+#define LOOP_STAGE_FK       3
+#define LOOP_STAGE_TOTAL    4
+
+#define COLLISION_HOLD_TIME 0.2   // unit: s, to stop at the last safe setpoint when braking would collide
+
+#define COLLISION_RESPONSE_NONE  0
+#define COLLISION_RESPONSE_BRAKE 1
+#define COLLISION_RESPONSE_HOLD  2
+
 #define JOINT_DYNAMIXEL "joint_dxl"
 #define TOOL_DYNAMIXEL  "tool_dxl"
 
@@ -42,18 +73,188 @@ class OpenManipulatorX : public robotis_manipulator::RobotisManipulator
   OpenManipulatorX();
   virtual ~OpenManipulatorX();
 
-  void init_open_manipulator_x(
+  // False when the Dynamixel port could not be opened or the actuators don't answer on it
+  bool init_open_manipulator_x(
     bool sim, 
     STRING usb_port = "/dev/ttyUSB0", 
     STRING baud_rate = "1000000", 
     float control_loop_time = 0.010,
-    std::vector<uint8_t> dxl_id = {11, 12, 13, 14, 15});
+    std::vector<uint8_t> dxl_id = {11, 12, 13, 14, 15},
+    STRING kinematics_solver = KINEMATICS_SOLVER_OM_CHAIN_ANALYTIC,
+    STRING dxl_transfer_mode = DXL_TRANSFER_MODE_SYNC,
+    dynamixel::DynamixelBus *shared_bus = nullptr);
+  // With a shared bus the owner calls read_all before and write_all after processing every arm on it
   void process_open_manipulator_x(double present_time);
+  // Call before init_open_manipulator_x with sim : the joints and the gripper become simulated
+  // Dynamixels running on clock (the same time as present_time) instead of following the goal
+  void use_simulated_actuator(simulation::VirtualClock *clock, double read_latency = 0.0015, double write_latency = 0.0005);
+  // Call before init_open_manipulator_x : the control tables are read in one transaction and only
+  // the registers that differ are written, without torque cycling when the mode is already set
+  void enable_warm_start(bool enable);
+  // Call before init_open_manipulator_x : actuators that don't answer at baud_rate are looked
+  // for at the other known rates and their Baud_Rate (EEPROM) is rewritten. Ports of their own only
+  void enable_baud_rate_rewrite(bool enable);
+  // Round trip of the last Dynamixel read and write transaction (unit: s, false in simulation)
+  bool get_bus_round_trip_time(double *read_time, double *write_time);
+  // The write of each cycle and the read for the next one run on an I/O thread during
+  // forward kinematics and the next planning. The present values are one cycle old and
+  // extrapolated with the present velocity (false without a bus of its own)
+  bool enable_bus_pipeline(bool enable);
+  // Call before using the actuators outside of process_open_manipulator_x while pipelined
+  void wait_bus_transfer();
+  // Bounded retry of failed bus transfers, 1 retry within 30 % of the control loop time by default
+  bool set_bus_retry_policy(uint8_t max_retry, double budget);
+  // Per actuator and per bus error counts (false in simulation)
+  bool get_actuator_error_counter(uint8_t actuator_id, dynamixel::ActuatorErrorCounter *counter) const;
+  bool get_bus_error_counter(dynamixel::BusErrorCounter *counter, const char **last_error = nullptr) const;
+
+  /*****************************************************************************
+  ** Loop Timing Functions
+  *****************************************************************************/
+  // Time each stage of process_open_manipulator_x (LOOP_STAGE_*) with a monotonic clock. On a shared
+  // bus the owner reads and writes it, so LOOP_STAGE_READ and LOOP_STAGE_WRITE stay empty
+  void enable_loop_timing(bool enable);
+  loop_timing::Statistics get_loop_timing(uint8_t stage) const;
+  void reset_loop_timing();
+  // Duration of each stage in the last process_open_manipulator_x (unit: s, 0 while timing is off)
+  double get_last_loop_time(uint8_t stage) const;
+  // Setpoints sent in the last process_open_manipulator_x (empty before the first one)
+  const JointWaypoint &get_last_goal_joint_value() const;
+  const JointWaypoint &get_last_goal_tool_value() const;
+
+  /*****************************************************************************
+  ** Multi-Start IK Functions
+  *****************************************************************************/
+  // Only for the multi_start_* solvers (false otherwise). The deadline defaults to half the control loop time
+  bool set_multi_start_ik_option(uint8_t num_seeds, double deadline, bool prefer_closest);
+
+  /*****************************************************************************
+  ** Precomputed Trajectory Functions
+  *****************************************************************************/
+  // Solves IK for every pose in order, seeding each solution with the previous one
+  bool solve_inverse_kinematics_batch(Name tool_name, const std::vector<Pose> &target_pose, std::vector<JointValue> seed, std::vector<JointWaypoint> *goal_joint_value);
+  // Sample the path at the control period and solve it to joint waypoints (false if unreachable), off
+  // the control loop. The plan runs on a copy of the model from present_joint_value (the state
+  // snapshot of the caller) with planning state of its own, so it never touches what the loop uses.
+  // make_sampled_joint_trajectory then swaps the samples in on the loop (the previous ones come back)
+  bool plan_precomputed_task_trajectory(Name tool_name, KinematicPose goal_pose, double move_time, const JointWaypoint &present_joint_value,
+                                        custom_trajectory::JointSamples *samples, double *sample_move_time);
+  bool plan_precomputed_custom_trajectory(Name trajectory_name, Name tool_name, const void *arg, double move_time, const JointWaypoint &present_joint_value,
+                                          custom_trajectory::JointSamples *samples, double *sample_move_time);
+  void make_sampled_joint_trajectory(custom_trajectory::JointSamples *samples, double move_time);
+
+  /*****************************************************************************
+  ** Time-Optimal Trajectory Functions
+  *****************************************************************************/
+  // Per joint limits (unit: rad/s, rad/s^2, rad/s^3), joint_limits.yaml of the MoveIt config by default.
+  // Without max_jerk the jerk is limited to 10 times max_acceleration
+  void set_joint_limit(std::vector<double> max_velocity, std::vector<double> max_acceleration, std::vector<double> max_jerk = {});
+  // Precomputed task and drawing trajectories take the fastest feasible timing instead of move_time
+  void enable_time_optimal_trajectory(bool enable);
+  bool is_time_optimal_trajectory_enabled() const;
+  // Joint space path from the present goal as fast as the joint limits allow. At rest it is the
+  // straight line, while moving it bends from the present velocity and acceleration like the blend
+  bool make_time_optimal_joint_trajectory(std::vector<double> goal_joint_position, double *move_time = nullptr);
+
+  /*****************************************************************************
+  ** Blended Trajectory Functions
+  *****************************************************************************/
+  // Replace the tail of the active trajectory from its present goal (position, velocity and
+  // acceleration continuous), taking longer than move_time only if the joint limits need it
+  bool make_blended_joint_trajectory(std::vector<double> goal_joint_position, double move_time);
+  // Goal waypoint of the active trajectory, or the measured joints (at rest) before the first one
+  JointWaypoint get_present_joint_waypoint();
+  bool make_blended_task_trajectory(Name tool_name, KinematicPose goal_pose, double move_time);
+  // IK of make_blended_task_trajectory off the control loop, like plan_precomputed_task_trajectory.
+  // The goal then goes to make_blended_joint_trajectory on the loop
+  bool plan_blended_task_trajectory(Name tool_name, KinematicPose goal_pose, const JointWaypoint &present_joint_value, std::vector<double> *goal_joint_position);
+
+  /*****************************************************************************
+  ** Reachability Map Functions
+  *****************************************************************************/
+  // Map a file of generate_reachability_map and hand it to the solvers that use it
+  bool load_reachability_map(STRING file_path);
+  const reachability::ReachabilityMap &get_reachability_map() const;
+  // Answered from the map without solving IK (true without a map). The pitch is only checked
+  // when the solver also solves the orientation
+  bool is_reachable(KinematicPose target_pose, double pitch_tolerance = 0.1);
+
+  /*****************************************************************************
+  ** Collision Check Functions
+  *****************************************************************************/
+  // Every setpoint of the control loop is checked before it is sent. A colliding one is
+  // dropped and the goal brakes from the last safe setpoint within the joint acceleration
+  // limits, or stops there when the braking distance would collide. Before the first safe
+  // setpoint the measured joints are held instead
+  void enable_collision_check(bool enable);
+  bool is_collision_check_enabled() const;
+  // Padding, ground and obstacle boxes
+  collision::CollisionChecker *get_collision_checker();
+  // joint1-4 (unit: rad) and gripper (unit: m)
+  bool is_colliding(std::vector<double> joint_position, double gripper_position);
+  // Setpoints dropped since init and the pair of the last one (COLLISION_LINK*, COLLISION_ENVIRONMENT)
+  uint32_t get_collision_count() const;
+  void get_last_collision(uint8_t *link, uint8_t *other) const;
 
  private:
   robotis_manipulator::Kinematics *kinematics_;
-  robotis_manipulator::JointActuator *actuator_;
+  robotis_manipulator::Kinematics *batch_kinematics_;
+  bool position_only_kinematics_;
+  dynamixel::JointDynamixelProfileControl *actuator_;
+  simulation::SimulatedJointDynamixel *simulated_actuator_;
   robotis_manipulator::ToolActuator *tool_;
+  dynamixel::DynamixelBus *dxl_bus_;
+  bool owns_dxl_bus_;
+  bool warm_start_;
+  bool baud_rate_rewrite_;
   robotis_manipulator::CustomTaskTrajectory *custom_trajectory_[CUSTOM_TRAJECTORY_SIZE];
+  robotis_manipulator::CustomJointTrajectory *custom_joint_trajectory_[CUSTOM_JOINT_TRAJECTORY_SIZE];
+
+  double control_loop_time_;
+  double previous_present_time_;
+
+  simulation::VirtualClock *simulation_clock_;
+  double simulation_read_latency_;
+  double simulation_write_latency_;
+
+  bool loop_timing_enabled_;
+  loop_timing::StageTimer stage_timer_[LOOP_STAGE_SIZE];
+  double last_stage_time_[LOOP_STAGE_SIZE];
+  JointWaypoint last_goal_joint_value_;
+  JointWaypoint last_goal_tool_value_;
+
+  // Copy of the model taken at init, for the planning outside the control loop
+  Manipulator planning_manipulator_;
+
+  // Last precomputed joint path, reused when the same path is requested again from the same state.
+  // planning_mutex_ serializes the plan_* functions over it and the batch solver
+  std::mutex planning_mutex_;
+  Name cached_tool_name_;
+  std::vector<Pose> cached_target_pose_;
+  JointWaypoint cached_seed_;
+  custom_trajectory::JointSamples cached_samples_;
+  double cached_move_time_;
+
+  bool time_optimal_enabled_;
+  custom_trajectory::TimeOptimalParameterization time_optimal_;
+  custom_trajectory::JointLimit joint_limit_;
+
+  reachability::ReachabilityMap reachability_map_;
+
+  bool collision_check_enabled_;
+  collision::CollisionChecker collision_checker_;
+  JointWaypoint last_safe_joint_value_;
+  double last_gripper_position_;
+  uint32_t collision_count_;
+  uint8_t last_collision_[2];
+  uint8_t collision_response_;           // COLLISION_RESPONSE_* of the present collision event
+  double collision_response_end_time_;   // until then a colliding setpoint belongs to that event
+
+  // num_threads : threads of the multi_start_* solvers, the calling one included
+  robotis_manipulator::Kinematics *create_kinematics_solver(STRING kinematics_solver, uint8_t num_threads = 4);
+  bool plan_sampled_joint_trajectory(Name tool_name, const std::vector<Pose> &target_pose, double move_time, const JointWaypoint &seed,
+                                     custom_trajectory::JointSamples *samples, double *sample_move_time);
+  bool is_cached_path(Name tool_name, const std::vector<Pose> &target_pose, const JointWaypoint &seed);
+  bool hold_if_colliding(double present_time, JointWaypoint *goal_joint_value, const JointWaypoint &goal_tool_value);
 };
 #endif // OPEN_MANIPULTOR_X_HPP
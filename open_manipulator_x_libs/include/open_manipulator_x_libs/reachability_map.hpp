@@ -0,0 +1,96 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef REACHABILITY_MAP_HPP
+#define REACHABILITY_MAP_HPP
+
+#if defined(__OPENCR__)
+  #include <RobotisManipulator.h>
+#else
+  #include <robotis_manipulator/robotis_manipulator.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace reachability
+{
+#define REACHABILITY_MAP_MAGIC   0x52584D4F   // "OMXR"
+#define REACHABILITY_MAP_VERSION 1
+
+#define VOXEL_REACHABLE 0x01   // a sampled tool position falls in the voxel
+#define VOXEL_NEAR      0x02   // next to a reachable voxel (kept so boundary targets are never rejected)
+
+// Fixed-size records, so a map file is used in place through mmap
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size[3];       // number of voxels along x, y, z
+  float origin[3];        // corner of voxel (0, 0, 0) in the world frame (unit: m)
+  float resolution;       // edge of a voxel (unit: m)
+} MapHeader;
+
+typedef struct
+{
+  uint8_t flag;
+  uint8_t reserved[3];
+  float min_pitch;        // range of the tool pitch reached in the voxel (unit: rad)
+  float max_pitch;
+  float seed[4];          // joint1-4 of the sample closest to the voxel center (unit: rad)
+} Voxel;
+
+/*****************************************************************************
+** Reachability Map
+*****************************************************************************/
+// Voxel grid over the workspace of the OpenManipulator chain. Lookups are O(1)
+// and never touch the kinematics.
+class ReachabilityMap
+{
+ public:
+  ReachabilityMap();
+  virtual ~ReachabilityMap();
+
+  // Sweep joint2-4 in angle_step over their limits and fold the result around joint1
+  bool generate(robotis_manipulator::Manipulator *manipulator, double resolution = 0.02, double angle_step = 0.02);
+  bool save(STRING file_path) const;
+  // Map the file read-only; it stays shared between every process that loads it
+  bool load(STRING file_path);
+  void unload();
+  bool is_loaded() const;
+
+  const MapHeader &get_header() const;
+  // nullptr outside the grid
+  const Voxel *find(const Eigen::Vector3d &position) const;
+  bool is_reachable(const Eigen::Vector3d &position) const;
+  // Position and tool pitch (pitch of the RPY orientation) within pitch_tolerance of the sampled range
+  bool is_reachable(const Eigen::Vector3d &position, double pitch, double pitch_tolerance = 0.1) const;
+
+ private:
+  MapHeader header_;
+  const Voxel *voxel_;
+  std::vector<Voxel> generated_voxel_;
+
+  void *mapped_;
+  size_t mapped_size_;
+
+  bool get_index(const Eigen::Vector3d &position, size_t *index) const;
+};
+}  // namespace reachability
+#endif // REACHABILITY_MAP_HPP
@@ -0,0 +1,199 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef SIMULATED_DYNAMIXEL_HPP
+#define SIMULATED_DYNAMIXEL_HPP
+
+#if defined(__OPENCR__)
+  #include <RobotisManipulator.h>
+#else
+  #include <robotis_manipulator/robotis_manipulator.h>
+#endif
+
+#include <deque>
+
+namespace simulation
+{
+#define SIMULATION_STEP_TIME 0.0005   // unit: s
+
+// Dynamixel X series profile units
+#define PROFILE_VELOCITY_UNIT     0.0239808   // 0.229 rev/min in rad/s
+#define PROFILE_ACCELERATION_UNIT 0.3745135   // 214.577 rev/min^2 in rad/s^2
+
+/*****************************************************************************
+** Virtual Clock
+*****************************************************************************/
+// Time of the simulated actuators, advanced by whoever drives the control loop
+class VirtualClock
+{
+ public:
+  VirtualClock(double start_time = 0.0) : time_(start_time) {}
+  virtual ~VirtualClock(){}
+
+  double now() const { return time_; }
+  void set_time(double time) { time_ = time; }
+  void advance(double duration) { time_ += duration; }
+
+ private:
+  double time_;
+};
+
+/*****************************************************************************
+** Profile Axis
+*****************************************************************************/
+// Motion of one Dynamixel in position mode: the profile generator of the
+// firmware (time-based or velocity-based Profile_Velocity/Profile_Acceleration,
+// 0 : unlimited) followed by a first order lag of the position loop.
+class ProfileAxis
+{
+ public:
+  ProfileAxis();
+  virtual ~ProfileAxis(){}
+
+  void set_time_based_profile(bool time_based);
+  void set_profile_velocity(uint32_t profile_velocity);
+  void set_profile_acceleration(uint32_t profile_acceleration);
+  void set_time_constant(double time_constant);   // unit: s
+  void set_present_position(double position);
+
+  void set_goal_position(double goal_position);
+  void step(double step_time);
+
+  double get_position() const;
+  double get_velocity() const;
+  double get_acceleration() const;
+
+ private:
+  bool time_based_;
+  uint32_t profile_velocity_;
+  uint32_t profile_acceleration_;
+  double time_constant_;
+
+  double goal_position_;
+  double max_velocity_;
+  double max_acceleration_;
+
+  double profile_position_;
+  double profile_velocity_value_;
+
+  double position_;
+  double velocity_;
+  double acceleration_;
+
+  void update_limit();
+};
+
+/*****************************************************************************
+** Simulated Bus
+*****************************************************************************/
+// Axes on one port. A write takes effect write_latency after it is sent and a
+// read returns the state of read_latency ago, both on the virtual clock.
+class SimulatedBus
+{
+ public:
+  SimulatedBus(VirtualClock *clock, double read_latency, double write_latency);
+  virtual ~SimulatedBus(){}
+
+  void resize(uint8_t num_of_axis);
+  ProfileAxis *get_axis(uint8_t index);
+
+  void write(const std::vector<double> &goal_position);
+  std::vector<robotis_manipulator::ActuatorValue> read();
+
+ private:
+  typedef struct
+  {
+    double time;
+    std::vector<double> goal_position;
+  } PendingWrite;
+
+  typedef struct
+  {
+    double time;
+    std::vector<robotis_manipulator::ActuatorValue> value;
+  } Sample;
+
+  VirtualClock *clock_;
+  double read_latency_;
+  double write_latency_;
+
+  std::vector<ProfileAxis> axis_;
+  std::deque<PendingWrite> pending_write_;
+  std::deque<Sample> sample_;
+  double simulated_time_;
+  bool started_;
+
+  void run_until(double time);
+  Sample get_sample() const;
+};
+
+class SimulatedJointDynamixel : public robotis_manipulator::JointActuator
+{
+ public:
+  SimulatedJointDynamixel(VirtualClock *clock, float control_loop_time = 0.010, double read_latency = 0.0015, double write_latency = 0.0005, double time_constant = 0.004);
+  virtual ~SimulatedJointDynamixel(){}
+
+  // Same velocity feed-forward as JointDynamixelProfileControl (unit: s)
+  void set_present_loop_time(float present_loop_time);
+
+  /*****************************************************************************
+  ** Simulated Joint Dynamixel Control Functions
+  *****************************************************************************/
+  virtual void init(std::vector<uint8_t> actuator_id, const void *arg);
+  virtual void setMode(std::vector<uint8_t> actuator_id, const void *arg);
+  virtual std::vector<uint8_t> getId();
+
+  virtual void enable();
+  virtual void disable();
+
+  virtual bool sendJointActuatorValue(std::vector<uint8_t> actuator_id, std::vector<robotis_manipulator::ActuatorValue> value_vector);
+  virtual std::vector<robotis_manipulator::ActuatorValue> receiveJointActuatorValue(std::vector<uint8_t> actuator_id);
+
+ private:
+  SimulatedBus bus_;
+  std::vector<uint8_t> id_;
+  double time_constant_;
+  float control_loop_time_;  // unit: s
+  float present_loop_time_;
+};
+
+class SimulatedGripperDynamixel : public robotis_manipulator::ToolActuator
+{
+ public:
+  SimulatedGripperDynamixel(VirtualClock *clock, double read_latency = 0.0015, double write_latency = 0.0005, double time_constant = 0.004);
+  virtual ~SimulatedGripperDynamixel(){}
+
+  /*****************************************************************************
+  ** Simulated Tool Dynamixel Control Functions
+  *****************************************************************************/
+  virtual void init(uint8_t actuator_id, const void *arg);
+  virtual void setMode(const void *arg);
+  virtual uint8_t getId();
+
+  virtual void enable();
+  virtual void disable();
+
+  virtual bool sendToolActuatorValue(robotis_manipulator::ActuatorValue value);
+  virtual robotis_manipulator::ActuatorValue receiveToolActuatorValue();
+
+ private:
+  SimulatedBus bus_;
+  uint8_t id_;
+};
+}  // namespace simulation
+#endif // SIMULATED_DYNAMIXEL_HPP
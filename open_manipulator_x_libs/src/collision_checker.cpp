@@ -0,0 +1,229 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "../include/open_manipulator_x_libs/collision_checker.hpp"
+
+#include <cmath>
+
+using namespace collision;
+
+/*****************************************************************************
+** Collision Checker
+*****************************************************************************/
+CollisionChecker::CollisionChecker()
+: padding_(0.0),
+  ground_height_(-INFINITY)
+{
+  // Fitted to meshes/chain_link*.stl, in the link frames of open_manipulator_x.urdf.xacro
+  capsule_[COLLISION_LINK1]            = {Eigen::Vector3d(-0.0132,  0.0,    0.0202), Eigen::Vector3d(0.0132, 0.0,    0.0202), 0.0257};
+  capsule_[COLLISION_LINK2]            = {Eigen::Vector3d( 0.0,     0.0022, 0.0340), Eigen::Vector3d(0.0,    0.0022, 0.0678), 0.0285};
+  capsule_[COLLISION_LINK3]            = {Eigen::Vector3d( 0.0137,  0.0,    0.0050), Eigen::Vector3d(0.0137, 0.0,    0.1265), 0.0415};
+  capsule_[COLLISION_LINK4]            = {Eigen::Vector3d( 0.0,     0.0,    0.0),    Eigen::Vector3d(0.1273, 0.0,    0.0),    0.0313};
+  capsule_[COLLISION_LINK5]            = {Eigen::Vector3d( 0.0242, -0.0493, 0.0084), Eigen::Vector3d(0.0242, 0.0493, 0.0084), 0.0522};
+  capsule_[COLLISION_GRIPPER_LINK]     = {Eigen::Vector3d(-0.0031,  0.0077, 0.0),    Eigen::Vector3d(0.0450, 0.0077, 0.0),    0.0341};
+  capsule_[COLLISION_GRIPPER_LINK_SUB] = {Eigen::Vector3d(-0.0031, -0.0077, 0.0),    Eigen::Vector3d(0.0450,-0.0077, 0.0),    0.0341};
+
+  for (uint8_t link = 0; link < NUM_OF_COLLISION_LINK; link++)
+    for (uint8_t other = 0; other < NUM_OF_COLLISION_LINK; other++)
+      check_pair_[link][other] = (link != other);
+
+  // disable_collisions of open_manipulator.srdf (end_effector_link has no volume)
+  disable_pair(COLLISION_GRIPPER_LINK, COLLISION_LINK1);
+  disable_pair(COLLISION_GRIPPER_LINK, COLLISION_LINK4);
+  disable_pair(COLLISION_GRIPPER_LINK, COLLISION_LINK5);
+  disable_pair(COLLISION_GRIPPER_LINK_SUB, COLLISION_LINK1);
+  disable_pair(COLLISION_GRIPPER_LINK_SUB, COLLISION_LINK4);
+  disable_pair(COLLISION_GRIPPER_LINK_SUB, COLLISION_LINK5);
+  disable_pair(COLLISION_LINK1, COLLISION_LINK2);
+  disable_pair(COLLISION_LINK1, COLLISION_LINK3);
+  disable_pair(COLLISION_LINK1, COLLISION_LINK4);
+  disable_pair(COLLISION_LINK1, COLLISION_LINK5);
+  disable_pair(COLLISION_LINK2, COLLISION_LINK3);
+  disable_pair(COLLISION_LINK3, COLLISION_LINK4);
+  disable_pair(COLLISION_LINK4, COLLISION_LINK5);
+  // The fingers mirror each other and never meet within the gripper limits
+  disable_pair(COLLISION_GRIPPER_LINK, COLLISION_GRIPPER_LINK_SUB);
+}
+
+bool CollisionChecker::load(Manipulator *manipulator)
+{
+  return chain_.load(manipulator);
+}
+
+bool CollisionChecker::is_loaded() const
+{
+  return chain_.is_loaded();
+}
+
+void CollisionChecker::set_padding(double padding)
+{
+  padding_ = padding;
+}
+
+void CollisionChecker::set_ground_height(double ground_height)
+{
+  ground_height_ = ground_height;
+}
+
+void CollisionChecker::add_box(const Eigen::Vector3d &min_corner, const Eigen::Vector3d &max_corner)
+{
+  box_.push_back({min_corner.cwiseMin(max_corner), min_corner.cwiseMax(max_corner)});
+}
+
+void CollisionChecker::clear_boxes()
+{
+  box_.clear();
+}
+
+bool CollisionChecker::is_colliding(const Eigen::Matrix<double, 4, 1> &joint_position, double gripper_position, uint8_t *link, uint8_t *other)
+{
+  if (!chain_.is_loaded()) return false;
+  chain_.forward(joint_position);
+
+  // link1 is the base, link2 ~ link5 follow joint1 ~ joint4, the fingers slide on link5
+  for (int8_t index = 0; index < 5; index++)
+  {
+    const Eigen::Vector3d &position = chain_.get_frame_position(index - 1);
+    const Eigen::Matrix3d &orientation = chain_.get_frame_orientation(index - 1);
+    a_[index] = position + orientation * capsule_[index].a;
+    b_[index] = position + orientation * capsule_[index].b;
+  }
+  const Eigen::Vector3d &position = chain_.get_frame_position(3);
+  const Eigen::Matrix3d &orientation = chain_.get_frame_orientation(3);
+  Eigen::Vector3d finger_offset[2] = {Eigen::Vector3d(0.0817,  0.021 + gripper_position, 0.0),
+                                      Eigen::Vector3d(0.0817, -0.021 - gripper_position, 0.0)};
+  for (uint8_t finger = 0; finger < 2; finger++)
+  {
+    uint8_t index = COLLISION_GRIPPER_LINK + finger;
+    a_[index] = position + orientation * (finger_offset[finger] + capsule_[index].a);
+    b_[index] = position + orientation * (finger_offset[finger] + capsule_[index].b);
+  }
+
+  for (uint8_t i = 0; i < NUM_OF_COLLISION_LINK; i++)
+  {
+    for (uint8_t j = i + 1; j < NUM_OF_COLLISION_LINK; j++)
+    {
+      if (!check_pair_[i][j]) continue;
+
+      double radius = capsule_[i].radius + capsule_[j].radius + 2.0 * padding_;
+      if (get_segment_distance(a_[i], b_[i], a_[j], b_[j]) < radius)
+      {
+        if (link != nullptr) *link = i;
+        if (other != nullptr) *other = j;
+        return true;
+      }
+    }
+    if (i > COLLISION_LINK1 && is_colliding_with_environment(i))
+    {
+      if (link != nullptr) *link = i;
+      if (other != nullptr) *other = COLLISION_ENVIRONMENT;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *CollisionChecker::get_link_name(uint8_t index)
+{
+  const char *link_name[NUM_OF_COLLISION_LINK + 1] =
+    {"link1", "link2", "link3", "link4", "link5", "gripper_link", "gripper_link_sub", "environment"};
+  return index <= NUM_OF_COLLISION_LINK ? link_name[index] : "";
+}
+
+//private
+void CollisionChecker::disable_pair(uint8_t link, uint8_t other)
+{
+  check_pair_[link][other] = false;
+  check_pair_[other][link] = false;
+}
+
+bool CollisionChecker::is_colliding_with_environment(uint8_t link) const
+{
+  double radius = capsule_[link].radius + padding_;
+
+  // link2 turns on top of the base, so only the links past it can reach the ground
+  if (link > COLLISION_LINK2 && std::min(a_[link](2), b_[link](2)) - radius < ground_height_) return true;
+
+  for (uint32_t index = 0; index < box_.size(); index++)
+    if (get_box_distance(a_[link], b_[link], box_.at(index)) < radius) return true;
+  return false;
+}
+
+double CollisionChecker::get_segment_distance(const Eigen::Vector3d &p1, const Eigen::Vector3d &q1, const Eigen::Vector3d &p2, const Eigen::Vector3d &q2)
+{
+  // Closest points of two segments (Ericson, Real-Time Collision Detection 5.1.9)
+  Eigen::Vector3d d1 = q1 - p1;
+  Eigen::Vector3d d2 = q2 - p2;
+  Eigen::Vector3d r = p1 - p2;
+  double a = d1.dot(d1);
+  double e = d2.dot(d2);
+  double f = d2.dot(r);
+  double s = 0.0, t = 0.0;
+
+  if (a < 1E-12 && e < 1E-12) return r.norm();
+  if (a < 1E-12)
+  {
+    t = std::min(std::max(f / e, 0.0), 1.0);
+  }
+  else
+  {
+    double c = d1.dot(r);
+    if (e < 1E-12)
+    {
+      s = std::min(std::max(-c / a, 0.0), 1.0);
+    }
+    else
+    {
+      double b = d1.dot(d2);
+      double denom = a * e - b * b;
+      s = (denom > 1E-12) ? std::min(std::max((b * f - c * e) / denom, 0.0), 1.0) : 0.0;
+      t = (b * s + f) / e;
+      if (t < 0.0)
+      {
+        t = 0.0;
+        s = std::min(std::max(-c / a, 0.0), 1.0);
+      }
+      else if (t > 1.0)
+      {
+        t = 1.0;
+        s = std::min(std::max((b - c) / a, 0.0), 1.0);
+      }
+    }
+  }
+  return ((p1 + d1 * s) - (p2 + d2 * t)).norm();
+}
+
+double CollisionChecker::get_box_distance(const Eigen::Vector3d &p, const Eigen::Vector3d &q, const Box &box)
+{
+  // The distance to a box is convex along the segment, so a ternary search finds the minimum
+  auto distance = [&p, &q, &box](double s) -> double
+  {
+    Eigen::Vector3d point = p + s * (q - p);
+    return (point - point.cwiseMax(box.min_corner).cwiseMin(box.max_corner)).norm();
+  };
+
+  double low = 0.0, high = 1.0;
+  for (uint8_t iteration = 0; iteration < 24; iteration++)
+  {
+    double left = low + (high - low) / 3.0;
+    double right = high - (high - low) / 3.0;
+    if (distance(left) < distance(right)) high = right;
+    else low = left;
+  }
+  return distance(0.5 * (low + high));
+}
@@ -18,9 +18,448 @@
 
 #include "../include/open_manipulator_x_libs/custom_trajectory.hpp"
 
+#include <utility>
+
 using namespace custom_trajectory;
 using namespace Eigen;
 
+/*****************************************************************************
+** Path Samples
+*****************************************************************************/
+void PathSamples::set_sample_period(double sample_period)
+{
+  sample_period_ = sample_period;
+  sample_.clear();
+}
+
+bool PathSamples::is_enabled() const
+{
+  return sample_period_ > 0.0;
+}
+
+uint32_t PathSamples::begin(double move_time)
+{
+  // A zero-length path has no samples and stays on the start pose
+  step_ = 0.0;
+  sample_.clear();
+  if (!(move_time > 0.0)) return 0;
+
+  // Stretch the period slightly so the last sample lands exactly on move_time
+  uint32_t sample_size = (uint32_t)ceil(move_time / sample_period_) + 1;
+  step_ = move_time / (sample_size - 1);
+
+  sample_.reserve(sample_size * 4);
+  return sample_size;
+}
+
+double PathSamples::get_tick(uint32_t index) const
+{
+  return index * step_;
+}
+
+void PathSamples::push_back(double x, double y)
+{
+  sample_.push_back(x);
+  sample_.push_back(y);
+  sample_.push_back(0.0);
+  sample_.push_back(0.0);
+}
+
+void PathSamples::finish()
+{
+  if (sample_.size() < 4) return;
+  uint32_t last = sample_.size() / 4 - 1;
+  for (uint32_t index = 1; index < last; index++)
+  {
+    sample_[index * 4 + 2] = (sample_[(index + 1) * 4 + 0] - sample_[(index - 1) * 4 + 0]) / (2.0 * step_);
+    sample_[index * 4 + 3] = (sample_[(index + 1) * 4 + 1] - sample_[(index - 1) * 4 + 1]) / (2.0 * step_);
+  }
+}
+
+void PathSamples::lookup(double tick, double *x, double *y, double *vx, double *vy) const
+{
+  if (sample_.size() < 4)
+  {
+    *x = *y = *vx = *vy = 0.0;
+    return;
+  }
+
+  uint32_t last = sample_.size() / 4 - 1;
+  double sample = (step_ > 0.0) ? tick / step_ : 0.0;
+  if (!(sample > 0.0)) sample = 0.0;
+
+  uint32_t index = last;
+  double ratio = 0.0;
+  if (sample < last)
+  {
+    index = (uint32_t)sample;
+    ratio = sample - index;
+  }
+
+  const double *from = &sample_[index * 4];
+  const double *to = (index < last) ? from + 4 : from;
+
+  *x  = from[0] + ratio * (to[0] - from[0]);
+  *y  = from[1] + ratio * (to[1] - from[1]);
+  *vx = from[2] + ratio * (to[2] - from[2]);
+  *vy = from[3] + ratio * (to[3] - from[3]);
+}
+
+TaskWaypoint PathSamples::get_waypoint(double tick, const TaskWaypoint &start) const
+{
+  TaskWaypoint pose;
+  double diff_pose[2];
+  double diff_velocity[2];
+
+  lookup(tick, &diff_pose[0], &diff_pose[1], &diff_velocity[0], &diff_velocity[1]);
+
+  pose.kinematic.position(X_AXIS) = start.kinematic.position(X_AXIS) + diff_pose[0];
+  pose.kinematic.position(Y_AXIS) = start.kinematic.position(Y_AXIS) + diff_pose[1];
+  pose.kinematic.position(Z_AXIS) = start.kinematic.position(Z_AXIS);
+
+  pose.kinematic.orientation = start.kinematic.orientation;
+
+  pose.dynamic.linear.velocity = Eigen::Vector3d(diff_velocity[0], diff_velocity[1], 0.0);
+  pose.dynamic.linear.acceleration = Eigen::Vector3d::Zero(3);
+  pose.dynamic.angular.velocity = Eigen::Vector3d::Zero(3);
+  pose.dynamic.angular.acceleration = Eigen::Vector3d::Zero(3);
+
+  return pose;
+}
+
+/*****************************************************************************
+** Sampled Joint Path
+*****************************************************************************/
+void SampledJointPath::makeJointTrajectory(double move_time, JointWaypoint start, const void *arg)
+{
+  // Swapped rather than copied, the control loop allocates nothing here
+  JointSamples *c_arg = (JointSamples *)arg;
+  std::swap(samples_, *c_arg);
+
+  if (samples_.waypoint.size() == 0) samples_.waypoint.push_back(start);
+}
+
+JointWaypoint SampledJointPath::getJointWaypoint(double tick)
+{
+  uint32_t last = samples_.waypoint.size() - 1;
+  if (tick <= 0.0 || last == 0) return samples_.waypoint.front();
+
+  double sample = tick / samples_.sample_period;
+  uint32_t index = (uint32_t)sample;
+  if (index >= last) return samples_.waypoint.back();
+
+  // Linear interpolation between neighbouring samples
+  double ratio = sample - index;
+  const JointWaypoint &from = samples_.waypoint.at(index);
+  const JointWaypoint &to = samples_.waypoint.at(index + 1);
+
+  JointWaypoint joint_waypoint(from.size());
+  for (uint8_t num = 0; num < from.size(); num++)
+  {
+    joint_waypoint.at(num).position     = from.at(num).position     + ratio * (to.at(num).position     - from.at(num).position);
+    joint_waypoint.at(num).velocity     = from.at(num).velocity     + ratio * (to.at(num).velocity     - from.at(num).velocity);
+    joint_waypoint.at(num).acceleration = from.at(num).acceleration + ratio * (to.at(num).acceleration - from.at(num).acceleration);
+    joint_waypoint.at(num).effort = 0.0;
+  }
+  return joint_waypoint;
+}
+
+void SampledJointPath::setOption(const void *arg) {}
+
+/*****************************************************************************
+** Time-Optimal Parameterization
+*****************************************************************************/
+#define TOPP_BISECTION_ITERATION 60
+#define TOPP_MAX_SQUARED_SPEED   1E12
+
+void TimeOptimalParameterization::set_joint_limit(std::vector<double> max_velocity, std::vector<double> max_acceleration)
+{
+  max_velocity_ = max_velocity;
+  max_acceleration_ = max_acceleration;
+}
+
+bool TimeOptimalParameterization::is_enabled() const
+{
+  return max_velocity_.size() > 0 && max_velocity_.size() == max_acceleration_.size();
+}
+
+bool TimeOptimalParameterization::parameterize(const std::vector<JointWaypoint> &path, double sample_period, JointSamples *samples, double *move_time, double start_speed)
+{
+  if (!is_enabled() || path.size() == 0 || path.front().size() > max_velocity_.size() || sample_period <= 0.0)
+  {
+    log::error("[TimeOptimalParameterization]joint limits do not match the path");
+    return false;
+  }
+
+  uint32_t size = path.size();
+  num_of_joint_ = path.front().size();
+
+  samples->sample_period = sample_period;
+  samples->waypoint.clear();
+  if (size < 3)
+  {
+    samples->waypoint.push_back(path.back());
+    *move_time = sample_period;
+    return true;
+  }
+
+  //////////////path derivatives//////////
+  first_derivative_.assign(size * num_of_joint_, 0.0);
+  second_derivative_.assign(size * num_of_joint_, 0.0);
+  for (uint32_t index = 0; index < size; index++)
+  {
+    uint32_t previous = index > 0 ? index - 1 : 0;
+    uint32_t next = index < size - 1 ? index + 1 : size - 1;
+    uint32_t center = std::min(std::max(index, (uint32_t)1), size - 2);
+    for (uint8_t num = 0; num < num_of_joint_; num++)
+    {
+      first_derivative_[index * num_of_joint_ + num] =
+        (path.at(next).at(num).position - path.at(previous).at(num).position) / (next - previous);
+      second_derivative_[index * num_of_joint_ + num] =
+        path.at(center + 1).at(num).position - 2.0 * path.at(center).at(num).position + path.at(center - 1).at(num).position;
+    }
+  }
+  ///////////////////////////////////////
+
+  //////////////backward pass/////////////
+  // Largest squared path speed at each point from which the end is still reached at rest
+  std::vector<double> controllable(size, 0.0);
+  for (int32_t index = size - 2; index >= 0; index--)
+  {
+    double next_speed = controllable[index + 1];
+    auto is_controllable = [this, index, next_speed](double x) -> bool
+    {
+      double lower, upper;
+      if (!get_acceleration_range(index, x, &lower, &upper)) return false;
+      lower = std::max(lower, -0.5 * x);                 // x + 2u >= 0
+      upper = std::min(upper, 0.5 * (next_speed - x));   // x + 2u <= next_speed
+      return lower <= upper;
+    };
+
+    double high = std::min(get_velocity_limit(index), TOPP_MAX_SQUARED_SPEED);
+    if (is_controllable(high))
+    {
+      controllable[index] = high;
+      continue;
+    }
+
+    double low = 0.0;
+    for (uint8_t iteration = 0; iteration < TOPP_BISECTION_ITERATION; iteration++)
+    {
+      double middle = 0.5 * (low + high);
+      if (is_controllable(middle)) low = middle;
+      else high = middle;
+    }
+    controllable[index] = low;
+  }
+  ///////////////////////////////////////
+
+  //////////////forward pass//////////////
+  // Accelerate as hard as the limits and the controllable speed allow
+  std::vector<double> squared_speed(size, 0.0);
+  std::vector<double> path_acceleration(size, 0.0);
+  squared_speed[0] = std::min(start_speed * start_speed, controllable[0]);
+  for (uint32_t index = 0; index < size - 1; index++)
+  {
+    double lower, upper;
+    get_acceleration_range(index, squared_speed[index], &lower, &upper);
+
+    double next = squared_speed[index] + 2.0 * upper;
+    next = std::min(std::max(next, 0.0), controllable[index + 1]);
+    path_acceleration[index] = 0.5 * (next - squared_speed[index]);
+    squared_speed[index + 1] = next;
+  }
+  ///////////////////////////////////////
+
+  //////////////resample in time//////////
+  std::vector<double> arrival_time(size, 0.0);
+  for (uint32_t index = 0; index < size - 1; index++)
+  {
+    double speed_sum = sqrt(squared_speed[index]) + sqrt(squared_speed[index + 1]);
+    if (speed_sum < 1E-9)
+    {
+      log::error("[TimeOptimalParameterization]path can not be followed within the joint limits");
+      return false;
+    }
+    arrival_time[index + 1] = arrival_time[index] + 2.0 / speed_sum;
+  }
+
+  uint32_t sample_size = (uint32_t)ceil(arrival_time.back() / sample_period) + 1;
+  samples->waypoint.resize(sample_size, JointWaypoint(num_of_joint_));
+
+  uint32_t segment = 0;
+  for (uint32_t sample = 0; sample < sample_size - 1; sample++)
+  {
+    double tick = sample * sample_period;
+    while (segment < size - 2 && arrival_time[segment + 1] <= tick) segment++;
+
+    double time = tick - arrival_time[segment];
+    double speed = sqrt(squared_speed[segment]) + path_acceleration[segment] * time;
+    double ratio = std::min(std::max(sqrt(squared_speed[segment]) * time + 0.5 * path_acceleration[segment] * time * time, 0.0), 1.0);
+
+    for (uint8_t num = 0; num < num_of_joint_; num++)
+    {
+      double from = path.at(segment).at(num).position;
+      double to = path.at(segment + 1).at(num).position;
+      double first = first_derivative_[segment * num_of_joint_ + num] * (1.0 - ratio) + first_derivative_[(segment + 1) * num_of_joint_ + num] * ratio;
+      double second = second_derivative_[segment * num_of_joint_ + num] * (1.0 - ratio) + second_derivative_[(segment + 1) * num_of_joint_ + num] * ratio;
+
+      JointValue &value = samples->waypoint.at(sample).at(num);
+      value.position = from + ratio * (to - from);
+      value.velocity = first * speed;
+      value.acceleration = first * path_acceleration[segment] + second * speed * speed;
+      value.effort = 0.0;
+    }
+  }
+
+  for (uint8_t num = 0; num < num_of_joint_; num++)
+  {
+    JointValue &value = samples->waypoint.back().at(num);
+    value.position = path.back().at(num).position;
+    value.velocity = 0.0;
+    value.acceleration = 0.0;
+    value.effort = 0.0;
+  }
+  ///////////////////////////////////////
+
+  *move_time = (sample_size - 1) * sample_period;
+  return true;
+}
+
+bool TimeOptimalParameterization::get_acceleration_range(uint32_t index, double x, double *lower, double *upper) const
+{
+  // |q' u + q'' x| <= max_acceleration for every joint
+  *lower = -TOPP_MAX_SQUARED_SPEED;
+  *upper = TOPP_MAX_SQUARED_SPEED;
+  for (uint8_t num = 0; num < num_of_joint_; num++)
+  {
+    double first = first_derivative_[index * num_of_joint_ + num];
+    double second = second_derivative_[index * num_of_joint_ + num];
+    double limit = max_acceleration_.at(num);
+
+    if (fabs(first) < 1E-12)
+    {
+      if (fabs(second * x) > limit) return false;
+      continue;
+    }
+    double bound_a = (-limit - second * x) / first;
+    double bound_b = ( limit - second * x) / first;
+    *lower = std::max(*lower, std::min(bound_a, bound_b));
+    *upper = std::min(*upper, std::max(bound_a, bound_b));
+  }
+  return *lower <= *upper;
+}
+
+double TimeOptimalParameterization::get_velocity_limit(uint32_t index) const
+{
+  // |q' sqrt(x)| <= max_velocity for every joint
+  double limit = TOPP_MAX_SQUARED_SPEED;
+  for (uint8_t num = 0; num < num_of_joint_; num++)
+  {
+    double first = fabs(first_derivative_[index * num_of_joint_ + num]);
+    if (first < 1E-12) continue;
+    limit = std::min(limit, (max_velocity_.at(num) / first) * (max_velocity_.at(num) / first));
+  }
+  return limit;
+}
+
+/*****************************************************************************
+** Blended Joint Path
+*****************************************************************************/
+#define BLEND_LIMIT_SAMPLE_SIZE 64
+
+double BlendedJointPath::get_move_time(const JointWaypoint &start, const JointWaypoint &goal, double min_move_time) const
+{
+  double feasible = std::max(min_move_time, 1E-3);
+  if (is_in_limit(start, goal, feasible)) return feasible;
+
+  // Stretch until the limits hold, then bisect back towards the shortest time
+  double infeasible = feasible;
+  for (uint8_t iteration = 0; iteration < 40 && !is_in_limit(start, goal, feasible); iteration++)
+  {
+    infeasible = feasible;
+    feasible *= 1.25;
+  }
+  for (uint8_t iteration = 0; iteration < 10; iteration++)
+  {
+    double middle = 0.5 * (infeasible + feasible);
+    if (is_in_limit(start, goal, middle)) feasible = middle;
+    else infeasible = middle;
+  }
+  return feasible;
+}
+
+void BlendedJointPath::setOption(const void *arg)
+{
+  if (arg != nullptr) limit_ = *(const JointLimit *)arg;
+}
+
+void BlendedJointPath::makeJointTrajectory(double move_time, JointWaypoint start, const void *arg)
+{
+  const JointWaypoint *goal = (const JointWaypoint *)arg;
+  move_time_ = move_time;
+
+  coefficient_.resize(start.size());
+  for (uint8_t num = 0; num < start.size(); num++)
+    calc_coefficient(start.at(num), num < goal->size() ? goal->at(num) : start.at(num), move_time_, &coefficient_.at(num));
+}
+
+JointWaypoint BlendedJointPath::getJointWaypoint(double tick)
+{
+  double t = std::min(std::max(tick, 0.0), move_time_);
+
+  JointWaypoint joint_waypoint(coefficient_.size());
+  for (uint8_t num = 0; num < coefficient_.size(); num++)
+  {
+    const Matrix<double, 6, 1> &c = coefficient_.at(num);
+    joint_waypoint.at(num).position     = c(0) + t * (c(1) + t * (c(2) + t * (c(3) + t * (c(4) + t * c(5)))));
+    joint_waypoint.at(num).velocity     = c(1) + t * (2.0 * c(2) + t * (3.0 * c(3) + t * (4.0 * c(4) + t * 5.0 * c(5))));
+    joint_waypoint.at(num).acceleration = 2.0 * c(2) + t * (6.0 * c(3) + t * (12.0 * c(4) + t * 20.0 * c(5)));
+    joint_waypoint.at(num).effort = 0.0;
+  }
+  return joint_waypoint;
+}
+
+//private
+void BlendedJointPath::calc_coefficient(const JointValue &start, const JointValue &goal, double move_time, Matrix<double, 6, 1> *coefficient)
+{
+  // Quintic through position, velocity and acceleration at both ends
+  double T = move_time;
+  double h = goal.position - start.position;
+
+  (*coefficient)(0) = start.position;
+  (*coefficient)(1) = start.velocity;
+  (*coefficient)(2) = 0.5 * start.acceleration;
+  (*coefficient)(3) = ( 20.0 * h - (8.0 * goal.velocity + 12.0 * start.velocity) * T - (3.0 * start.acceleration - goal.acceleration) * T * T) / (2.0 * pow(T, 3));
+  (*coefficient)(4) = (-30.0 * h + (14.0 * goal.velocity + 16.0 * start.velocity) * T + (3.0 * start.acceleration - 2.0 * goal.acceleration) * T * T) / (2.0 * pow(T, 4));
+  (*coefficient)(5) = ( 12.0 * h - 6.0 * (goal.velocity + start.velocity) * T + (goal.acceleration - start.acceleration) * T * T) / (2.0 * pow(T, 5));
+}
+
+bool BlendedJointPath::is_in_limit(const JointWaypoint &start, const JointWaypoint &goal, double move_time) const
+{
+  for (uint8_t num = 0; num < start.size() && num < limit_.max_velocity.size(); num++)
+  {
+    Matrix<double, 6, 1> c;
+    calc_coefficient(start.at(num), num < goal.size() ? goal.at(num) : start.at(num), move_time, &c);
+
+    // The start state is given, so a limit it already exceeds is not held against the path
+    double max_velocity = std::max(limit_.max_velocity.at(num), fabs(start.at(num).velocity));
+    double max_acceleration = num < limit_.max_acceleration.size() ? std::max(limit_.max_acceleration.at(num), fabs(start.at(num).acceleration)) : INFINITY;
+    double max_jerk = num < limit_.max_jerk.size() ? limit_.max_jerk.at(num) : INFINITY;
+
+    for (uint8_t sample = 0; sample <= BLEND_LIMIT_SAMPLE_SIZE; sample++)
+    {
+      double t = move_time * sample / BLEND_LIMIT_SAMPLE_SIZE;
+      double velocity     = c(1) + t * (2.0 * c(2) + t * (3.0 * c(3) + t * (4.0 * c(4) + t * 5.0 * c(5))));
+      double acceleration = 2.0 * c(2) + t * (6.0 * c(3) + t * (12.0 * c(4) + t * 20.0 * c(5)));
+      double jerk         = 6.0 * c(3) + t * (24.0 * c(4) + t * 60.0 * c(5));
+
+      if (fabs(velocity) > max_velocity || fabs(acceleration) > max_acceleration || fabs(jerk) > max_jerk) return false;
+    }
+  }
+  return true;
+}
+
 /*****************************************************************************
 ** Line
 *****************************************************************************/
@@ -119,6 +558,18 @@ void Circle::init_circle(double move_time, TaskWaypoint start, double radius, do
 
   path_generator_.calcCoefficient(drawingStart, drawingGoal, move_time);
   coefficient_ = path_generator_.getCoefficient();
+
+  if (samples_.is_enabled())
+  {
+    uint32_t sample_size = samples_.begin(move_time);
+    for (uint32_t index = 0; index < sample_size; index++)
+    {
+      TaskWaypoint pose = draw_circle(samples_.get_tick(index));
+      samples_.push_back(pose.kinematic.position(X_AXIS) - start_pose_.kinematic.position(X_AXIS),
+                         pose.kinematic.position(Y_AXIS) - start_pose_.kinematic.position(Y_AXIS));
+    }
+    samples_.finish();
+  }
 }
 
 TaskWaypoint Circle::draw_circle(double tick)
@@ -126,12 +577,8 @@ TaskWaypoint Circle::draw_circle(double tick)
   // get time variable
   double get_time_var = 0.0;
 
-  get_time_var = coefficient_(0) +
-                 coefficient_(1) * pow(tick, 1) +
-                 coefficient_(2) * pow(tick, 2) +
-                 coefficient_(3) * pow(tick, 3) +
-                 coefficient_(4) * pow(tick, 4) +
-                 coefficient_(5) * pow(tick, 5);
+  get_time_var = coefficient_(0) + tick * (coefficient_(1) + tick * (coefficient_(2) +
+                 tick * (coefficient_(3) + tick * (coefficient_(4) + tick * coefficient_(5)))));
 
   // set drawing trajectory
   TaskWaypoint pose;
@@ -157,6 +604,7 @@ TaskWaypoint Circle::draw_circle(double tick)
 
 TaskWaypoint Circle::getTaskWaypoint(double tick)
 {
+  if (samples_.is_enabled()) return samples_.get_waypoint(tick, start_pose_);
   return draw_circle(tick);
 }
 
@@ -166,7 +614,11 @@ void Circle::makeTaskTrajectory(double move_time, TaskWaypoint start, const void
   init_circle(move_time, start, get_arg_[0], get_arg_[1], get_arg_[2]);
 }
 
-void Circle::setOption(const void *arg){}
+void Circle::setOption(const void *arg)
+{
+  // Sample period (sec) of the pre-sampled path, 0.0 evaluates the path on every tick
+  if (arg != nullptr) samples_.set_sample_period(*(const double *)arg);
+}
 
 /*****************************************************************************
 ** Rhombus
@@ -193,6 +645,18 @@ void Rhombus::init_rhombus(double move_time, TaskWaypoint start, double radius,
 
   path_generator_.calcCoefficient(drawingStart, drawingGoal, move_time);
   coefficient_ = path_generator_.getCoefficient();
+
+  if (samples_.is_enabled())
+  {
+    uint32_t sample_size = samples_.begin(move_time);
+    for (uint32_t index = 0; index < sample_size; index++)
+    {
+      TaskWaypoint pose = draw_rhombus(samples_.get_tick(index));
+      samples_.push_back(pose.kinematic.position(X_AXIS) - start_pose_.kinematic.position(X_AXIS),
+                         pose.kinematic.position(Y_AXIS) - start_pose_.kinematic.position(Y_AXIS));
+    }
+    samples_.finish();
+  }
 }
 
 TaskWaypoint Rhombus::draw_rhombus(double tick)
@@ -200,12 +664,8 @@ TaskWaypoint Rhombus::draw_rhombus(double tick)
   // get time variable
   double get_time_var = 0.0;
 
-  get_time_var = coefficient_(0) +
-                 coefficient_(1) * pow(tick, 1) +
-                 coefficient_(2) * pow(tick, 2) +
-                 coefficient_(3) * pow(tick, 3) +
-                 coefficient_(4) * pow(tick, 4) +
-                 coefficient_(5) * pow(tick, 5); 
+  get_time_var = coefficient_(0) + tick * (coefficient_(1) + tick * (coefficient_(2) +
+                 tick * (coefficient_(3) + tick * (coefficient_(4) + tick * coefficient_(5)))));
 
   // set drawing trajectory
   TaskWaypoint pose;
@@ -257,9 +717,14 @@ void Rhombus::makeTaskTrajectory(double move_time, TaskWaypoint start, const voi
 
 TaskWaypoint Rhombus::getTaskWaypoint(double tick)
 {
+  if (samples_.is_enabled()) return samples_.get_waypoint(tick, start_pose_);
   return draw_rhombus(tick);
 }
-void Rhombus::setOption(const void *arg){}
+void Rhombus::setOption(const void *arg)
+{
+  // Sample period (sec) of the pre-sampled path, 0.0 evaluates the path on every tick
+  if (arg != nullptr) samples_.set_sample_period(*(const double *)arg);
+}
 
 /*****************************************************************************
 ** Heart
@@ -286,6 +751,18 @@ void Heart::init_heart(double move_time, TaskWaypoint start, double radius, doub
 
   path_generator_.calcCoefficient(drawingStart, drawingGoal, move_time);
   coefficient_ = path_generator_.getCoefficient();
+
+  if (samples_.is_enabled())
+  {
+    uint32_t sample_size = samples_.begin(move_time);
+    for (uint32_t index = 0; index < sample_size; index++)
+    {
+      TaskWaypoint pose = draw_heart(samples_.get_tick(index));
+      samples_.push_back(pose.kinematic.position(X_AXIS) - start_pose_.kinematic.position(X_AXIS),
+                         pose.kinematic.position(Y_AXIS) - start_pose_.kinematic.position(Y_AXIS));
+    }
+    samples_.finish();
+  }
 }
 
 TaskWaypoint Heart::draw_heart(double tick)
@@ -293,12 +770,8 @@ TaskWaypoint Heart::draw_heart(double tick)
   // get time variable
   double get_time_var = 0.0;
 
-  get_time_var = coefficient_(0) +
-                 coefficient_(1) * pow(tick, 1) +
-                 coefficient_(2) * pow(tick, 2) +
-                 coefficient_(3) * pow(tick, 3) +
-                 coefficient_(4) * pow(tick, 4) +
-                 coefficient_(5) * pow(tick, 5);
+  get_time_var = coefficient_(0) + tick * (coefficient_(1) + tick * (coefficient_(2) +
+                 tick * (coefficient_(3) + tick * (coefficient_(4) + tick * coefficient_(5)))));
 
   // set drawing trajectory
   TaskWaypoint pose;
@@ -333,9 +806,14 @@ void Heart::makeTaskTrajectory(double move_time, TaskWaypoint start, const void
   init_heart(move_time, start, get_arg_[0], get_arg_[1], get_arg_[2]);
 }
 
-void Heart::setOption(const void *arg){}
+void Heart::setOption(const void *arg)
+{
+  // Sample period (sec) of the pre-sampled path, 0.0 evaluates the path on every tick
+  if (arg != nullptr) samples_.set_sample_period(*(const double *)arg);
+}
 
 TaskWaypoint Heart::getTaskWaypoint(double tick)
 {
+  if (samples_.is_enabled()) return samples_.get_waypoint(tick, start_pose_);
   return draw_heart(tick);
 }
@@ -18,9 +18,694 @@
 
 #include "../include/open_manipulator_x_libs/dynamixel.hpp"
 
+#include <chrono>
+#include <cstring>
+
 using namespace dynamixel;
 using namespace robotis_manipulator;
 
+// The error counters are read by the diagnostics on other threads
+static void count(uint32_t *counter)
+{
+  __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+static uint32_t load(const uint32_t *counter)
+{
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+// DynamixelWorkbench only passes on the text of PacketHandler::getTxRxResult
+static uint8_t classify_error(const char *log)
+{
+  if (log == NULL) return BUS_ERROR_OTHER;
+  if (strstr(log, "There is no status packet") != NULL) return BUS_ERROR_TIMEOUT;   // COMM_RX_TIMEOUT
+  if (strstr(log, "Incorrect status packet") != NULL) return BUS_ERROR_CORRUPT;     // COMM_RX_CORRUPT
+  return BUS_ERROR_OTHER;
+}
+
+// Warm start: an actuator already in the mode keeps its torque on and only gets the registers that differ
+static bool set_joint_mode(DynamixelWorkbench *dynamixel_workbench, DynamixelBus *bus, uint8_t id, uint32_t velocity, uint32_t acceleration, const char **log)
+{
+  if (bus != NULL && bus->is_operating_mode(id, OPERATING_MODE_POSITION))
+    return bus->write_register(id, "Profile_Acceleration", acceleration, log) &&
+           bus->write_register(id, "Profile_Velocity", velocity, log);
+  return dynamixel_workbench->jointMode(id, velocity, acceleration, log);
+}
+
+static bool set_current_based_position_mode(DynamixelWorkbench *dynamixel_workbench, DynamixelBus *bus, uint8_t id, int32_t current, const char **log)
+{
+  if (bus != NULL && bus->is_operating_mode(id, OPERATING_MODE_CURRENT_BASED_POSITION))
+    return bus->write_register(id, "Goal_Current", current, log);
+  return dynamixel_workbench->currentBasedPositionMode(id, current, log);
+}
+
+static bool write_register(DynamixelWorkbench *dynamixel_workbench, DynamixelBus *bus, uint8_t id, const char *item_name, int32_t value, const char **log)
+{
+  if (bus != NULL) return bus->write_register(id, item_name, value, log);
+  return dynamixel_workbench->writeRegister(id, item_name, value, log);
+}
+
+/*****************************************************************************
+** Dynamixel Bus
+*****************************************************************************/
+DynamixelBus::DynamixelBus()
+: dynamixel_workbench_(nullptr),
+  sdk_handler_added_(false),
+  bulk_(false),
+  max_retry_(1),
+  retry_budget_(0.003),
+  bus_error_counter_(),
+  last_error_(NULL),
+  read_time_(0.0),
+  write_time_(0.0),
+  io_thread_running_(false),
+  transfer_pending_(false),
+  transfer_result_(true)
+{
+  dynamixel_.num = 0;
+}
+
+DynamixelBus::~DynamixelBus()
+{
+  DynamixelBus::stop_pipeline();
+  delete dynamixel_workbench_;
+}
+
+bool DynamixelBus::initialize(STRING dxl_device_name, STRING dxl_baud_rate)
+{
+  bool result = false;
+  const char* log = NULL;
+
+  dynamixel_workbench_ = new DynamixelWorkbench;
+
+  result = dynamixel_workbench_->init(dxl_device_name.c_str(), std::atoi(dxl_baud_rate.c_str()), &log);
+  if (result == false)
+  {
+    log::error(log);
+    return false;
+  }
+  return true;
+}
+
+bool DynamixelBus::negotiate_baud_rate(std::vector<uint8_t> actuator_id, STRING dxl_baud_rate, bool rewrite)
+{
+  bool result = false;
+  const char* log = NULL;
+
+  // The port is opened at the configured rate, where the actuators normally are
+  uint32_t target_baud_rate = std::atoi(dxl_baud_rate.c_str());
+  if (DynamixelBus::ping_all(actuator_id)) return true;
+
+  if (rewrite == false)
+  {
+    log::error("[DynamixelBus] Dynamixels don't respond at ", (double)target_baud_rate, 0);
+    return false;
+  }
+
+  // Where are the actuators now?
+  const uint32_t known_baud_rate[7] = {1000000, 57600, 115200, 2000000, 3000000, 4000000, 4500000};
+  uint32_t present_baud_rate = 0;
+  for (uint8_t index = 0; index < 7; index++)
+  {
+    if (known_baud_rate[index] == target_baud_rate) continue;
+    result = dynamixel_workbench_->setBaudrate(known_baud_rate[index], &log);
+    if (result == false) continue;
+
+    if (DynamixelBus::ping_all(actuator_id))
+    {
+      present_baud_rate = known_baud_rate[index];
+      break;
+    }
+  }
+
+  if (present_baud_rate == 0)
+  {
+    log::error("[DynamixelBus] Can't find the Dynamixels at any known baud rate");
+    return false;
+  }
+
+  // Baud_Rate is in EEPROM, which is only written with the torque off, and
+  // applied by the actuator right after the write
+  for (uint8_t index = 0; index < actuator_id.size(); index++)
+  {
+    result = dynamixel_workbench_->torqueOff(actuator_id.at(index), &log);
+    if (result == false)
+    {
+      log::error(log);
+      continue;
+    }
+    result = dynamixel_workbench_->changeBaudrate(actuator_id.at(index), target_baud_rate, &log);
+    if (result == false)
+    {
+      log::error(log);
+    }
+  }
+
+  result = dynamixel_workbench_->setBaudrate(target_baud_rate, &log);
+  if (result == false)
+  {
+    log::error(log);
+    return false;
+  }
+
+  if (DynamixelBus::ping_all(actuator_id) == false)
+  {
+    log::error("[DynamixelBus] Dynamixels don't respond at the new baud rate ", (double)target_baud_rate, 0);
+    return false;
+  }
+
+  log::println("[DynamixelBus] Baud rate changed to ", (double)target_baud_rate, 0);
+  return true;
+}
+
+bool DynamixelBus::set_transfer_mode(STRING transfer_mode)
+{
+  if (transfer_mode == DXL_TRANSFER_MODE_SYNC)
+  {
+    bulk_ = false;
+  }
+  else if (transfer_mode == DXL_TRANSFER_MODE_BULK)
+  {
+    bulk_ = true;
+  }
+  else
+  {
+    log::error("[DynamixelBus] Unknown transfer mode");
+    return false;
+  }
+  return true;
+}
+
+DynamixelWorkbench *DynamixelBus::get_workbench()
+{
+  return dynamixel_workbench_;
+}
+
+bool DynamixelBus::add_id(std::vector<uint8_t> actuator_id)
+{
+  bool result = false;
+  const char* log = NULL;
+
+  if (actuator_id.size() == 0) return false;
+
+  DynamixelBus::add_sdk_handler(actuator_id.at(0));
+
+  for (uint8_t index = 0; index < actuator_id.size(); index++)
+  {
+    result = dynamixel_workbench_->addBulkReadParam(actuator_id.at(index),
+                                                    ADDR_PRESENT_CURRENT_2,
+                                                    (LENGTH_PRESENT_CURRENT_2 + LENGTH_PRESENT_VELOCITY_2 + LENGTH_PRESENT_POSITION_2),
+                                                    &log);
+    if (result == false)
+    {
+      log::error(log);
+    }
+
+    dynamixel_.id.push_back(actuator_id.at(index));
+    present_current_.push_back(0);
+    present_velocity_.push_back(0);
+    present_position_.push_back(0);
+    goal_position_.push_back(0);
+    goal_staged_.push_back(false);
+    error_counter_.push_back(ActuatorErrorCounter());
+  }
+  dynamixel_.num = dynamixel_.id.size();
+
+  return true;
+}
+
+bool DynamixelBus::read_all()
+{
+  bool result = false;
+  const char* log = NULL;
+
+  if (dynamixel_.num == 0) return false;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  count(&bus_error_counter_.read);
+  result = DynamixelBus::read_block(0, dynamixel_.num, bulk_, &log);
+
+  for (uint8_t retry = 0; result == false; retry++)
+  {
+    count_error(&bus_error_counter_.read_error, log);
+    if (retry == max_retry_ || DynamixelBus::is_within_budget(start) == false) break;
+
+    count(&bus_error_counter_.retry);
+    result = DynamixelBus::read_block(0, dynamixel_.num, bulk_, &log);
+  }
+
+  if (result)
+  {
+    for (uint8_t index = 0; index < dynamixel_.num; index++)
+      __atomic_store_n(&error_counter_.at(index).stale_cycle, 0, __ATOMIC_RELAXED);
+  }
+  else
+  {
+    // Find the ids that don't answer, the others still get fresh values
+    result = true;
+    for (uint8_t index = 0; index < dynamixel_.num; index++)
+    {
+      ActuatorErrorCounter &counter = error_counter_.at(index);
+      bool id_result = false;
+
+      if (DynamixelBus::is_within_budget(start))
+      {
+        count(&bus_error_counter_.retry);
+        id_result = DynamixelBus::read_block(index, 1, false, &log);
+        if (id_result == false)
+        {
+          uint8_t error = classify_error(log);
+          if (error == BUS_ERROR_TIMEOUT) count(&counter.timeout);
+          else if (error == BUS_ERROR_CORRUPT) count(&counter.crc_error);
+          count_error(&bus_error_counter_.read_error, log);
+        }
+      }
+
+      if (id_result)
+      {
+        __atomic_store_n(&counter.stale_cycle, 0, __ATOMIC_RELAXED);
+      }
+      else
+      {
+        count(&counter.packet_loss);
+        count(&counter.stale_cycle);
+        result = false;
+      }
+    }
+  }
+
+  read_end_time_ = std::chrono::steady_clock::now();
+  read_time_ = std::chrono::duration<double>(read_end_time_ - start).count();
+  return result;
+}
+
+bool DynamixelBus::get_present_value(uint8_t actuator_id, int32_t *current, int32_t *velocity, int32_t *position)
+{
+  int8_t index = DynamixelBus::find_index(actuator_id);
+  if (index < 0) return false;
+
+  *current = present_current_.at(index);
+  *velocity = present_velocity_.at(index);
+  *position = present_position_.at(index);
+  return true;
+}
+
+bool DynamixelBus::stage_goal_position(uint8_t actuator_id, int32_t goal_position)
+{
+  int8_t index = DynamixelBus::find_index(actuator_id);
+  if (index < 0) return false;
+
+  goal_position_.at(index) = goal_position;
+  goal_staged_.at(index) = true;
+  return true;
+}
+
+bool DynamixelBus::write_all()
+{
+  bool result = false;
+  const char* log = NULL;
+
+  uint8_t id_array[dynamixel_.num];
+  int32_t goal_value[dynamixel_.num];
+  uint8_t id_num = 0;
+
+  for (uint8_t index = 0; index < dynamixel_.num; index++)
+  {
+    if (goal_staged_.at(index) == false) continue;
+
+    id_array[id_num] = dynamixel_.id.at(index);
+    goal_value[id_num] = goal_position_.at(index);
+    id_num++;
+
+    goal_staged_.at(index) = false;
+  }
+
+  if (id_num == 0) return true;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  count(&bus_error_counter_.write);
+  result = DynamixelBus::write_block(id_array, goal_value, id_num, &log);
+
+  // Goals have no status packet, a failure is on the transmitting side
+  for (uint8_t retry = 0; result == false; retry++)
+  {
+    count_error(&bus_error_counter_.write_error, log);
+    if (retry == max_retry_ || DynamixelBus::is_within_budget(start) == false) break;
+
+    count(&bus_error_counter_.retry);
+    result = DynamixelBus::write_block(id_array, goal_value, id_num, &log);
+  }
+  write_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  return result;
+}
+
+double DynamixelBus::get_read_time() const
+{
+  return read_time_;
+}
+
+double DynamixelBus::get_write_time() const
+{
+  return write_time_;
+}
+
+void DynamixelBus::set_retry_policy(uint8_t max_retry, double budget)
+{
+  max_retry_ = max_retry;
+  retry_budget_ = budget;
+}
+
+bool DynamixelBus::get_error_counter(uint8_t actuator_id, ActuatorErrorCounter *counter) const
+{
+  int8_t index = DynamixelBus::find_index(actuator_id);
+  if (index < 0) return false;
+
+  const ActuatorErrorCounter &error_counter = error_counter_.at(index);
+  counter->timeout = load(&error_counter.timeout);
+  counter->crc_error = load(&error_counter.crc_error);
+  counter->packet_loss = load(&error_counter.packet_loss);
+  counter->stale_cycle = load(&error_counter.stale_cycle);
+  return true;
+}
+
+BusErrorCounter DynamixelBus::get_bus_error_counter() const
+{
+  BusErrorCounter counter;
+  counter.read = load(&bus_error_counter_.read);
+  counter.read_error = load(&bus_error_counter_.read_error);
+  counter.write = load(&bus_error_counter_.write);
+  counter.write_error = load(&bus_error_counter_.write_error);
+  counter.retry = load(&bus_error_counter_.retry);
+  return counter;
+}
+
+const char *DynamixelBus::get_last_error() const
+{
+  return __atomic_load_n(&last_error_, __ATOMIC_RELAXED);
+}
+
+bool DynamixelBus::read_configuration(std::vector<uint8_t> actuator_id)
+{
+  bool result = false;
+  const char* log = NULL;
+
+  if (actuator_id.size() == 0) return false;
+  DynamixelBus::add_sdk_handler(actuator_id.at(0));
+
+  uint8_t id_num = actuator_id.size();
+  result = dynamixel_workbench_->syncRead(SYNC_READ_HANDLER_FOR_CONFIGURATION, actuator_id.data(), id_num, &log);
+  if (result == false)
+  {
+    log::error(log);
+    return false;   // cold start
+  }
+
+  int32_t ActuatorConfiguration::*field[7] = {&ActuatorConfiguration::return_delay_time, &ActuatorConfiguration::drive_mode,
+                                              &ActuatorConfiguration::operating_mode, &ActuatorConfiguration::torque_enable,
+                                              &ActuatorConfiguration::goal_current, &ActuatorConfiguration::profile_acceleration,
+                                              &ActuatorConfiguration::profile_velocity};
+  const uint16_t address[7] = {ADDR_RETURN_DELAY_TIME_2, ADDR_DRIVE_MODE_2, ADDR_OPERATING_MODE_2, ADDR_TORQUE_ENABLE_2,
+                               ADDR_GOAL_CURRENT_2, ADDR_PROFILE_ACCELERATION_2, ADDR_PROFILE_VELOCITY_2};
+  const uint16_t length[7] = {LENGTH_RETURN_DELAY_TIME_2, LENGTH_DRIVE_MODE_2, LENGTH_OPERATING_MODE_2, LENGTH_TORQUE_ENABLE_2,
+                              LENGTH_GOAL_CURRENT_2, LENGTH_PROFILE_ACCELERATION_2, LENGTH_PROFILE_VELOCITY_2};
+  std::vector<ActuatorConfiguration> configuration(id_num);
+
+  for (uint8_t item = 0; item < 7; item++)
+  {
+    int32_t data[id_num];
+    result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_CONFIGURATION,
+                                                   actuator_id.data(),
+                                                   id_num,
+                                                   address[item],
+                                                   length[item],
+                                                   data,
+                                                   &log);
+    if (result == false)
+    {
+      log::error(log);
+      return false;
+    }
+
+    for (uint8_t index = 0; index < id_num; index++)
+      configuration.at(index).*field[item] = data[index];
+  }
+
+  for (uint8_t index = 0; index < id_num; index++)
+    configuration_[actuator_id.at(index)] = configuration.at(index);
+  return true;
+}
+
+bool DynamixelBus::get_configuration(uint8_t actuator_id, ActuatorConfiguration *configuration) const
+{
+  std::map<uint8_t, ActuatorConfiguration>::const_iterator it = configuration_.find(actuator_id);
+  if (it == configuration_.end()) return false;
+
+  *configuration = it->second;
+  return true;
+}
+
+bool DynamixelBus::is_operating_mode(uint8_t actuator_id, int32_t operating_mode) const
+{
+  ActuatorConfiguration configuration;
+  if (DynamixelBus::get_configuration(actuator_id, &configuration) == false) return false;
+  return configuration.operating_mode == operating_mode;
+}
+
+bool DynamixelBus::write_register(uint8_t actuator_id, const char *item_name, int32_t value, const char **log)
+{
+  // Items of the configuration block that the setup writes by name
+  const char *name[4] = {"Return_Delay_Time", "Goal_Current", "Profile_Acceleration", "Profile_Velocity"};
+  int32_t ActuatorConfiguration::*field[4] = {&ActuatorConfiguration::return_delay_time, &ActuatorConfiguration::goal_current,
+                                              &ActuatorConfiguration::profile_acceleration, &ActuatorConfiguration::profile_velocity};
+
+  int32_t *stored_value = NULL;
+  std::map<uint8_t, ActuatorConfiguration>::iterator it = configuration_.find(actuator_id);
+  for (uint8_t index = 0; it != configuration_.end() && index < 4; index++)
+  {
+    if (strcmp(item_name, name[index]) == 0)
+      stored_value = &(it->second.*field[index]);
+  }
+  if (stored_value != NULL && *stored_value == value) return true;
+
+  bool result = dynamixel_workbench_->writeRegister(actuator_id, item_name, value, log);
+  if (result && stored_value != NULL) *stored_value = value;
+  return result;
+}
+
+void DynamixelBus::clear_configuration()
+{
+  configuration_.clear();
+}
+
+bool DynamixelBus::start_pipeline()
+{
+  if (dynamixel_workbench_ == nullptr) return false;
+  if (io_thread_running_) return true;
+
+  io_thread_running_ = true;
+  io_thread_ = std::thread(&DynamixelBus::io_thread_loop, this);
+  return true;
+}
+
+void DynamixelBus::stop_pipeline()
+{
+  if (io_thread_running_ == false) return;
+
+  {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    io_thread_running_ = false;
+  }
+  io_condition_.notify_all();
+  io_thread_.join();
+}
+
+bool DynamixelBus::is_pipelined() const
+{
+  return io_thread_running_;
+}
+
+bool DynamixelBus::start_transfer()
+{
+  {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    if (io_thread_running_ == false || transfer_pending_)
+    {
+      log::error("[DynamixelBus] Previous transfer is still in flight");
+      return false;
+    }
+    transfer_pending_ = true;
+  }
+  io_condition_.notify_all();
+  return true;
+}
+
+bool DynamixelBus::wait_transfer()
+{
+  std::unique_lock<std::mutex> lock(io_mutex_);
+  io_condition_.wait(lock, [this] { return transfer_pending_ == false; });
+  return transfer_result_;
+}
+
+double DynamixelBus::get_present_value_age() const
+{
+  if (read_end_time_.time_since_epoch().count() == 0) return 0.0;
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - read_end_time_).count();
+}
+
+bool DynamixelBus::read_block(uint8_t first_index, uint8_t id_num, bool bulk, const char **log)
+{
+  bool result = false;
+  uint8_t *id_array = dynamixel_.id.data() + first_index;
+
+  if (bulk)
+  {
+    result = dynamixel_workbench_->bulkRead(log);
+  }
+  else
+  {
+    result = dynamixel_workbench_->syncRead(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
+                                            id_array,
+                                            id_num,
+                                            log);
+  }
+  if (result == false) return false;   // keep the last values
+
+  // Unpack the received block, no further bus access
+  const uint16_t address[3] = {ADDR_PRESENT_CURRENT_2, ADDR_PRESENT_VELOCITY_2, ADDR_PRESENT_POSITION_2};
+  const uint16_t length[3] = {LENGTH_PRESENT_CURRENT_2, LENGTH_PRESENT_VELOCITY_2, LENGTH_PRESENT_POSITION_2};
+  int32_t *data[3] = {present_current_.data() + first_index, present_velocity_.data() + first_index, present_position_.data() + first_index};
+
+  for (uint8_t item = 0; item < 3; item++)
+  {
+    if (bulk)
+    {
+      std::vector<uint16_t> address_array(id_num, address[item]);
+      std::vector<uint16_t> length_array(id_num, length[item]);
+      result = dynamixel_workbench_->getBulkReadData(id_array,
+                                                     id_num,
+                                                     address_array.data(),
+                                                     length_array.data(),
+                                                     data[item],
+                                                     log);
+    }
+    else
+    {
+      result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
+                                                     id_array,
+                                                     id_num,
+                                                     address[item],
+                                                     length[item],
+                                                     data[item],
+                                                     log);
+    }
+    if (result == false) return false;
+  }
+  return true;
+}
+
+bool DynamixelBus::write_block(uint8_t *id_array, int32_t *goal_value, uint8_t id_num, const char **log)
+{
+  if (bulk_)
+  {
+    dynamixel_workbench_->initBulkWrite(log);
+    for (uint8_t index = 0; index < id_num; index++)
+    {
+      dynamixel_workbench_->addBulkWriteParam(id_array[index], ADDR_GOAL_POSITION_2, LENGTH_GOAL_POSITION_2, goal_value[index], log);
+    }
+    return dynamixel_workbench_->bulkWrite(log);
+  }
+  return dynamixel_workbench_->syncWrite(SYNC_WRITE_HANDLER, id_array, id_num, goal_value, 1, log);
+}
+
+bool DynamixelBus::is_within_budget(std::chrono::steady_clock::time_point start) const
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < retry_budget_;
+}
+
+void DynamixelBus::count_error(uint32_t *counter, const char *log)
+{
+  count(counter);
+  __atomic_store_n(&last_error_, log, __ATOMIC_RELAXED);
+}
+
+void DynamixelBus::add_sdk_handler(uint8_t actuator_id)
+{
+  bool result = false;
+  const char* log = NULL;
+
+  // Handlers are shared by every actuator on the bus (Goal_Position, present and configuration blocks are at the same address on all X series)
+  if (sdk_handler_added_) return;
+
+  result = dynamixel_workbench_->addSyncWriteHandler(actuator_id, "Goal_Position", &log);
+  if (result == false)
+  {
+    log::error(log);
+  }
+
+  // In the order of SYNC_READ_HANDLER_*
+  result = dynamixel_workbench_->addSyncReadHandler(ADDR_PRESENT_CURRENT_2,
+                                                    (LENGTH_PRESENT_CURRENT_2 + LENGTH_PRESENT_VELOCITY_2 + LENGTH_PRESENT_POSITION_2),
+                                                    &log);
+  if (result == false)
+  {
+    log::error(log);
+  }
+
+  result = dynamixel_workbench_->addSyncReadHandler(ADDR_RETURN_DELAY_TIME_2,
+                                                    (ADDR_PROFILE_VELOCITY_2 + LENGTH_PROFILE_VELOCITY_2 - ADDR_RETURN_DELAY_TIME_2),
+                                                    &log);
+  if (result == false)
+  {
+    log::error(log);
+  }
+
+  dynamixel_workbench_->initBulkRead(&log);
+  sdk_handler_added_ = true;
+}
+
+void DynamixelBus::io_thread_loop()
+{
+  std::unique_lock<std::mutex> lock(io_mutex_);
+  while (true)
+  {
+    // A transfer handed over before stop_pipeline still goes out
+    io_condition_.wait(lock, [this] { return transfer_pending_ || io_thread_running_ == false; });
+    if (transfer_pending_ == false) return;
+
+    lock.unlock();
+    bool result = DynamixelBus::write_all();
+    result = DynamixelBus::read_all() && result;
+    lock.lock();
+
+    transfer_result_ = result;
+    transfer_pending_ = false;
+    io_condition_.notify_all();
+  }
+}
+
+bool DynamixelBus::ping_all(std::vector<uint8_t> actuator_id)
+{
+  uint16_t get_model_number;
+  for (uint8_t index = 0; index < actuator_id.size(); index++)
+  {
+    if (dynamixel_workbench_->ping(actuator_id.at(index), &get_model_number) == false)
+      return false;
+  }
+  return true;
+}
+
+int8_t DynamixelBus::find_index(uint8_t actuator_id) const
+{
+  for (uint8_t index = 0; index < dynamixel_.num; index++)
+  {
+    if (dynamixel_.id.at(index) == actuator_id)
+      return index;
+  }
+  return -1;
+}
+
 /*****************************************************************************
 ** Joint Dynamixel Control Functions
 *****************************************************************************/
@@ -280,6 +965,7 @@ bool JointDynamixel::write_goal_position(std::vector<uint8_t> actuator_id, std::
   if (result == false)
   {
     log::error(log);
+    return false;
   }
 
   return true;
@@ -307,6 +993,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixel::receive_all_dyna
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
@@ -319,6 +1006,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixel::receive_all_dyna
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
@@ -331,6 +1019,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixel::receive_all_dyna
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
@@ -343,6 +1032,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixel::receive_all_dyna
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   for (uint8_t index = 0; index < actuator_id.size(); index++)
@@ -355,6 +1045,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixel::receive_all_dyna
     all_actuator.push_back(actuator);
   }
 
+  last_present_value_ = all_actuator;
   return all_actuator;
 }
 
@@ -362,8 +1053,32 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixel::receive_all_dyna
 ** Joint Dynamixel Profile Control Functions
 *****************************************************************************/
 JointDynamixelProfileControl::JointDynamixelProfileControl(float control_loop_time)
+: bus_(nullptr)
 {
   control_loop_time_ = control_loop_time;
+  present_loop_time_ = control_loop_time;
+  goal_delay_ = 0.0;
+}
+
+void JointDynamixelProfileControl::get_time_based_profile(float control_loop_time, uint32_t *profile_velocity, uint32_t *profile_acceleration)
+{
+  *profile_velocity = uint32_t(control_loop_time*1000) * 3;
+  *profile_acceleration = uint32_t(control_loop_time*1000);
+}
+
+void JointDynamixelProfileControl::set_present_loop_time(float present_loop_time)
+{
+  present_loop_time_ = present_loop_time;
+}
+
+void JointDynamixelProfileControl::set_goal_delay(float goal_delay)
+{
+  goal_delay_ = goal_delay;
+}
+
+void JointDynamixelProfileControl::set_bus(DynamixelBus *bus)
+{
+  bus_ = bus;
 }
 
 void JointDynamixelProfileControl::init(std::vector<uint8_t> actuator_id, const void *arg)
@@ -389,6 +1104,9 @@ void JointDynamixelProfileControl::setMode(std::vector<uint8_t> actuator_id, con
     if (result == false)
       return;
 
+    if (bus_ != nullptr)
+      return;
+
     result = JointDynamixelProfileControl::set_sdk_handler(actuator_id.at(0));
     if (result == false)
       return;
@@ -469,19 +1187,31 @@ bool JointDynamixelProfileControl::initialize(std::vector<uint8_t> actuator_id,
   dynamixel_.id = actuator_id;
   dynamixel_.num = actuator_id.size();
 
-  dynamixel_workbench_ = new DynamixelWorkbench;
-
-  result = dynamixel_workbench_->init(dxl_device_name.c_str(), std::atoi(dxl_baud_rate.c_str()), &log);
-  if (result == false)
+  if (bus_ != nullptr)
   {
-    log::error(log);
+    dynamixel_workbench_ = bus_->get_workbench();
+  }
+  else
+  {
+    dynamixel_workbench_ = new DynamixelWorkbench;
+
+    result = dynamixel_workbench_->init(dxl_device_name.c_str(), std::atoi(dxl_baud_rate.c_str()), &log);
+    if (result == false)
+    {
+      log::error(log);
+    }
   }
 
   uint16_t get_model_number;
   for (uint8_t index = 0; index < dynamixel_.num; index++)
   {
     uint8_t id = dynamixel_.id.at(index);
-    result = dynamixel_workbench_->ping(id, &get_model_number, &log);
+
+    // Warm start: answered the configuration read, and the bus pinged it before
+    ActuatorConfiguration configuration;
+    bool warm = bus_ != nullptr && bus_->get_configuration(id, &configuration);
+    if (warm) result = true;
+    else result = dynamixel_workbench_->ping(id, &get_model_number, &log);
 
     if (result == false)
     {
@@ -494,14 +1224,15 @@ bool JointDynamixelProfileControl::initialize(std::vector<uint8_t> actuator_id,
       sprintf(str, "Joint Dynamixel ID : %d, Model Name : %s", id, dynamixel_workbench_->getModelName(id));
       log::println(str);
 
-      result = dynamixel_workbench_->setTimeBasedProfile(id, &log);
+      if (warm && (configuration.drive_mode & DRIVE_MODE_TIME_BASED_PROFILE)) result = true;
+      else result = dynamixel_workbench_->setTimeBasedProfile(id, &log);
       if(result == false)
       {
         log::error(log);
         log::error("Please check your Dynamixel firmware version (v38~)");
       }
 
-      result = dynamixel_workbench_->writeRegister(id, return_delay_time_char, 0, &log);
+      result = write_register(dynamixel_workbench_, bus_, id, return_delay_time_char, 0, &log);
       if (result == false)
       {
         log::error(log);
@@ -509,6 +1240,10 @@ bool JointDynamixelProfileControl::initialize(std::vector<uint8_t> actuator_id,
       }
     }
   }
+
+  if (bus_ != nullptr)
+    bus_->add_id(dynamixel_.id);
+
   return true;
 }
 
@@ -517,15 +1252,16 @@ bool JointDynamixelProfileControl::set_operating_mode(std::vector<uint8_t> actua
   const char* log = NULL;
   bool result = false;
 
-  const uint32_t velocity = uint32_t(control_loop_time_*1000) * 3;
-  const uint32_t acceleration = uint32_t(control_loop_time_*1000);
+  uint32_t velocity = 0;
+  uint32_t acceleration = 0;
+  get_time_based_profile(control_loop_time_, &velocity, &acceleration);
   const uint32_t current = 0;
 
   if (dynamixel_mode == "position_mode")
   {
     for (uint8_t num = 0; num < actuator_id.size(); num++)
     {
-      result = dynamixel_workbench_->jointMode(actuator_id.at(num), velocity, acceleration, &log);
+      result = set_joint_mode(dynamixel_workbench_, bus_, actuator_id.at(num), velocity, acceleration, &log);
       if (result == false)
       {
         log::error(log);
@@ -536,7 +1272,7 @@ bool JointDynamixelProfileControl::set_operating_mode(std::vector<uint8_t> actua
   {
     for (uint8_t num = 0; num < actuator_id.size(); num++)
     {
-      result = dynamixel_workbench_->currentBasedPositionMode(actuator_id.at(num), current, &log);
+      result = set_current_based_position_mode(dynamixel_workbench_, bus_, actuator_id.at(num), current, &log);
       if (result == false)
       {
         log::error(log);
@@ -547,7 +1283,7 @@ bool JointDynamixelProfileControl::set_operating_mode(std::vector<uint8_t> actua
   {
     for (uint8_t num = 0; num < actuator_id.size(); num++)
     {
-      result = dynamixel_workbench_->jointMode(actuator_id.at(num), velocity, acceleration, &log);
+      result = set_joint_mode(dynamixel_workbench_, bus_, actuator_id.at(num), velocity, acceleration, &log);
       if (result == false)
       {
         log::error(log);
@@ -589,7 +1325,7 @@ bool JointDynamixelProfileControl::write_profile_value(std::vector<uint8_t> actu
 
   for (uint8_t num = 0; num < actuator_id.size(); num++)
   {
-    result = dynamixel_workbench_->writeRegister(actuator_id.at(num), char_profile_mode, value, &log);
+    result = write_register(dynamixel_workbench_, bus_, actuator_id.at(num), char_profile_mode, value, &log);
     if (result == false)
     {
       log::error(log);
@@ -610,14 +1346,15 @@ bool JointDynamixelProfileControl::write_goal_profiling_control_value(std::vecto
   for(uint8_t index = 0; index < actuator_id.size(); index++)
   {
     float result_position;
-    float time_control = control_loop_time_;       //ms
+    float time_control = present_loop_time_;       //s
 
     if(previous_goal_value_.find(actuator_id.at(index)) == previous_goal_value_.end())
     {
       previous_goal_value_.insert(std::make_pair(actuator_id.at(index), value_vector.at(index)));
     }
 
-    result_position = value_vector.at(index).position + 3*(value_vector.at(index).velocity * (time_control))/2;
+    result_position = value_vector.at(index).position + 3*(value_vector.at(index).velocity * (time_control))/2
+                      + value_vector.at(index).velocity * goal_delay_;
 
     id_array[index] = actuator_id.at(index);
     goal_value[index] = dynamixel_workbench_->convertRadian2Value(actuator_id.at(index), result_position);
@@ -625,10 +1362,19 @@ bool JointDynamixelProfileControl::write_goal_profiling_control_value(std::vecto
     previous_goal_value_[actuator_id.at(index)] = value_vector.at(index);
   }
 
+  // Sent together with the gripper by DynamixelBus::write_all
+  if (bus_ != nullptr)
+  {
+    for (uint8_t index = 0; index < actuator_id.size(); index++)
+      bus_->stage_goal_position(id_array[index], goal_value[index]);
+    return true;
+  }
+
   result = dynamixel_workbench_->syncWrite(SYNC_WRITE_HANDLER, id_array, actuator_id.size(), goal_value, 1, &log);
   if (result == false)
   {
     log::error(log);
+    return false;
   }
   return true;
 }
@@ -640,6 +1386,28 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixelProfileControl::re
 
   std::vector<robotis_manipulator::ActuatorValue> all_actuator;
 
+  // Values of the last DynamixelBus::read_all
+  if (bus_ != nullptr)
+  {
+    // Pipelined, that read went out right after the last write, about one cycle ago
+    double present_value_age = bus_->is_pipelined() ? bus_->get_present_value_age() : 0.0;
+
+    for (uint8_t index = 0; index < actuator_id.size(); index++)
+    {
+      int32_t get_current = 0, get_velocity = 0, get_position = 0;
+      bus_->get_present_value(actuator_id.at(index), &get_current, &get_velocity, &get_position);
+
+      robotis_manipulator::ActuatorValue actuator;
+      actuator.effort = dynamixel_workbench_->convertValue2Current(get_current);
+      actuator.velocity = dynamixel_workbench_->convertValue2Velocity(actuator_id.at(index), get_velocity);
+      actuator.position = dynamixel_workbench_->convertValue2Radian(actuator_id.at(index), get_position)
+                          + actuator.velocity * present_value_age;
+
+      all_actuator.push_back(actuator);
+    }
+    return all_actuator;
+  }
+
   uint8_t id_array[actuator_id.size()];
   for (uint8_t index = 0; index < actuator_id.size(); index++)
     id_array[index] = actuator_id.at(index);
@@ -655,6 +1423,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixelProfileControl::re
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
@@ -667,6 +1436,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixelProfileControl::re
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
@@ -679,6 +1449,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixelProfileControl::re
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
@@ -691,6 +1462,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixelProfileControl::re
   if (result == false)
   {
     log::error(log);
+    return last_present_value_;   // hold the last good values, none before the first
   }
 
   for (uint8_t index = 0; index < actuator_id.size(); index++)
@@ -703,6 +1475,7 @@ std::vector<robotis_manipulator::ActuatorValue> JointDynamixelProfileControl::re
     all_actuator.push_back(actuator);
   }
 
+  last_present_value_ = all_actuator;
   return all_actuator;
 }
 
@@ -739,11 +1512,19 @@ void GripperDynamixel::setMode(const void *arg)
       return;
   }
 
+  if (bus_ != nullptr)
+    return;
+
   result = GripperDynamixel::set_sdk_handler();
   if (result == false)
     return;
 }
 
+void GripperDynamixel::set_bus(DynamixelBus *bus)
+{
+  bus_ = bus;
+}
+
 uint8_t GripperDynamixel::getId()
 {
   return dynamixel_.id.at(0);
@@ -782,12 +1563,7 @@ bool GripperDynamixel::sendToolActuatorValue(robotis_manipulator::ActuatorValue
 
 robotis_manipulator::ActuatorValue GripperDynamixel::receiveToolActuatorValue()
 {
-  robotis_manipulator::ActuatorValue result;
-  result.position = GripperDynamixel::receive_dynamixel_value();
-  result.velocity = 0.0;
-  result.acceleration = 0.0;
-  result.effort = 0.0;
-  return result;
+  return GripperDynamixel::receive_all_dynamixel_value();
 }
 
 /*****************************************************************************
@@ -804,16 +1580,28 @@ bool GripperDynamixel::initialize(uint8_t actuator_id, STRING dxl_device_name, S
   dynamixel_.id.push_back(actuator_id);
   dynamixel_.num = 1;
 
-  dynamixel_workbench_ = new DynamixelWorkbench;
-
-  result = dynamixel_workbench_->init(dxl_device_name.c_str(), std::atoi(dxl_baud_rate.c_str()), &log);
-  if (result == false)
+  if (bus_ != nullptr)
   {
-    log::error(log);
+    dynamixel_workbench_ = bus_->get_workbench();
+  }
+  else
+  {
+    dynamixel_workbench_ = new DynamixelWorkbench;
+
+    result = dynamixel_workbench_->init(dxl_device_name.c_str(), std::atoi(dxl_baud_rate.c_str()), &log);
+    if (result == false)
+    {
+      log::error(log);
+    }
   }
 
+  // Warm start: answered the configuration read, and the bus pinged it before
+  ActuatorConfiguration configuration;
+  bool warm = bus_ != nullptr && bus_->get_configuration(dynamixel_.id.at(0), &configuration);
+
   uint16_t get_model_number;
-  result = dynamixel_workbench_->ping(dynamixel_.id.at(0), &get_model_number, &log);
+  if (warm) result = true;
+  else result = dynamixel_workbench_->ping(dynamixel_.id.at(0), &get_model_number, &log);
   if (result == false)
   {
     log::error(log);
@@ -826,14 +1614,15 @@ bool GripperDynamixel::initialize(uint8_t actuator_id, STRING dxl_device_name, S
     strcat(str, dynamixel_workbench_->getModelName(dynamixel_.id.at(0)));
     log::println(str);
 
-    result = dynamixel_workbench_->setVelocityBasedProfile(dynamixel_.id.at(0), &log);
+    if (warm && (configuration.drive_mode & DRIVE_MODE_TIME_BASED_PROFILE) == 0) result = true;
+    else result = dynamixel_workbench_->setVelocityBasedProfile(dynamixel_.id.at(0), &log);
     if(result == false)
     {
       log::error(log);
       log::error("Please check your Dynamixel firmware version (v38~)");
     }
 
-    result = dynamixel_workbench_->writeRegister(dynamixel_.id.at(0), return_delay_time_char, 0, &log);
+    result = write_register(dynamixel_workbench_, bus_, dynamixel_.id.at(0), return_delay_time_char, 0, &log);
     if (result == false)
     {
       log::error(log);
@@ -841,6 +1630,9 @@ bool GripperDynamixel::initialize(uint8_t actuator_id, STRING dxl_device_name, S
     }
   }
 
+  if (bus_ != nullptr)
+    bus_->add_id(dynamixel_.id);
+
   return true;
 }
 
@@ -855,7 +1647,7 @@ bool GripperDynamixel::set_operating_mode(STRING dynamixel_mode)
 
   if (dynamixel_mode == "position_mode")
   {
-    result = dynamixel_workbench_->jointMode(dynamixel_.id.at(0), velocity, acceleration, &log);
+    result = set_joint_mode(dynamixel_workbench_, bus_, dynamixel_.id.at(0), velocity, acceleration, &log);
     if (result == false)
     {
       log::error(log);
@@ -863,7 +1655,7 @@ bool GripperDynamixel::set_operating_mode(STRING dynamixel_mode)
   }
   else if (dynamixel_mode == "current_based_position_mode")
   {
-    result = dynamixel_workbench_->currentBasedPositionMode(dynamixel_.id.at(0), current, &log);
+    result = set_current_based_position_mode(dynamixel_workbench_, bus_, dynamixel_.id.at(0), current, &log);
     if (result == false)
     {
       log::error(log);
@@ -871,7 +1663,7 @@ bool GripperDynamixel::set_operating_mode(STRING dynamixel_mode)
   }
   else
   {
-    result = dynamixel_workbench_->jointMode(dynamixel_.id.at(0), velocity, acceleration, &log);
+    result = set_joint_mode(dynamixel_workbench_, bus_, dynamixel_.id.at(0), velocity, acceleration, &log);
     if (result == false)
     {
       log::error(log);
@@ -888,7 +1680,7 @@ bool GripperDynamixel::write_profile_value(STRING profile_mode, uint32_t value)
 
   const char * char_profile_mode = profile_mode.c_str();
 
-  result = dynamixel_workbench_->writeRegister(dynamixel_.id.at(0), char_profile_mode, value, &log);
+  result = write_register(dynamixel_workbench_, bus_, dynamixel_.id.at(0), char_profile_mode, value, &log);
   if (result == false)
   {
     log::error(log);
@@ -908,8 +1700,9 @@ bool GripperDynamixel::set_sdk_handler()
     log::error(log);
   }
 
-  result = dynamixel_workbench_->addSyncReadHandler(dynamixel_.id.at(0),
-                                                    "Present_Position", 
+  // Same block as the joints, so current and velocity come with the position
+  result = dynamixel_workbench_->addSyncReadHandler(ADDR_PRESENT_CURRENT_2,
+                                                    (LENGTH_PRESENT_CURRENT_2 + LENGTH_PRESENT_VELOCITY_2 + LENGTH_PRESENT_POSITION_2),
                                                     &log);
   if (result == false)
   {
@@ -928,41 +1721,95 @@ bool GripperDynamixel::write_goal_position(double radian)
 
   goal_position = dynamixel_workbench_->convertRadian2Value(dynamixel_.id.at(0), radian);
 
+  // Sent together with the joints by DynamixelBus::write_all
+  if (bus_ != nullptr)
+    return bus_->stage_goal_position(dynamixel_.id.at(0), goal_position);
+
   result = dynamixel_workbench_->syncWrite(SYNC_WRITE_HANDLER, &goal_position, &log);
   if (result == false)
   {
     log::error(log);
+    return false;
   }
 
   return true;
 }
 
 double GripperDynamixel::receive_dynamixel_value()
+{
+  return GripperDynamixel::receive_all_dynamixel_value().position;
+}
+
+robotis_manipulator::ActuatorValue GripperDynamixel::receive_all_dynamixel_value()
 {
   bool result = false;
   const char* log = NULL;
 
-  int32_t get_value = 0;
+  int32_t get_current = 0, get_velocity = 0, get_position = 0;
   uint8_t id_array[1] = {dynamixel_.id.at(0)};
 
-  result = dynamixel_workbench_->syncRead(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT, 
-                                          id_array,
-                                          (uint8_t)1,
-                                          &log);
-  if (result == false)
+  // Values of the last DynamixelBus::read_all
+  if (bus_ != nullptr)
   {
-    log::error(log);
+    bus_->get_present_value(dynamixel_.id.at(0), &get_current, &get_velocity, &get_position);
   }
-
-  result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT, 
+  else
+  {
+    result = dynamixel_workbench_->syncRead(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
                                             id_array,
                                             (uint8_t)1,
-                                            &get_value, 
                                             &log);
-  if (result == false)
-  {
-    log::error(log);
-  } 
+    if (result == false)
+    {
+      log::error(log);
+      return last_present_value_;   // hold the last good values
+    }
+
+    result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
+                                                   id_array,
+                                                   (uint8_t)1,
+                                                   ADDR_PRESENT_CURRENT_2,
+                                                   LENGTH_PRESENT_CURRENT_2,
+                                                   &get_current,
+                                                   &log);
+    if (result == false)
+    {
+      log::error(log);
+      return last_present_value_;   // hold the last good values
+    }
+
+    result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
+                                                   id_array,
+                                                   (uint8_t)1,
+                                                   ADDR_PRESENT_VELOCITY_2,
+                                                   LENGTH_PRESENT_VELOCITY_2,
+                                                   &get_velocity,
+                                                   &log);
+    if (result == false)
+    {
+      log::error(log);
+      return last_present_value_;   // hold the last good values
+    }
+
+    result = dynamixel_workbench_->getSyncReadData(SYNC_READ_HANDLER_FOR_PRESENT_POSITION_VELOCITY_CURRENT,
+                                                   id_array,
+                                                   (uint8_t)1,
+                                                   ADDR_PRESENT_POSITION_2,
+                                                   LENGTH_PRESENT_POSITION_2,
+                                                   &get_position,
+                                                   &log);
+    if (result == false)
+    {
+      log::error(log);
+      return last_present_value_;   // hold the last good values
+    }
+  }
 
-  return dynamixel_workbench_->convertValue2Radian(dynamixel_.id.at(0), get_value);
+  robotis_manipulator::ActuatorValue actuator;
+  actuator.effort = dynamixel_workbench_->convertValue2Current(get_current);
+  actuator.velocity = dynamixel_workbench_->convertValue2Velocity(dynamixel_.id.at(0), get_velocity);
+  actuator.position = dynamixel_workbench_->convertValue2Radian(dynamixel_.id.at(0), get_position);
+  actuator.acceleration = 0.0;
+  last_present_value_ = actuator;
+  return actuator;
 }
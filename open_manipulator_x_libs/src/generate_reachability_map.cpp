@@ -0,0 +1,47 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "open_manipulator_x_libs/open_manipulator_x.hpp"
+
+// Usage: generate_reachability_map <output file> [resolution (m)] [angle step (rad)]
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s <output file> [resolution] [angle_step]\n", argv[0]);
+    return 1;
+  }
+
+  double resolution = argc > 2 ? atof(argv[2]) : 0.02;
+  double angle_step = argc > 3 ? atof(argv[3]) : 0.02;
+
+  OpenManipulatorX open_manipulator_x;
+  open_manipulator_x.init_open_manipulator_x(true);
+
+  reachability::ReachabilityMap reachability_map;
+  if (!reachability_map.generate(open_manipulator_x.getManipulator(), resolution, angle_step)) return 1;
+  if (!reachability_map.save(argv[1])) return 1;
+
+  const reachability::MapHeader &header = reachability_map.get_header();
+  printf("Saved %u x %u x %u voxels (%.3f m) to %s\n",
+    header.size[0], header.size[1], header.size[2], header.resolution, argv[1]);
+  return 0;
+}
@@ -0,0 +1,133 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "../include/open_manipulator_x_libs/grasp_detector.hpp"
+
+#include <cmath>
+
+using namespace grasp;
+
+/*****************************************************************************
+** Grasp Detector
+*****************************************************************************/
+GraspDetector::GraspDetector()
+: state_(GRASP_STATE_IDLE),
+  has_goal_(false),
+  goal_position_(0.0),
+  closing_direction_(-1.0),   // the fingers of OpenManipulator-X close toward the min gripper limit
+  grasp_position_(0.0),
+  empty_start_time_(-1.0),
+  stall_start_time_(-1.0)
+{
+  // Goal current of GripperDynamixel is 200 (2.69 mA each), about 540 mA
+  option_.grasp_current = 250.0;
+  option_.release_current = 100.0;
+  option_.stall_velocity = 0.002;
+  option_.goal_tolerance = 0.001;
+  option_.slip_distance = 0.002;
+  option_.settle_time = 0.05;
+}
+
+void GraspDetector::set_option(const GraspOption &option)
+{
+  option_ = option;
+}
+
+GraspOption GraspDetector::get_option() const
+{
+  return option_;
+}
+
+uint8_t GraspDetector::update(double time, double goal_position, double present_position, double present_velocity, double present_current)
+{
+  // A new goal starts over: moving against the opening direction of the last one is closing
+  if (!has_goal_ || std::fabs(goal_position - goal_position_) > 0.5 * option_.goal_tolerance)
+  {
+    double travel = goal_position - present_position;
+    has_goal_ = true;
+    goal_position_ = goal_position;
+    empty_start_time_ = stall_start_time_ = -1.0;
+
+    if (std::fabs(travel) > option_.goal_tolerance && travel * closing_direction_ > 0.0) state_ = GRASP_STATE_CLOSING;
+    else if (std::fabs(travel) > option_.goal_tolerance) state_ = GRASP_STATE_IDLE;
+    // A goal right at the fingers keeps the state (e.g. the same goal sent again)
+  }
+
+  double error = goal_position_ - present_position;
+  switch (state_)
+  {
+    case GRASP_STATE_CLOSING:
+      if (is_settled(std::fabs(error) < option_.goal_tolerance, time, &empty_start_time_))
+      {
+        state_ = GRASP_STATE_EMPTY;
+        return GRASP_EVENT_EMPTY;
+      }
+      if (is_settled(std::fabs(error) >= option_.goal_tolerance && std::fabs(present_current) >= option_.grasp_current &&
+                     std::fabs(present_velocity) < option_.stall_velocity, time, &stall_start_time_))
+      {
+        state_ = GRASP_STATE_HOLDING;
+        grasp_position_ = present_position;
+        stall_start_time_ = -1.0;
+        return GRASP_EVENT_GRASPED;
+      }
+      break;
+
+    case GRASP_STATE_HOLDING:
+      // The object left the fingers: the current drops, or they close on further
+      if (is_settled(std::fabs(present_current) < option_.release_current ||
+                     (present_position - grasp_position_) * closing_direction_ > option_.slip_distance, time, &stall_start_time_))
+      {
+        state_ = GRASP_STATE_SLIPPED;
+        return GRASP_EVENT_SLIPPED;
+      }
+      break;
+
+    default:
+      break;
+  }
+  return GRASP_EVENT_NONE;
+}
+
+uint8_t GraspDetector::get_state() const
+{
+  return state_;
+}
+
+const char *GraspDetector::get_state_name(uint8_t state)
+{
+  const char *state_name[5] = {"idle", "closing", "holding", "empty", "slipped"};
+  return state < 5 ? state_name[state] : "";
+}
+
+const char *GraspDetector::get_event_name(uint8_t event)
+{
+  const char *event_name[4] = {"none", "grasped", "empty", "slipped"};
+  return event < 4 ? event_name[event] : "";
+}
+
+//private
+bool GraspDetector::is_settled(bool condition, double time, double *start_time)
+{
+  if (!condition)
+  {
+    *start_time = -1.0;
+    return false;
+  }
+  if (*start_time < 0.0) *start_time = time;
+  return time - *start_time >= option_.settle_time;
+}
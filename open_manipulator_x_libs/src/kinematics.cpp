@@ -22,11 +22,9 @@ using namespace robotis_manipulator;
 using namespace kinematics;
 
 /*****************************************************************************
-** Kinematics Solver Using Chain Rule and Jacobian
+** Chain Rule Kinematics Shared by the Solvers
 *****************************************************************************/
-void SolverUsingCRAndJacobian::setOption(const void *arg){}
-
-Eigen::MatrixXd SolverUsingCRAndJacobian::jacobian(Manipulator *manipulator, Name tool_name)
+static Eigen::MatrixXd chain_rule_jacobian(Manipulator *manipulator, Name tool_name)
 {
   Eigen::MatrixXd jacobian = Eigen::MatrixXd::Identity(6, manipulator->getDOF());
 
@@ -71,18 +69,7 @@ Eigen::MatrixXd SolverUsingCRAndJacobian::jacobian(Manipulator *manipulator, Nam
   return jacobian;
 }
 
-void SolverUsingCRAndJacobian::solveForwardKinematics(Manipulator *manipulator)
-{
-  forward_solver_using_chain_rule(manipulator, manipulator->getWorldChildName());
-}
-
-bool SolverUsingCRAndJacobian::solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
-{
-  return inverse_solver_using_jacobian(manipulator, tool_name, target_pose, goal_joint_value);
-}
-
-//private
-void SolverUsingCRAndJacobian::forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name)
+static void chain_rule_forward(Manipulator *manipulator, Name component_name)
 {
   Name my_name = component_name;
   Name parent_name = manipulator->getComponentParentName(my_name);
@@ -121,10 +108,183 @@ void SolverUsingCRAndJacobian::forward_solver_using_chain_rule(Manipulator *mani
   for (int8_t index = 0; index < number_of_child; index++)
   {
     Name child_name = manipulator->getComponentChildName(my_name).at(index);
-    forward_solver_using_chain_rule(manipulator, child_name);
+    chain_rule_forward(manipulator, child_name);
+  }
+}
+
+/*****************************************************************************
+** Fixed-Size Kinematics Kernel for OpenManipulator Chain
+*****************************************************************************/
+OMChainKernel::OMChainKernel()
+: loaded_(false)
+{
+  jacobian_ = Matrix<double, 6, 4>::Zero();
+}
+
+bool OMChainKernel::load(Manipulator *manipulator)
+{
+  if (loaded_) return true;
+
+  if (manipulator->getDOF() != 4) return false;
+
+  Name my_name = manipulator->getWorldChildName();
+  for (int8_t index = 0; index < 4; index++)
+  {
+    if (manipulator->getComponentChildName(my_name).size() != 1) return false;
+
+    joint_name_[index] = my_name;
+    relative_position_[index] = manipulator->getComponentRelativePositionFromParent(my_name);
+    relative_orientation_[index] = manipulator->getComponentRelativeOrientationFromParent(my_name);
+    axis_[index] = manipulator->getAxis(my_name);
+
+    my_name = manipulator->getComponentChildName(my_name).at(0);
+  }
+  if (manipulator->getComponentChildName(my_name).size() != 0) return false;
+
+  tool_name_ = my_name;
+  relative_position_[4] = manipulator->getComponentRelativePositionFromParent(my_name);
+  relative_orientation_[4] = manipulator->getComponentRelativeOrientationFromParent(my_name);
+
+  world_position_ = manipulator->getWorldPose().kinematic.position;
+  world_orientation_ = manipulator->getWorldPose().kinematic.orientation;
+
+  loaded_ = true;
+  return true;
+}
+
+bool OMChainKernel::is_loaded() const
+{
+  return loaded_;
+}
+
+Name OMChainKernel::get_joint_name(int8_t index) const
+{
+  return joint_name_[index];
+}
+
+Name OMChainKernel::get_tool_name() const
+{
+  return tool_name_;
+}
+
+const Vector3d &OMChainKernel::get_relative_position(int8_t index) const
+{
+  return relative_position_[index];
+}
+
+void OMChainKernel::read_joint_position(Manipulator *manipulator, Matrix<double, 4, 1> *joint_position) const
+{
+  for (int8_t index = 0; index < 4; index++)
+    (*joint_position)(index) = manipulator->getJointPosition(joint_name_[index]);
+}
+
+void OMChainKernel::forward(const Matrix<double, 4, 1> &joint_position)
+{
+  Vector3d parent_position = world_position_;
+  Matrix3d parent_orientation = world_orientation_;
+  Vector3d joint_axis[4];
+
+  for (int8_t index = 0; index < 4; index++)
+  {
+    // Rodrigues' rotation about the joint axis
+    Matrix3d skew;
+    skew <<            0.0, -axis_[index](2),  axis_[index](1),
+             axis_[index](2),              0.0, -axis_[index](0),
+            -axis_[index](1),  axis_[index](0),              0.0;
+    Matrix3d rotation = Matrix3d::Identity() + sin(joint_position(index)) * skew + (1.0 - cos(joint_position(index))) * skew * skew;
+
+    joint_axis[index] = parent_orientation * axis_[index];
+    position_[index] = parent_position + parent_orientation * relative_position_[index];
+    orientation_[index] = parent_orientation * relative_orientation_[index] * rotation;
+
+    parent_position = position_[index];
+    parent_orientation = orientation_[index];
+  }
+  position_[4] = parent_position + parent_orientation * relative_position_[4];
+  orientation_[4] = parent_orientation * relative_orientation_[4];
+
+  for (int8_t index = 0; index < 4; index++)
+  {
+    jacobian_.block<3, 1>(0, index) = joint_axis[index].cross(position_[4] - position_[index]);
+    jacobian_.block<3, 1>(3, index) = joint_axis[index];
+  }
+}
+
+void OMChainKernel::write_back(Manipulator *manipulator) const
+{
+  Pose pose_value;
+  pose_value.dynamic.linear.velocity = math::vector3(0.0, 0.0, 0.0);
+  pose_value.dynamic.angular.velocity = math::vector3(0.0, 0.0, 0.0);
+  pose_value.dynamic.linear.acceleration = math::vector3(0.0, 0.0, 0.0);
+  pose_value.dynamic.angular.acceleration = math::vector3(0.0, 0.0, 0.0);
+
+  for (int8_t index = 0; index < 5; index++)
+  {
+    pose_value.kinematic.position = position_[index];
+    pose_value.kinematic.orientation = orientation_[index];
+    manipulator->setComponentPoseFromWorld(index < 4 ? joint_name_[index] : tool_name_, pose_value);
   }
 }
 
+const Vector3d &OMChainKernel::get_tool_position() const
+{
+  return position_[4];
+}
+
+const Matrix3d &OMChainKernel::get_tool_orientation() const
+{
+  return orientation_[4];
+}
+
+Matrix4d OMChainKernel::get_tool_transform() const
+{
+  Matrix4d transform = Matrix4d::Identity();
+  transform.block<3, 3>(0, 0) = orientation_[4];
+  transform.block<3, 1>(0, 3) = position_[4];
+  return transform;
+}
+
+const Vector3d &OMChainKernel::get_frame_position(int8_t index) const
+{
+  return index < 0 ? world_position_ : position_[index];
+}
+
+const Matrix3d &OMChainKernel::get_frame_orientation(int8_t index) const
+{
+  return index < 0 ? world_orientation_ : orientation_[index];
+}
+
+const Matrix<double, 6, 4> &OMChainKernel::get_jacobian() const
+{
+  return jacobian_;
+}
+
+/*****************************************************************************
+** Kinematics Solver Using Chain Rule and Jacobian
+*****************************************************************************/
+void SolverUsingCRAndJacobian::setOption(const void *arg){}
+
+Eigen::MatrixXd SolverUsingCRAndJacobian::jacobian(Manipulator *manipulator, Name tool_name)
+{
+  return chain_rule_jacobian(manipulator, tool_name);
+}
+
+void SolverUsingCRAndJacobian::solveForwardKinematics(Manipulator *manipulator)
+{
+  forward_solver_using_chain_rule(manipulator, manipulator->getWorldChildName());
+}
+
+bool SolverUsingCRAndJacobian::solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+{
+  return inverse_solver_using_jacobian(manipulator, tool_name, target_pose, goal_joint_value);
+}
+
+//private
+void SolverUsingCRAndJacobian::forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name)
+{
+  chain_rule_forward(manipulator, component_name);
+}
+
 bool SolverUsingCRAndJacobian::inverse_solver_using_jacobian(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
 {
   const double lambda = 0.7;
@@ -182,47 +342,7 @@ void SolverUsingCRAndSRJacobian::setOption(const void *arg){}
 
 Eigen::MatrixXd SolverUsingCRAndSRJacobian::jacobian(Manipulator *manipulator, Name tool_name)
 {
-  Eigen::MatrixXd jacobian = Eigen::MatrixXd::Identity(6, manipulator->getDOF());
-
-  Eigen::Vector3d joint_axis = Eigen::Vector3d::Zero(3);
-
-  Eigen::Vector3d position_changed = Eigen::Vector3d::Zero(3);
-  Eigen::Vector3d orientation_changed = Eigen::Vector3d::Zero(3);
-  Eigen::VectorXd pose_changed = Eigen::VectorXd::Zero(6);
-
-  //////////////////////////////////////////////////////////////////////////////////
-
-  int8_t index = 0;
-  Name my_name =  manipulator->getWorldChildName();
-
-  for (int8_t size = 0; size < manipulator->getDOF(); size++)
-  {
-    Name parent_name = manipulator->getComponentParentName(my_name);
-    if (parent_name == manipulator->getWorldName())
-    {
-      joint_axis = manipulator->getWorldOrientation() * manipulator->getAxis(my_name);
-    }
-    else
-    {
-      joint_axis = manipulator->getComponentOrientationFromWorld(parent_name) * manipulator->getAxis(my_name);
-    }
-
-    position_changed = math::skewSymmetricMatrix(joint_axis) *
-                       (manipulator->getComponentPositionFromWorld(tool_name) - manipulator->getComponentPositionFromWorld(my_name));
-    orientation_changed = joint_axis;
-
-    pose_changed << position_changed(0),
-        position_changed(1),
-        position_changed(2),
-        orientation_changed(0),
-        orientation_changed(1),
-        orientation_changed(2);
-
-    jacobian.col(index) = pose_changed;
-    index++;
-    my_name = manipulator->getComponentChildName(my_name).at(0); // Get Child name which has active joint
-  }
-  return jacobian;
+  return chain_rule_jacobian(manipulator, tool_name);
 }
 
 void SolverUsingCRAndSRJacobian::solveForwardKinematics(Manipulator *manipulator)
@@ -238,44 +358,7 @@ bool SolverUsingCRAndSRJacobian::solveInverseKinematics(Manipulator *manipulator
 //private
 void SolverUsingCRAndSRJacobian::forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name)
 {
-  Name my_name = component_name;
-  Name parent_name = manipulator->getComponentParentName(my_name);
-  int8_t number_of_child = manipulator->getComponentChildName(my_name).size();
-
-  Pose parent_pose_value;
-  Pose my_pose_value;
-
-  //Get Parent Pose
-  if (parent_name == manipulator->getWorldName())
-  {
-    parent_pose_value = manipulator->getWorldPose();
-  }
-  else
-  {
-    parent_pose_value = manipulator->getComponentPoseFromWorld(parent_name);
-  }
-
-  //position
-  my_pose_value.kinematic.position = parent_pose_value.kinematic.position
-                                   + (parent_pose_value.kinematic.orientation * manipulator->getComponentRelativePositionFromParent(my_name));
-  //orientation
-  my_pose_value.kinematic.orientation = parent_pose_value.kinematic.orientation * manipulator->getComponentRelativeOrientationFromParent(my_name) * math::rodriguesRotationMatrix(manipulator->getAxis(my_name), manipulator->getJointPosition(my_name)); 
-  //linear velocity
-  my_pose_value.dynamic.linear.velocity = math::vector3(0.0, 0.0, 0.0);
-  //angular velocity
-  my_pose_value.dynamic.angular.velocity = math::vector3(0.0, 0.0, 0.0);
-  //linear acceleration
-  my_pose_value.dynamic.linear.acceleration = math::vector3(0.0, 0.0, 0.0);
-  //angular acceleration
-  my_pose_value.dynamic.angular.acceleration = math::vector3(0.0, 0.0, 0.0);
-
-  manipulator->setComponentPoseFromWorld(my_name, my_pose_value);
-
-  for (int8_t index = 0; index < number_of_child; index++)
-  {
-    Name child_name = manipulator->getComponentChildName(my_name).at(index);
-    forward_solver_using_chain_rule(manipulator, child_name);
-  }
+  chain_rule_forward(manipulator, component_name);
 }
 
 bool SolverUsingCRAndSRJacobian::inverse_solver_using_sr_jacobian(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
@@ -448,47 +531,7 @@ void SolverUsingCRAndSRPositionOnlyJacobian::setOption(const void *arg){}
 
 Eigen::MatrixXd SolverUsingCRAndSRPositionOnlyJacobian::jacobian(Manipulator *manipulator, Name tool_name)
 {
-  Eigen::MatrixXd jacobian = Eigen::MatrixXd::Identity(6, manipulator->getDOF());
-
-  Eigen::Vector3d joint_axis = Eigen::Vector3d::Zero(3);
-
-  Eigen::Vector3d position_changed = Eigen::Vector3d::Zero(3);
-  Eigen::Vector3d orientation_changed = Eigen::Vector3d::Zero(3);
-  Eigen::VectorXd pose_changed = Eigen::VectorXd::Zero(6);
-
-  //////////////////////////////////////////////////////////////////////////////////
-
-  int8_t index = 0;
-  Name my_name =  manipulator->getWorldChildName();
-
-  for (int8_t size = 0; size < manipulator->getDOF(); size++)
-  {
-    Name parent_name = manipulator->getComponentParentName(my_name);
-    if (parent_name == manipulator->getWorldName())
-    {
-      joint_axis = manipulator->getWorldOrientation() * manipulator->getAxis(my_name);
-    }
-    else
-    {
-      joint_axis = manipulator->getComponentOrientationFromWorld(parent_name) * manipulator->getAxis(my_name);
-    }
-
-    position_changed = math::skewSymmetricMatrix(joint_axis) *
-                       (manipulator->getComponentPositionFromWorld(tool_name) - manipulator->getComponentPositionFromWorld(my_name));
-    orientation_changed = joint_axis;
-
-    pose_changed << position_changed(0),
-        position_changed(1),
-        position_changed(2),
-        orientation_changed(0),
-        orientation_changed(1),
-        orientation_changed(2);
-
-    jacobian.col(index) = pose_changed;
-    index++;
-    my_name = manipulator->getComponentChildName(my_name).at(0); // Get Child name which has active joint
-  }
-  return jacobian;
+  return chain_rule_jacobian(manipulator, tool_name);
 }
 
 void SolverUsingCRAndSRPositionOnlyJacobian::solveForwardKinematics(Manipulator *manipulator)
@@ -504,55 +547,18 @@ bool SolverUsingCRAndSRPositionOnlyJacobian::solveInverseKinematics(Manipulator
 //private
 void SolverUsingCRAndSRPositionOnlyJacobian::forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name)
 {
-  Name my_name = component_name;
-  Name parent_name = manipulator->getComponentParentName(my_name);
-  int8_t number_of_child = manipulator->getComponentChildName(my_name).size();
+  chain_rule_forward(manipulator, component_name);
+}
 
-  Pose parent_pose_value;
-  Pose my_pose_value;
+bool SolverUsingCRAndSRPositionOnlyJacobian::inverse_solver_using_position_only_sr_jacobian(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+{
+  //manipulator
+  Manipulator _manipulator = *manipulator;
 
-  //Get Parent Pose
-  if (parent_name == manipulator->getWorldName())
-  {
-    parent_pose_value = manipulator->getWorldPose();
-  }
-  else
-  {
-    parent_pose_value = manipulator->getComponentPoseFromWorld(parent_name);
-  }
-
-  //position
-  my_pose_value.kinematic.position = parent_pose_value.kinematic.position
-                                   + (parent_pose_value.kinematic.orientation * manipulator->getComponentRelativePositionFromParent(my_name));
-  //orientation
-  my_pose_value.kinematic.orientation = parent_pose_value.kinematic.orientation * manipulator->getComponentRelativeOrientationFromParent(my_name) * math::rodriguesRotationMatrix(manipulator->getAxis(my_name), manipulator->getJointPosition(my_name)); 
-  //linear velocity
-  my_pose_value.dynamic.linear.velocity = math::vector3(0.0, 0.0, 0.0);
-  //angular velocity
-  my_pose_value.dynamic.angular.velocity = math::vector3(0.0, 0.0, 0.0);
-  //linear acceleration
-  my_pose_value.dynamic.linear.acceleration = math::vector3(0.0, 0.0, 0.0);
-  //angular acceleration
-  my_pose_value.dynamic.angular.acceleration = math::vector3(0.0, 0.0, 0.0);
-
-  manipulator->setComponentPoseFromWorld(my_name, my_pose_value);
-
-  for (int8_t index = 0; index < number_of_child; index++)
-  {
-    Name child_name = manipulator->getComponentChildName(my_name).at(index);
-    forward_solver_using_chain_rule(manipulator, child_name);
-  }
-}
-
-bool SolverUsingCRAndSRPositionOnlyJacobian::inverse_solver_using_position_only_sr_jacobian(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
-{
-  //manipulator
-  Manipulator _manipulator = *manipulator;
-
-  //solver parameter
-  double lambda = 0.0;
-  const double param = 0.002;
-  const int8_t iteration = 10;
+  //solver parameter
+  double lambda = 0.0;
+  const double param = 0.002;
+  const int8_t iteration = 10;
 
   const double gamma = 0.5;             //rollback delta
 
@@ -708,106 +714,332 @@ bool SolverUsingCRAndSRPositionOnlyJacobian::inverse_solver_using_position_only_
 }
 
 /*****************************************************************************
-** Kinematics Solver Customized for OpenManipulator Chain
+** Kinematics Solver Using Multi-Start Singularity Robust Jacobian
 *****************************************************************************/
-void SolverCustomizedforOMChain::setOption(const void *arg){}
+#define MULTI_START_ITERATION 20
+
+// Additive recurrence (R4 sequence) spreading the seeds evenly over the joint limits
+static const double MULTI_START_SEQUENCE[4] = {0.8566748839, 0.7338918496, 0.6287067210, 0.5385972572};
+
+SolverMultiStartOMChain::SolverMultiStartOMChain(bool position_only, uint8_t num_threads)
+: position_only_(position_only),
+  next_seed_(0),
+  stop_(false),
+  solved_(false),
+  solved_distance_(0.0),
+  job_id_(0),
+  busy_workers_(0),
+  shutdown_(false),
+  worker_policy_(SCHED_OTHER),
+  worker_priority_(0)
+{
+  option_.num_seeds = 8;
+  option_.deadline = 0.0;
+  option_.prefer_closest = false;
+
+  // Index 0 is used by the calling thread
+  if (num_threads < 1) num_threads = 1;
+  worker_chain_.resize(num_threads);
+  for (uint8_t index = 1; index < num_threads; index++)
+    worker_.push_back(std::thread(&SolverMultiStartOMChain::worker_loop, this, index));
+}
 
-Eigen::MatrixXd SolverCustomizedforOMChain::jacobian(Manipulator *manipulator, Name tool_name)
+SolverMultiStartOMChain::~SolverMultiStartOMChain()
 {
-  Eigen::MatrixXd jacobian = Eigen::MatrixXd::Identity(6, manipulator->getDOF());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  job_condition_.notify_all();
+  for (uint8_t index = 0; index < worker_.size(); index++)
+    worker_.at(index).join();
+}
 
-  Eigen::Vector3d joint_axis = Eigen::Vector3d::Zero(3);
+void SolverMultiStartOMChain::setOption(const void *arg)
+{
+  if (arg == nullptr) return;
+  option_ = *(const MultiStartOption *)arg;
+  if (option_.num_seeds < 1) option_.num_seeds = 1;
+}
 
-  Eigen::Vector3d position_changed = Eigen::Vector3d::Zero(3);
-  Eigen::Vector3d orientation_changed = Eigen::Vector3d::Zero(3);
-  Eigen::VectorXd pose_changed = Eigen::VectorXd::Zero(6);
+Eigen::MatrixXd SolverMultiStartOMChain::jacobian(Manipulator *manipulator, Name tool_name)
+{
+  return sr_solver_.jacobian(manipulator, tool_name);
+}
 
-  //////////////////////////////////////////////////////////////////////////////////
+void SolverMultiStartOMChain::solveForwardKinematics(Manipulator *manipulator)
+{
+  if (chain_.load(manipulator))
+  {
+    Matrix<double, 4, 1> joint_position;
+    chain_.read_joint_position(manipulator, &joint_position);
+    chain_.forward(joint_position);
+    chain_.write_back(manipulator);
+    return;
+  }
+  sr_solver_.solveForwardKinematics(manipulator);
+}
 
-  int8_t index = 0;
-  Name my_name =  manipulator->getWorldChildName();
+bool SolverMultiStartOMChain::solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+{
+  if (!chain_.load(manipulator) || tool_name != chain_.get_tool_name())
+  {
+    if (position_only_) return position_only_sr_solver_.solveInverseKinematics(manipulator, tool_name, target_pose, goal_joint_value);
+    return sr_solver_.solveInverseKinematics(manipulator, tool_name, target_pose, goal_joint_value);
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  match_caller_scheduling();
 
-  for (int8_t size = 0; size < manipulator->getDOF(); size++)
+  //////////////make seeds////////////////
+  chain_.read_joint_position(manipulator, &present_angle_);
+  for (int8_t index = 0; index < 4; index++)
   {
-    Name parent_name = manipulator->getComponentParentName(my_name);
-    if (parent_name == manipulator->getWorldName())
+    min_limit_(index) = manipulator->getJointMinLimit(chain_.get_joint_name(index));
+    max_limit_(index) = manipulator->getJointMaxLimit(chain_.get_joint_name(index));
+    if (max_limit_(index) <= min_limit_(index))
     {
-      joint_axis = manipulator->getWorldOrientation() * manipulator->getAxis(my_name);
+      min_limit_(index) = -M_PI;
+      max_limit_(index) = M_PI;
     }
-    else
+  }
+
+  seed_.resize(option_.num_seeds);
+  seed_.at(0) = present_angle_;
+  for (uint8_t seed = 1; seed < option_.num_seeds; seed++)
+  {
+    for (int8_t index = 0; index < 4; index++)
     {
-      joint_axis = manipulator->getComponentOrientationFromWorld(parent_name) * manipulator->getAxis(my_name);
+      double fraction = 0.5 + seed * MULTI_START_SEQUENCE[index];
+      fraction -= floor(fraction);
+      seed_.at(seed)(index) = min_limit_(index) + fraction * (max_limit_(index) - min_limit_(index));
     }
+  }
+  ///////////////////////////////////////
 
-    position_changed = math::skewSymmetricMatrix(joint_axis) *
-                       (manipulator->getComponentPositionFromWorld(tool_name) - manipulator->getComponentPositionFromWorld(my_name));
-    orientation_changed = joint_axis;
+  //////////////run workers///////////////
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    target_pose_ = target_pose;
+    if (option_.deadline > 0.0)
+      deadline_ = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(option_.deadline));
+    else
+      deadline_ = std::chrono::steady_clock::time_point::max();
+    for (uint8_t index = 0; index < worker_chain_.size(); index++)
+      worker_chain_.at(index) = chain_;
+
+    next_seed_ = 0;
+    stop_ = false;
+    solved_ = false;
+    busy_workers_ = worker_.size();
+    job_id_++;
+  }
+  job_condition_.notify_all();
 
-    pose_changed << position_changed(0),
-        position_changed(1),
-        position_changed(2),
-        orientation_changed(0),
-        orientation_changed(1),
-        orientation_changed(2);
+  run_seeds(&worker_chain_.at(0));
 
-    jacobian.col(index) = pose_changed;
-    index++;
-    my_name = manipulator->getComponentChildName(my_name).at(0); // Get Child name which has active joint
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_condition_.wait(lock, [this]() { return busy_workers_ == 0; });
   }
-  return jacobian;
+  ///////////////////////////////////////
+
+  if (!solved_)
+  {
+    log::error("[multi_start]fail to solve inverse kinematics");
+    *goal_joint_value = {};
+    return false;
+  }
+
+  goal_joint_value->resize(4);
+  for(int8_t index = 0; index < 4; index++)
+  {
+    goal_joint_value->at(index).position = solved_angle_(index);
+    goal_joint_value->at(index).velocity = 0.0;
+    goal_joint_value->at(index).acceleration = 0.0;
+    goal_joint_value->at(index).effort = 0.0;
+  }
+  return true;
 }
 
-void SolverCustomizedforOMChain::solveForwardKinematics(Manipulator *manipulator)
+//private
+void SolverMultiStartOMChain::worker_loop(uint8_t worker_index)
 {
-  forward_solver_using_chain_rule(manipulator, manipulator->getWorldChildName());
+  uint32_t job_id = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    job_condition_.wait(lock, [this, &job_id]() { return shutdown_ || job_id_ != job_id; });
+    if (shutdown_) return;
+    job_id = job_id_;
+
+    lock.unlock();
+    run_seeds(&worker_chain_.at(worker_index));
+    lock.lock();
+
+    if (--busy_workers_ == 0) idle_condition_.notify_all();
+  }
 }
 
-bool SolverCustomizedforOMChain::solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+void SolverMultiStartOMChain::match_caller_scheduling()
 {
-  return chain_custom_inverse_kinematics(manipulator, tool_name, target_pose, goal_joint_value);
+  // A real-time control loop would otherwise wait on workers that any other thread preempts
+  int policy = SCHED_OTHER;
+  struct sched_param param;
+  if (pthread_getschedparam(pthread_self(), &policy, &param) != 0) return;
+  if (policy == worker_policy_ && param.sched_priority == worker_priority_) return;
+
+  worker_policy_ = policy;
+  worker_priority_ = param.sched_priority;
+  for (uint8_t index = 0; index < worker_.size(); index++)
+  {
+    if (pthread_setschedparam(worker_.at(index).native_handle(), policy, &param) != 0)
+      log::error("[multi_start]fail to set the scheduling of the worker threads");
+  }
 }
 
-//private
-void SolverCustomizedforOMChain::forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name)
+void SolverMultiStartOMChain::run_seeds(OMChainKernel *chain)
 {
-  Name my_name = component_name;
-  Name parent_name = manipulator->getComponentParentName(my_name);
-  int8_t number_of_child = manipulator->getComponentChildName(my_name).size();
+  for (uint32_t seed = next_seed_++; seed < seed_.size() && !stop_; seed = next_seed_++)
+  {
+    if (std::chrono::steady_clock::now() > deadline_) return;
 
-  Pose parent_pose_value;
-  Pose my_pose_value;
+    Matrix<double, 4, 1> angle = seed_.at(seed);
+    if (!solve_from_seed(chain, &angle)) continue;
 
-  //Get Parent Pose
-  if (parent_name == manipulator->getWorldName())
+    double distance = (angle - present_angle_).norm();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!solved_ || distance < solved_distance_)
+    {
+      solved_ = true;
+      solved_distance_ = distance;
+      solved_angle_ = angle;
+    }
+    if (!option_.prefer_closest) stop_ = true;
+  }
+}
+
+bool SolverMultiStartOMChain::solve_from_seed(OMChainKernel *chain, Matrix<double, 4, 1> *angle)
+{
+  //solver parameter
+  double lambda = 0.0;
+  const double param = 0.002;
+  const double gamma = 0.5;             //rollback delta
+
+  //sr sovler parameter (no orientation weight for position only)
+  double wn_pos = 1 / 0.3;
+  double wn_ang = position_only_ ? 0.0 : 1 / (2 * M_PI);
+  double pre_Ek = 0.0;
+  double new_Ek = 0.0;
+
+  Matrix<double, 6, 1> We;
+  We << wn_pos, wn_pos, wn_pos, wn_ang, wn_ang, wn_ang;
+
+  Matrix<double, 6, 4> weighted_jacobian;
+  Matrix4d sr_jacobian;
+  Matrix<double, 6, 1> pose_changed;
+  Matrix<double, 4, 1> angle_changed;
+  Matrix<double, 4, 1> gerr;
+
+  chain->forward(*angle);
+  pose_changed.head<3>() = target_pose_.kinematic.position - chain->get_tool_position();
+  pose_changed.tail<3>() = chain->get_tool_orientation() * math::matrixLogarithm(chain->get_tool_orientation().transpose() * target_pose_.kinematic.orientation);
+  pre_Ek = pose_changed.transpose() * We.asDiagonal() * pose_changed;
+
+  for (int8_t count = 0; count < MULTI_START_ITERATION; count++)
   {
-    parent_pose_value = manipulator->getWorldPose();
+    if (stop_ || std::chrono::steady_clock::now() > deadline_) return false;
+
+    lambda = pre_Ek + param;
+    weighted_jacobian = We.asDiagonal() * chain->get_jacobian();
+    sr_jacobian = (chain->get_jacobian().transpose() * weighted_jacobian) + (lambda * Matrix4d::Identity());
+    gerr = weighted_jacobian.transpose() * pose_changed;
+
+    ColPivHouseholderQR<Matrix4d> dec(sr_jacobian);
+    angle_changed = dec.solve(gerr);
+
+    *angle += angle_changed;
+    chain->forward(*angle);
+
+    pose_changed.head<3>() = target_pose_.kinematic.position - chain->get_tool_position();
+    pose_changed.tail<3>() = chain->get_tool_orientation() * math::matrixLogarithm(chain->get_tool_orientation().transpose() * target_pose_.kinematic.orientation);
+    new_Ek = pose_changed.transpose() * We.asDiagonal() * pose_changed;
+
+    if (new_Ek < 1E-12)
+    {
+      return is_in_joint_limit(*angle);
+    }
+    else if (new_Ek < pre_Ek)
+    {
+      pre_Ek = new_Ek;
+    }
+    else
+    {
+      *angle -= gamma * angle_changed;
+      chain->forward(*angle);
+
+      pose_changed.head<3>() = target_pose_.kinematic.position - chain->get_tool_position();
+      pose_changed.tail<3>() = chain->get_tool_orientation() * math::matrixLogarithm(chain->get_tool_orientation().transpose() * target_pose_.kinematic.orientation);
+    }
   }
-  else
+  return false;
+}
+
+bool SolverMultiStartOMChain::is_in_joint_limit(const Matrix<double, 4, 1> &angle) const
+{
+  for (int8_t index = 0; index < 4; index++)
   {
-    parent_pose_value = manipulator->getComponentPoseFromWorld(parent_name);
+    if (angle(index) < min_limit_(index) || angle(index) > max_limit_(index)) return false;
   }
+  return true;
+}
 
-  //position
-  my_pose_value.kinematic.position = parent_pose_value.kinematic.position
-                                   + (parent_pose_value.kinematic.orientation * manipulator->getComponentRelativePositionFromParent(my_name));
-  //orientation
-  my_pose_value.kinematic.orientation = parent_pose_value.kinematic.orientation * manipulator->getComponentRelativeOrientationFromParent(my_name) * math::rodriguesRotationMatrix(manipulator->getAxis(my_name), manipulator->getJointPosition(my_name)); 
-  //linear velocity
-  my_pose_value.dynamic.linear.velocity = math::vector3(0.0, 0.0, 0.0);
-  //angular velocity
-  my_pose_value.dynamic.angular.velocity = math::vector3(0.0, 0.0, 0.0);
-  //linear acceleration
-  my_pose_value.dynamic.linear.acceleration = math::vector3(0.0, 0.0, 0.0);
-  //angular acceleration
-  my_pose_value.dynamic.angular.acceleration = math::vector3(0.0, 0.0, 0.0);
+/*****************************************************************************
+** Kinematics Solver Customized for OpenManipulator Chain
+*****************************************************************************/
+void SolverCustomizedforOMChain::setOption(const void *arg){}
 
-  manipulator->setComponentPoseFromWorld(my_name, my_pose_value);
+Eigen::MatrixXd SolverCustomizedforOMChain::jacobian(Manipulator *manipulator, Name tool_name)
+{
+  if (chain_.load(manipulator) && tool_name == chain_.get_tool_name())
+  {
+    Matrix<double, 4, 1> joint_position;
+    chain_.read_joint_position(manipulator, &joint_position);
+    chain_.forward(joint_position);
+    return chain_.get_jacobian();
+  }
 
-  for (int8_t index = 0; index < number_of_child; index++)
+  return chain_rule_jacobian(manipulator, tool_name);
+}
+
+void SolverCustomizedforOMChain::solveForwardKinematics(Manipulator *manipulator)
+{
+  if (chain_.load(manipulator))
   {
-    Name child_name = manipulator->getComponentChildName(my_name).at(index);
-    forward_solver_using_chain_rule(manipulator, child_name);
+    Matrix<double, 4, 1> joint_position;
+    chain_.read_joint_position(manipulator, &joint_position);
+    chain_.forward(joint_position);
+    chain_.write_back(manipulator);
+    return;
   }
+  forward_solver_using_chain_rule(manipulator, manipulator->getWorldChildName());
+}
+
+bool SolverCustomizedforOMChain::solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+{
+  if (chain_.load(manipulator) && tool_name == chain_.get_tool_name())
+    return chain_custom_inverse_kinematics_using_kernel(manipulator, tool_name, target_pose, goal_joint_value);
+  return chain_custom_inverse_kinematics(manipulator, tool_name, target_pose, goal_joint_value);
+}
+
+void SolverCustomizedforOMChain::set_reachability_map(const reachability::ReachabilityMap *reachability_map)
+{
+  reachability_map_ = reachability_map;
+}
+
+//private
+void SolverCustomizedforOMChain::forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name)
+{
+  chain_rule_forward(manipulator, component_name);
 }
 bool SolverCustomizedforOMChain::chain_custom_inverse_kinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
 {
@@ -986,6 +1218,325 @@ bool SolverCustomizedforOMChain::chain_custom_inverse_kinematics(Manipulator *ma
   return false;
 }
 
+bool SolverCustomizedforOMChain::chain_custom_inverse_kinematics_using_kernel(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+{
+  //solver parameter
+  double lambda = 0.0;
+  const double param = 0.002;
+  const int8_t iteration = 10;
+
+  const double gamma = 0.5;             //rollback delta
+
+  //sr sovler parameter
+  double wn_pos = 1 / 0.3;
+  double wn_ang = 1 / (2 * M_PI);
+  double pre_Ek = 0.0;
+  double new_Ek = 0.0;
+
+  Matrix<double, 6, 1> We;
+  We << wn_pos, wn_pos, wn_pos, wn_ang, wn_ang, wn_ang;
+
+  //jacobian
+  Matrix<double, 6, 4> weighted_jacobian;
+  Matrix4d sr_jacobian;
+
+  //delta parameter
+  Matrix<double, 6, 1> pose_changed;
+  Matrix<double, 4, 1> angle_changed;    //delta angle (dq)
+  Matrix<double, 4, 1> gerr;
+
+  //angle parameter
+  Matrix<double, 4, 1> angle;            //angle (q)
+
+  ////////////////////////////solving//////////////////////////////////
+
+  chain_.read_joint_position(manipulator, &angle);
+  chain_.forward(angle);
+
+  //////////////check reachability//////////
+  if (reachability_map_ != nullptr && reachability_map_->is_loaded())
+  {
+    const reachability::Voxel *voxel = reachability_map_->find(target_pose.kinematic.position);
+    if (voxel == nullptr || voxel->flag == 0)
+    {
+      log::error("[OpenManipulator Chain Custom]target is out of the reachable workspace");
+      *goal_joint_value = {};
+      return false;
+    }
+
+    // Start from the seed of the target voxel unless the present pose is already close
+    if ((target_pose.kinematic.position - chain_.get_tool_position()).norm() > 2.0 * reachability_map_->get_header().resolution)
+    {
+      for (int8_t index = 0; index < 4; index++) angle(index) = voxel->seed[index];
+      chain_.forward(angle);
+    }
+  }
+  ///////////////////////////////////////
+
+  //////////////make target ori//////////  //only OpenManipulator Chain
+  Eigen::Vector3d present_orientation_rpy = math::convertRotationMatrixToRPYVector(chain_.get_tool_orientation());
+  Eigen::Vector3d target_orientation_rpy = math::convertRotationMatrixToRPYVector(target_pose.kinematic.orientation);
+
+  Eigen::Vector3d target_position_from_joint1 = target_pose.kinematic.position - chain_.get_relative_position(0);
+
+  target_orientation_rpy(0) = present_orientation_rpy(0);
+  target_orientation_rpy(2) = atan2(target_position_from_joint1(1) ,target_position_from_joint1(0));
+
+  Eigen::Matrix3d target_orientation = math::convertRPYToRotationMatrix(target_orientation_rpy(0), target_orientation_rpy(1), target_orientation_rpy(2));
+  ///////////////////////////////////////
+
+  //////////////checking dx///////////////
+  pose_changed.head<3>() = target_pose.kinematic.position - chain_.get_tool_position();
+  pose_changed.tail<3>() = chain_.get_tool_orientation() * math::matrixLogarithm(chain_.get_tool_orientation().transpose() * target_orientation);
+  pre_Ek = pose_changed.transpose() * We.asDiagonal() * pose_changed;
+  ///////////////////////////////////////
+
+  //////////////////////////solving loop///////////////////////////////
+  for (int8_t count = 0; count < iteration; count++)
+  {
+    //////////solve using jacobian//////////
+    lambda = pre_Ek + param;
+
+    weighted_jacobian = We.asDiagonal() * chain_.get_jacobian();
+    sr_jacobian = (chain_.get_jacobian().transpose() * weighted_jacobian) + (lambda * Matrix4d::Identity());  //calculate sr_jacobian (J^T*we*J + lamda*Wn)
+    gerr = weighted_jacobian.transpose() * pose_changed;                                                       //calculate gerr (J^T*we) dx
+
+    ColPivHouseholderQR<Matrix4d> dec(sr_jacobian);                           //solving (get dq)
+    angle_changed = dec.solve(gerr);                                          //(J^T*we) * dx = (J^T*we*J + lamda*Wn) * dq
+
+    angle += angle_changed;
+    chain_.forward(angle);
+    ////////////////////////////////////////
+
+    //////////////checking dx///////////////
+    pose_changed.head<3>() = target_pose.kinematic.position - chain_.get_tool_position();
+    pose_changed.tail<3>() = chain_.get_tool_orientation() * math::matrixLogarithm(chain_.get_tool_orientation().transpose() * target_orientation);
+    new_Ek = pose_changed.transpose() * We.asDiagonal() * pose_changed;
+    ////////////////////////////////////////
+
+    if (new_Ek < 1E-12)
+    {
+      goal_joint_value->resize(4);
+      for(int8_t index = 0; index < 4; index++)
+      {
+        goal_joint_value->at(index).position = angle(index);
+        goal_joint_value->at(index).velocity = 0.0;
+        goal_joint_value->at(index).acceleration = 0.0;
+        goal_joint_value->at(index).effort = 0.0;
+      }
+      return true;
+    }
+    else if (new_Ek < pre_Ek)
+    {
+      pre_Ek = new_Ek;
+    }
+    else
+    {
+      angle -= gamma * angle_changed;
+      chain_.forward(angle);
+
+      pose_changed.head<3>() = target_pose.kinematic.position - chain_.get_tool_position();
+      pose_changed.tail<3>() = chain_.get_tool_orientation() * math::matrixLogarithm(chain_.get_tool_orientation().transpose() * target_orientation);
+    }
+  }
+  log::error("[OpenManipulator Chain Custom]fail to solve inverse kinematics");
+  *goal_joint_value = {};
+  return false;
+}
+
+/*****************************************************************************
+** Kinematics Solver Using Closed-Form Geometry for OpenManipulator Chain
+*****************************************************************************/
+void SolverAnalyticOMChain::setOption(const void *arg){}
+
+Eigen::MatrixXd SolverAnalyticOMChain::jacobian(Manipulator *manipulator, Name tool_name)
+{
+  if (chain_.load(manipulator) && tool_name == chain_.get_tool_name())
+  {
+    Matrix<double, 4, 1> joint_position;
+    chain_.read_joint_position(manipulator, &joint_position);
+    chain_.forward(joint_position);
+    return chain_.get_jacobian();
+  }
+
+  return chain_rule_jacobian(manipulator, tool_name);
+}
+
+void SolverAnalyticOMChain::solveForwardKinematics(Manipulator *manipulator)
+{
+  if (chain_.load(manipulator))
+  {
+    Matrix<double, 4, 1> joint_position;
+    chain_.read_joint_position(manipulator, &joint_position);
+    chain_.forward(joint_position);
+    chain_.write_back(manipulator);
+    return;
+  }
+  forward_solver_using_chain_rule(manipulator, manipulator->getWorldChildName());
+}
+
+bool SolverAnalyticOMChain::solveInverseKinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+{
+  return chain_analytic_inverse_kinematics(manipulator, tool_name, target_pose, goal_joint_value);
+}
+
+bool SolverAnalyticOMChain::solve_all_inverse_kinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<std::vector<JointValue>> *solutions)
+{
+  solutions->clear();
+
+  //////////////chain geometry//////////  //only OpenManipulator Chain (yaw joint + three pitch joints)
+  if (!chain_.load(manipulator) || tool_name != chain_.get_tool_name()) return false;
+
+  const Eigen::Vector3d &joint1_position  = chain_.get_relative_position(0);
+  const Eigen::Vector3d &joint2_position  = chain_.get_relative_position(1);
+  const Eigen::Vector3d &upper_arm        = chain_.get_relative_position(2);
+  const Eigen::Vector3d &forearm          = chain_.get_relative_position(3);
+  const Eigen::Vector3d &tool_offset      = chain_.get_relative_position(4);
+
+  // Link length and resting angle of each link in the arm plane (x: reach, z: height)
+  double upper_arm_length   = sqrt(upper_arm(0) * upper_arm(0) + upper_arm(2) * upper_arm(2));
+  double upper_arm_angle    = atan2(upper_arm(2), upper_arm(0));
+  double forearm_length     = sqrt(forearm(0) * forearm(0) + forearm(2) * forearm(2));
+  double forearm_angle      = atan2(forearm(2), forearm(0));
+  double tool_length        = sqrt(tool_offset(0) * tool_offset(0) + tool_offset(2) * tool_offset(2));
+  double tool_angle         = atan2(tool_offset(2), tool_offset(0));
+  ///////////////////////////////////////
+
+  //////////////make target plane//////////
+  Eigen::Vector3d target_position_from_joint1 = target_pose.kinematic.position - joint1_position;
+  Eigen::Vector3d target_orientation_rpy = math::convertRotationMatrixToRPYVector(target_pose.kinematic.orientation);
+
+  double yaw   = atan2(target_position_from_joint1(1), target_position_from_joint1(0));
+  double reach = sqrt(target_position_from_joint1(0) * target_position_from_joint1(0) + target_position_from_joint1(1) * target_position_from_joint1(1));
+
+  // Facing the target, or facing away and reaching over the shoulder
+  const double base_yaw[2]   = {yaw, yaw + M_PI};
+  const double base_reach[2] = {reach, -reach};
+
+  // Sum of joint2, joint3 and joint4 keeping the target tool axis for each base yaw
+  double base_pitch[2];
+  for (int8_t base = 0; base < 2; base++)
+  {
+    if (cos(target_orientation_rpy(2) - base_yaw[base]) >= 0.0) base_pitch[base] = target_orientation_rpy(1);
+    else base_pitch[base] = M_PI - target_orientation_rpy(1);
+  }
+  ///////////////////////////////////////
+
+  for (int8_t base = 0; base < 2; base++)
+  {
+    // Wrist (joint4) position relative to joint2 in the arm plane
+    double wrist_x = base_reach[base] - tool_length * cos(tool_angle - base_pitch[base]) - joint2_position(0);
+    double wrist_z = target_position_from_joint1(2) - tool_length * sin(tool_angle - base_pitch[base]) - joint2_position(2);
+
+    //////////////solve planar two link//////////
+    double cos_elbow = (wrist_x * wrist_x + wrist_z * wrist_z - upper_arm_length * upper_arm_length - forearm_length * forearm_length)
+                     / (2.0 * upper_arm_length * forearm_length);
+
+    if (cos_elbow > 1.0 + 1E-9 || cos_elbow < -1.0 - 1E-9) continue;
+    if (cos_elbow > 1.0) cos_elbow = 1.0;
+    if (cos_elbow < -1.0) cos_elbow = -1.0;
+
+    const double elbow_branch[2] = {-acos(cos_elbow), acos(cos_elbow)};   // elbow-up, elbow-down
+    const int8_t number_of_branch = (cos_elbow == 1.0 || cos_elbow == -1.0) ? 1 : 2;
+
+    for (int8_t branch = 0; branch < number_of_branch; branch++)
+    {
+      double elbow = elbow_branch[branch];
+      double upper_arm_world_angle = atan2(wrist_z, wrist_x) - atan2(forearm_length * sin(elbow), upper_arm_length + forearm_length * cos(elbow));
+
+      double joint_angle[4];
+      joint_angle[0] = base_yaw[base];
+      joint_angle[1] = upper_arm_angle - upper_arm_world_angle;
+      joint_angle[2] = forearm_angle - upper_arm_angle - elbow;
+      joint_angle[3] = base_pitch[base] - joint_angle[1] - joint_angle[2];
+
+      bool in_limit = true;
+      std::vector<JointValue> solution(4);
+      for (int8_t index = 0; index < 4; index++)
+      {
+        // Wrapped to (-pi, pi], or a turn further when only that is inside the joint limit
+        Name joint_name = chain_.get_joint_name(index);
+        joint_angle[index] = atan2(sin(joint_angle[index]), cos(joint_angle[index]));
+        if (!manipulator->checkJointLimit(joint_name, joint_angle[index]))
+        {
+          if (manipulator->checkJointLimit(joint_name, joint_angle[index] + 2.0 * M_PI)) joint_angle[index] += 2.0 * M_PI;
+          else if (manipulator->checkJointLimit(joint_name, joint_angle[index] - 2.0 * M_PI)) joint_angle[index] -= 2.0 * M_PI;
+          else
+          {
+            in_limit = false;
+            break;
+          }
+        }
+        solution.at(index).position = joint_angle[index];
+        solution.at(index).velocity = 0.0;
+        solution.at(index).acceleration = 0.0;
+        solution.at(index).effort = 0.0;
+      }
+      if (in_limit) solutions->push_back(solution);
+    }
+    ///////////////////////////////////////
+  }
+
+  return solutions->size() != 0;
+}
+
+//private
+void SolverAnalyticOMChain::forward_solver_using_chain_rule(Manipulator *manipulator, Name component_name)
+{
+  chain_rule_forward(manipulator, component_name);
+}
+
+bool SolverAnalyticOMChain::chain_analytic_inverse_kinematics(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<JointValue> *goal_joint_value)
+{
+  std::vector<std::vector<JointValue>> solutions;
+
+  if (!solve_all_inverse_kinematics(manipulator, tool_name, target_pose, &solutions))
+  {
+    log::error("[OpenManipulator Chain Analytic]fail to solve inverse kinematics (target is out of reach or joint limit)");
+    *goal_joint_value = {};
+    return false;
+  }
+
+  //////////////select branch//////////  //closest to present joint angles
+  std::vector<double> present_angle = manipulator->getAllActiveJointPosition();
+  double min_distance = -1.0;
+  int8_t selected = 0;
+
+  for (int8_t branch = 0; branch < (int8_t)solutions.size(); branch++)
+  {
+    double distance = 0.0;
+    for (int8_t index = 0; index < manipulator->getDOF(); index++)
+    {
+      // Of the angles a turn apart, move to the one closest to the present angle
+      // when the joint limit allows it, so a branch near +-pi is not taken as far away
+      double &position = solutions.at(branch).at(index).position;
+      double diff = atan2(sin(position - present_angle.at(index)), cos(position - present_angle.at(index)));
+      if (manipulator->checkJointLimit(chain_.get_joint_name(index), present_angle.at(index) + diff))
+        position = present_angle.at(index) + diff;
+      diff = position - present_angle.at(index);
+      distance += diff * diff;
+    }
+    if (min_distance < 0.0 || distance < min_distance)
+    {
+      min_distance = distance;
+      selected = branch;
+    }
+  }
+  ///////////////////////////////////////
+
+  // Only the position and the pitch are solved: the yaw follows from the position and the
+  // roll is zero. Tell when the target orientation asks for more
+  const std::vector<JointValue> &solution = solutions.at(selected);
+  Eigen::Matrix3d reached_orientation = math::convertRPYToRotationMatrix(0.0, solution.at(1).position + solution.at(2).position + solution.at(3).position, solution.at(0).position);
+  Eigen::AngleAxisd orientation_error(reached_orientation.transpose() * target_pose.kinematic.orientation);
+  if (fabs(orientation_error.angle()) > 1E-3)
+    log::warn("[OpenManipulator Chain Analytic]target roll/yaw is not reachable, solved the position and pitch only (rad) : ", orientation_error.angle());
+
+  *goal_joint_value = solution;
+  return true;
+}
+
+
 
 
 
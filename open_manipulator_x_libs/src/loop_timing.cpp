@@ -0,0 +1,96 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "../include/open_manipulator_x_libs/loop_timing.hpp"
+
+#include <cmath>
+
+using namespace loop_timing;
+
+/*****************************************************************************
+** Stage Timer
+*****************************************************************************/
+StageTimer::StageTimer()
+: budget_(0.0)
+{
+  reset();
+}
+
+void StageTimer::set_budget(double budget)
+{
+  budget_ = budget;
+}
+
+void StageTimer::add(double duration)
+{
+  if (count_ == 0 || duration < min_) min_ = duration;
+  if (count_ == 0 || duration > max_) max_ = duration;
+  sum_ += duration;
+  count_++;
+
+  if (budget_ > 0.0 && duration > budget_) overrun_++;
+
+  // bin = 4 * log2(duration / 1 us), clamped to the histogram
+  int16_t bin = 0;
+  if (duration > 1e-6) bin = static_cast<int16_t>(std::ceil(4.0 * std::log2(duration * 1e6)));
+  if (bin < 0) bin = 0;
+  if (bin >= NUM_OF_HISTOGRAM_BIN) bin = NUM_OF_HISTOGRAM_BIN - 1;
+  histogram_[bin]++;
+}
+
+Statistics StageTimer::get_statistics() const
+{
+  Statistics statistics;
+  statistics.count = count_;
+  statistics.overrun = overrun_;
+  statistics.min = min_;
+  statistics.max = max_;
+  statistics.avg = (count_ > 0) ? sum_ / count_ : 0.0;
+  statistics.p99 = 0.0;
+
+  uint32_t rank = static_cast<uint32_t>(std::ceil(0.99 * count_));
+  uint32_t cumulative = 0;
+  for (uint8_t bin = 0; bin < NUM_OF_HISTOGRAM_BIN && count_ > 0; bin++)
+  {
+    cumulative += histogram_[bin];
+    if (cumulative >= rank)
+    {
+      statistics.p99 = get_bin_upper_edge(bin);
+      break;
+    }
+  }
+  if (statistics.p99 > max_) statistics.p99 = max_;
+
+  return statistics;
+}
+
+void StageTimer::reset()
+{
+  count_ = 0;
+  overrun_ = 0;
+  min_ = 0.0;
+  max_ = 0.0;
+  sum_ = 0.0;
+  for (uint8_t bin = 0; bin < NUM_OF_HISTOGRAM_BIN; bin++)
+    histogram_[bin] = 0;
+}
+
+double StageTimer::get_bin_upper_edge(uint8_t bin)
+{
+  return 1e-6 * std::pow(2.0, bin / 4.0);
+}
@@ -18,18 +18,61 @@
 
 #include "../include/open_manipulator_x_libs/open_manipulator_x.hpp"
 
-OpenManipulatorX::OpenManipulatorX() {}
+#include <chrono>
+#include <memory>
+
+OpenManipulatorX::OpenManipulatorX()
+: kinematics_(nullptr),
+  batch_kinematics_(nullptr),
+  position_only_kinematics_(false),
+  actuator_(nullptr),
+  simulated_actuator_(nullptr),
+  tool_(nullptr),
+  dxl_bus_(nullptr),
+  owns_dxl_bus_(false),
+  warm_start_(false),
+  baud_rate_rewrite_(false),
+  control_loop_time_(0.010),
+  previous_present_time_(0.0),
+  simulation_clock_(nullptr),
+  simulation_read_latency_(0.0),
+  simulation_write_latency_(0.0),
+  loop_timing_enabled_(false),
+  cached_move_time_(0.0),
+  time_optimal_enabled_(false),
+  collision_check_enabled_(false),
+  last_gripper_position_(0.0),
+  collision_count_(0),
+  collision_response_(COLLISION_RESPONSE_NONE),
+  collision_response_end_time_(0.0)
+{
+  last_collision_[0] = last_collision_[1] = 0;
+  for(uint8_t stage = 0; stage < LOOP_STAGE_SIZE; stage++)
+    last_stage_time_[stage] = 0.0;
+  for(uint8_t index = 0; index < CUSTOM_TRAJECTORY_SIZE; index++)
+    custom_trajectory_[index] = nullptr;
+  for(uint8_t index = 0; index < CUSTOM_JOINT_TRAJECTORY_SIZE; index++)
+    custom_joint_trajectory_[index] = nullptr;
+
+  // joint_limits.yaml has no acceleration limit, 8.0 rad/s^2 stays well inside the actuator profile
+  set_joint_limit(std::vector<double>(4, 4.8), std::vector<double>(4, 8.0));
+}
 
 OpenManipulatorX::~OpenManipulatorX()
 {
   delete kinematics_;
+  delete batch_kinematics_;
   delete actuator_;
+  delete simulated_actuator_;
   delete tool_;
   for(uint8_t index = 0; index < CUSTOM_TRAJECTORY_SIZE; index++)
     delete custom_trajectory_[index];
+  for(uint8_t index = 0; index < CUSTOM_JOINT_TRAJECTORY_SIZE; index++)
+    delete custom_joint_trajectory_[index];
+  if(owns_dxl_bus_) delete dxl_bus_;
 }
 
-void OpenManipulatorX::init_open_manipulator_x(bool sim, STRING usb_port, STRING baud_rate, float control_loop_time, std::vector<uint8_t> dxl_id)
+bool OpenManipulatorX::init_open_manipulator_x(bool sim, STRING usb_port, STRING baud_rate, float control_loop_time, std::vector<uint8_t> dxl_id, STRING kinematics_solver, STRING dxl_transfer_mode, dynamixel::DynamixelBus *shared_bus)
 {
   /*****************************************************************************
     ** Initialize Manipulator Parameter
@@ -123,17 +166,58 @@ void OpenManipulatorX::init_open_manipulator_x(bool sim, STRING usb_port, STRING
   /*****************************************************************************
   ** Initialize Kinematics 
   *****************************************************************************/
-  kinematics_ = new kinematics::SolverCustomizedforOMChain();
-//  kinematics_ = new kinematics::SolverUsingCRAndSRPositionOnlyJacobian();
+  kinematics_ = create_kinematics_solver(kinematics_solver);
   addKinematics(kinematics_);
 
+  // Separate instance so precomputed trajectories never share solver state with the control loop.
+  // Off the control loop, the batch solves run their seeds in series without workers of their own
+  batch_kinematics_ = create_kinematics_solver(kinematics_solver, 1);
+  position_only_kinematics_ = (kinematics_solver == KINEMATICS_SOLVER_POSITION_ONLY_JACOBIAN ||
+                               kinematics_solver == KINEMATICS_SOLVER_MULTI_START_POSITION_ONLY_SR_JACOBIAN);
+  control_loop_time_ = control_loop_time;
+  stage_timer_[LOOP_STAGE_TOTAL].set_budget(control_loop_time);
+  set_multi_start_ik_option(8, 0.5 * control_loop_time, false);
+  collision_checker_.load(getManipulator());
+
+  // Model for the planning outside the control loop, which never touches getManipulator()
+  planning_manipulator_ = *getManipulator();
+
   if(!sim)
   {
+    /*****************************************************************************
+    ** Initialize Dynamixel Bus
+    *****************************************************************************/
+    // Joints and gripper share one port and are read in a single SyncRead
+    if(shared_bus != nullptr)
+    {
+      // Other arms on the same chain; the owner initializes the port and sets the transfer mode
+      dxl_bus_ = shared_bus;
+      owns_dxl_bus_ = false;
+    }
+    else
+    {
+      dxl_bus_ = new dynamixel::DynamixelBus();
+      owns_dxl_bus_ = true;
+      if(dxl_bus_->initialize(usb_port, baud_rate) == false)
+      {
+        log::error("[OpenManipulatorX] Failed to open the Dynamixel port");
+        return false;
+      }
+      dxl_bus_->set_transfer_mode(dxl_transfer_mode);
+      dxl_bus_->set_retry_policy(1, 0.3 * control_loop_time);
+    }
+    // A shared port is negotiated by its owner, once for the ids of every arm on it
+    if(owns_dxl_bus_ && dxl_bus_->negotiate_baud_rate(dxl_id, baud_rate, baud_rate_rewrite_) == false)
+      return false;
+    if(warm_start_ && dxl_bus_->read_configuration(dxl_id))
+      log::println("[OpenManipulatorX] Warm start, keeping the actuator configuration that is already set");
+
     /*****************************************************************************
     ** Initialize Joint Actuator
     *****************************************************************************/
     // actuator_ = new dynamixel::JointDynamixel();
     actuator_ = new dynamixel::JointDynamixelProfileControl(control_loop_time);
+    actuator_->set_bus(dxl_bus_);
     
     // Set communication arguments
     STRING dxl_comm_arg[2] = {usb_port, baud_rate};
@@ -155,7 +239,9 @@ void OpenManipulatorX::init_open_manipulator_x(bool sim, STRING usb_port, STRING
     /*****************************************************************************
     ** Initialize Tool Actuator
     *****************************************************************************/
-    tool_ = new dynamixel::GripperDynamixel();
+    dynamixel::GripperDynamixel *gripper_dxl = new dynamixel::GripperDynamixel();
+    gripper_dxl->set_bus(dxl_bus_);
+    tool_ = gripper_dxl;
 
     uint8_t gripperDxlId = dxl_id[4];
     addToolActuator(TOOL_DYNAMIXEL, tool_, gripperDxlId, p_dxl_comm_arg);
@@ -180,6 +266,36 @@ void OpenManipulatorX::init_open_manipulator_x(bool sim, STRING usb_port, STRING
     enableAllActuator();
 
     // Receive current angles from all actuators 
+    dxl_bus_->read_all();
+    receiveAllJointActuatorValue();
+    receiveAllToolActuatorValue();
+
+    // Only for the setup, later writes always go out
+    dxl_bus_->clear_configuration();
+  }
+  else if(simulation_clock_ != nullptr)
+  {
+    /*****************************************************************************
+    ** Initialize Simulated Actuator
+    *****************************************************************************/
+    // Same ids and modes as the Dynamixels above, so the loop runs the actual robot path
+    simulated_actuator_ = new simulation::SimulatedJointDynamixel(simulation_clock_, control_loop_time, simulation_read_latency_, simulation_write_latency_);
+    std::vector<uint8_t> jointDxlId(dxl_id.begin(), dxl_id.begin() + 4);
+    addJointActuator(JOINT_DYNAMIXEL, simulated_actuator_, jointDxlId, nullptr);
+
+    STRING joint_dxl_mode_arg = "position_mode";
+    setJointActuatorMode(JOINT_DYNAMIXEL, jointDxlId, &joint_dxl_mode_arg);
+
+    tool_ = new simulation::SimulatedGripperDynamixel(simulation_clock_, simulation_read_latency_, simulation_write_latency_);
+    addToolActuator(TOOL_DYNAMIXEL, tool_, dxl_id[4], nullptr);
+
+    STRING gripper_dxl_opt_arg[2] = {"Profile_Acceleration", "20"};
+    setToolActuatorMode(TOOL_DYNAMIXEL, &gripper_dxl_opt_arg);
+    gripper_dxl_opt_arg[0] = "Profile_Velocity";
+    gripper_dxl_opt_arg[1] = "200";
+    setToolActuatorMode(TOOL_DYNAMIXEL, &gripper_dxl_opt_arg);
+
+    enableAllActuator();
     receiveAllJointActuatorValue();
     receiveAllToolActuatorValue();
   }
@@ -192,24 +308,721 @@ void OpenManipulatorX::init_open_manipulator_x(bool sim, STRING usb_port, STRING
   custom_trajectory_[2] = new custom_trajectory::Rhombus();
   custom_trajectory_[3] = new custom_trajectory::Heart();
 
+  // Pre-sample drawing paths at the control period
+  double drawing_sample_period = control_loop_time;
+  custom_trajectory_[1]->setOption(&drawing_sample_period);
+  custom_trajectory_[2]->setOption(&drawing_sample_period);
+  custom_trajectory_[3]->setOption(&drawing_sample_period);
+
   addCustomTrajectory(CUSTOM_TRAJECTORY_LINE, custom_trajectory_[0]);
   addCustomTrajectory(CUSTOM_TRAJECTORY_CIRCLE, custom_trajectory_[1]);
   addCustomTrajectory(CUSTOM_TRAJECTORY_RHOMBUS, custom_trajectory_[2]);
   addCustomTrajectory(CUSTOM_TRAJECTORY_HEART, custom_trajectory_[3]);
+
+  custom_joint_trajectory_[0] = new custom_trajectory::SampledJointPath();
+  custom_joint_trajectory_[1] = new custom_trajectory::BlendedJointPath();
+  custom_joint_trajectory_[1]->setOption(&joint_limit_);
+
+  addCustomTrajectory(CUSTOM_TRAJECTORY_SAMPLED_JOINT, custom_joint_trajectory_[0]);
+  addCustomTrajectory(CUSTOM_TRAJECTORY_BLENDED_JOINT, custom_joint_trajectory_[1]);
+  return true;
 }
 
 void OpenManipulatorX::process_open_manipulator_x(double present_time)
 {
+  std::chrono::steady_clock::time_point stage_time[LOOP_STAGE_SIZE];
+  if(loop_timing_enabled_) stage_time[LOOP_STAGE_PLANNING] = std::chrono::steady_clock::now();
+
   // Planning (ik)
   JointWaypoint goal_joint_value = getJointGoalValueFromTrajectory(present_time);
   JointWaypoint goal_tool_value  = getToolGoalValue();
+  if(collision_check_enabled_) hold_if_colliding(present_time, &goal_joint_value, goal_tool_value);
+  if(loop_timing_enabled_) stage_time[LOOP_STAGE_READ] = std::chrono::steady_clock::now();
+
+  // Feed-forward over the period that actually elapsed, bounded so a stall doesn't overshoot
+  if(previous_present_time_ > 0.0 && present_time > previous_present_time_)
+  {
+    float present_loop_time = std::min(present_time - previous_present_time_, 2.0 * control_loop_time_);
+    if(actuator_ != nullptr) actuator_->set_present_loop_time(present_loop_time);
+    if(simulated_actuator_ != nullptr) simulated_actuator_->set_present_loop_time(present_loop_time);
+  }
+  previous_present_time_ = present_time;
 
   // Control (motor)
+  bool pipelined = owns_dxl_bus_ && dxl_bus_->is_pipelined();
+  std::chrono::steady_clock::time_point goal_time;
+  if(pipelined)
+  {
+    goal_time = std::chrono::steady_clock::now();
+    dxl_bus_->wait_transfer();  // write of the last cycle and the read after it
+  }
+  else if(owns_dxl_bus_) dxl_bus_->read_all();
   receiveAllJointActuatorValue();
   receiveAllToolActuatorValue();
+  if(loop_timing_enabled_) stage_time[LOOP_STAGE_WRITE] = std::chrono::steady_clock::now();
+
+  // Goals planned for present_time reach the bus that much later when it was still busy
+  if(pipelined) actuator_->set_goal_delay(std::chrono::duration<float>(std::chrono::steady_clock::now() - goal_time).count());
   if(goal_joint_value.size() != 0) sendAllJointActuatorValue(goal_joint_value);
   if(goal_tool_value.size() != 0) sendAllToolActuatorValue(goal_tool_value);
+  // Same sizes every cycle, so the copies reuse their storage
+  if(goal_joint_value.size() != 0) last_goal_joint_value_ = goal_joint_value;
+  if(goal_tool_value.size() != 0) last_goal_tool_value_ = goal_tool_value;
+  if(pipelined) dxl_bus_->start_transfer();
+  else if(owns_dxl_bus_) dxl_bus_->write_all();
+  if(loop_timing_enabled_) stage_time[LOOP_STAGE_FK] = std::chrono::steady_clock::now();
 
   // Perception (fk)
   solveForwardKinematics();
+
+  if(loop_timing_enabled_)
+  {
+    std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
+    bool bus_stage = (dxl_bus_ == nullptr || owns_dxl_bus_);
+    for(uint8_t stage = 0; stage < LOOP_STAGE_TOTAL; stage++)
+    {
+      if(!bus_stage && (stage == LOOP_STAGE_READ || stage == LOOP_STAGE_WRITE))
+      {
+        last_stage_time_[stage] = 0.0;
+        continue;
+      }
+      std::chrono::steady_clock::time_point stage_end = (stage + 1 < LOOP_STAGE_TOTAL) ? stage_time[stage + 1] : end_time;
+      last_stage_time_[stage] = std::chrono::duration<double>(stage_end - stage_time[stage]).count();
+      stage_timer_[stage].add(last_stage_time_[stage]);
+    }
+    last_stage_time_[LOOP_STAGE_TOTAL] = std::chrono::duration<double>(end_time - stage_time[LOOP_STAGE_PLANNING]).count();
+    stage_timer_[LOOP_STAGE_TOTAL].add(last_stage_time_[LOOP_STAGE_TOTAL]);
+  }
+}
+
+void OpenManipulatorX::use_simulated_actuator(simulation::VirtualClock *clock, double read_latency, double write_latency)
+{
+  simulation_clock_ = clock;
+  simulation_read_latency_ = read_latency;
+  simulation_write_latency_ = write_latency;
+}
+
+void OpenManipulatorX::enable_warm_start(bool enable)
+{
+  warm_start_ = enable;
+}
+
+void OpenManipulatorX::enable_baud_rate_rewrite(bool enable)
+{
+  baud_rate_rewrite_ = enable;
+}
+
+void OpenManipulatorX::enable_loop_timing(bool enable)
+{
+  loop_timing_enabled_ = enable;
+}
+
+loop_timing::Statistics OpenManipulatorX::get_loop_timing(uint8_t stage) const
+{
+  if(stage >= LOOP_STAGE_SIZE) return loop_timing::StageTimer().get_statistics();
+  return stage_timer_[stage].get_statistics();
+}
+
+void OpenManipulatorX::reset_loop_timing()
+{
+  for(uint8_t stage = 0; stage < LOOP_STAGE_SIZE; stage++)
+    stage_timer_[stage].reset();
+}
+
+double OpenManipulatorX::get_last_loop_time(uint8_t stage) const
+{
+  if(stage >= LOOP_STAGE_SIZE) return 0.0;
+  return last_stage_time_[stage];
+}
+
+const JointWaypoint &OpenManipulatorX::get_last_goal_joint_value() const
+{
+  return last_goal_joint_value_;
+}
+
+const JointWaypoint &OpenManipulatorX::get_last_goal_tool_value() const
+{
+  return last_goal_tool_value_;
+}
+
+bool OpenManipulatorX::get_bus_round_trip_time(double *read_time, double *write_time)
+{
+  if (dxl_bus_ == nullptr) return false;
+
+  *read_time = dxl_bus_->get_read_time();
+  *write_time = dxl_bus_->get_write_time();
+  return true;
+}
+
+bool OpenManipulatorX::enable_bus_pipeline(bool enable)
+{
+  if (dxl_bus_ == nullptr || owns_dxl_bus_ == false) return false;
+
+  if (enable) return dxl_bus_->start_pipeline();
+  dxl_bus_->wait_transfer();
+  dxl_bus_->stop_pipeline();
+  actuator_->set_goal_delay(0.0);
+  return true;
+}
+
+void OpenManipulatorX::wait_bus_transfer()
+{
+  if (dxl_bus_ != nullptr && owns_dxl_bus_ && dxl_bus_->is_pipelined()) dxl_bus_->wait_transfer();
+}
+
+bool OpenManipulatorX::set_bus_retry_policy(uint8_t max_retry, double budget)
+{
+  if (dxl_bus_ == nullptr || owns_dxl_bus_ == false) return false;
+
+  dxl_bus_->set_retry_policy(max_retry, budget);
+  return true;
+}
+
+bool OpenManipulatorX::get_actuator_error_counter(uint8_t actuator_id, dynamixel::ActuatorErrorCounter *counter) const
+{
+  if (dxl_bus_ == nullptr) return false;
+  return dxl_bus_->get_error_counter(actuator_id, counter);
+}
+
+bool OpenManipulatorX::get_bus_error_counter(dynamixel::BusErrorCounter *counter, const char **last_error) const
+{
+  if (dxl_bus_ == nullptr) return false;
+
+  *counter = dxl_bus_->get_bus_error_counter();
+  if (last_error != nullptr) *last_error = dxl_bus_->get_last_error();
+  return true;
+}
+
+/*****************************************************************************
+** Multi-Start IK Functions
+*****************************************************************************/
+bool OpenManipulatorX::set_multi_start_ik_option(uint8_t num_seeds, double deadline, bool prefer_closest)
+{
+  kinematics::SolverMultiStartOMChain *solver = dynamic_cast<kinematics::SolverMultiStartOMChain *>(kinematics_);
+  if (solver == nullptr) return false;
+
+  kinematics::MultiStartOption option;
+  option.num_seeds = num_seeds;
+  option.deadline = deadline;
+  option.prefer_closest = prefer_closest;
+  solver->setOption(&option);
+
+  solver = dynamic_cast<kinematics::SolverMultiStartOMChain *>(batch_kinematics_);
+  if (solver != nullptr) solver->setOption(&option);
+  return true;
+}
+
+robotis_manipulator::Kinematics *OpenManipulatorX::create_kinematics_solver(STRING kinematics_solver, uint8_t num_threads)
+{
+  if (kinematics_solver == KINEMATICS_SOLVER_OM_CHAIN_CUSTOM)
+    return new kinematics::SolverCustomizedforOMChain();
+  else if (kinematics_solver == KINEMATICS_SOLVER_JACOBIAN)
+    return new kinematics::SolverUsingCRAndJacobian();
+  else if (kinematics_solver == KINEMATICS_SOLVER_SR_JACOBIAN)
+    return new kinematics::SolverUsingCRAndSRJacobian();
+  else if (kinematics_solver == KINEMATICS_SOLVER_POSITION_ONLY_JACOBIAN)
+    return new kinematics::SolverUsingCRAndSRPositionOnlyJacobian();
+  else if (kinematics_solver == KINEMATICS_SOLVER_MULTI_START_SR_JACOBIAN)
+    return new kinematics::SolverMultiStartOMChain(false, num_threads);
+  else if (kinematics_solver == KINEMATICS_SOLVER_MULTI_START_POSITION_ONLY_SR_JACOBIAN)
+    return new kinematics::SolverMultiStartOMChain(true, num_threads);
+
+  if (kinematics_solver != KINEMATICS_SOLVER_OM_CHAIN_ANALYTIC)
+    log::error("Unknown kinematics solver (" + kinematics_solver + "), using " KINEMATICS_SOLVER_OM_CHAIN_ANALYTIC);
+  return new kinematics::SolverAnalyticOMChain();
+}
+
+/*****************************************************************************
+** Precomputed Trajectory Functions
+*****************************************************************************/
+bool OpenManipulatorX::solve_inverse_kinematics_batch(Name tool_name, const std::vector<Pose> &target_pose, std::vector<JointValue> seed, std::vector<JointWaypoint> *goal_joint_value)
+{
+  // Each waypoint depends on the previous solution, so the batch runs in order on a private copy
+  Manipulator manipulator = planning_manipulator_;
+  manipulator.setAllActiveJointValue(seed);
+
+  goal_joint_value->clear();
+  goal_joint_value->reserve(target_pose.size());
+
+  JointWaypoint solution;
+  for (uint32_t index = 0; index < target_pose.size(); index++)
+  {
+    if (!batch_kinematics_->solveInverseKinematics(&manipulator, tool_name, target_pose.at(index), &solution))
+    {
+      log::error("[OpenManipulatorX]unreachable waypoint in precomputed trajectory : ", (double)index, 0);
+      goal_joint_value->clear();
+      return false;
+    }
+    manipulator.setAllActiveJointValue(solution);
+    goal_joint_value->push_back(solution);
+  }
+  return true;
+}
+
+bool OpenManipulatorX::plan_precomputed_task_trajectory(Name tool_name, KinematicPose goal_pose, double move_time, const JointWaypoint &present_joint_value,
+                                                        custom_trajectory::JointSamples *samples, double *sample_move_time)
+{
+  std::lock_guard<std::mutex> lock(planning_mutex_);
+
+  Manipulator manipulator = planning_manipulator_;
+  manipulator.setAllActiveJointValue(present_joint_value);
+  batch_kinematics_->solveForwardKinematics(&manipulator);
+  KinematicPose start_pose = manipulator.getComponentKinematicPoseFromWorld(tool_name);
+
+  // Rotate about a fixed axis from start to goal orientation
+  Eigen::Vector3d rotation = math::matrixLogarithm(start_pose.orientation.transpose() * goal_pose.orientation);
+  double rotation_angle = rotation.norm();
+  Eigen::Vector3d rotation_axis = rotation_angle > 1E-9 ? Eigen::Vector3d(rotation / rotation_angle) : Eigen::Vector3d(Z_AXIS);
+
+  uint32_t sample_size = (uint32_t)ceil(move_time / control_loop_time_) + 1;
+  std::vector<Pose> target_pose(sample_size);
+
+  for (uint32_t index = 0; index < sample_size; index++)
+  {
+    // Minimum jerk ratio 10t^3 - 15t^4 + 6t^5, or only the geometry when it is retimed
+    double t = std::min(index * control_loop_time_ / move_time, 1.0);
+    double ratio = time_optimal_enabled_ ? t : t * t * t * (10.0 + t * (-15.0 + t * 6.0));
+
+    target_pose.at(index).kinematic.position = start_pose.position + ratio * (goal_pose.position - start_pose.position);
+    target_pose.at(index).kinematic.orientation = start_pose.orientation * math::rodriguesRotationMatrix(rotation_axis, ratio * rotation_angle);
+  }
+
+  return plan_sampled_joint_trajectory(tool_name, target_pose, move_time, present_joint_value, samples, sample_move_time);
+}
+
+bool OpenManipulatorX::plan_precomputed_custom_trajectory(Name trajectory_name, Name tool_name, const void *arg, double move_time, const JointWaypoint &present_joint_value,
+                                                          custom_trajectory::JointSamples *samples, double *sample_move_time)
+{
+  std::lock_guard<std::mutex> lock(planning_mutex_);
+
+  // Instances of its own, the loop may be playing the shared ones of makeCustomTrajectory
+  double drawing_sample_period = control_loop_time_;
+  std::unique_ptr<robotis_manipulator::CustomTaskTrajectory> task_trajectory;
+  if (trajectory_name == CUSTOM_TRAJECTORY_LINE) task_trajectory.reset(new custom_trajectory::Line());
+  else if (trajectory_name == CUSTOM_TRAJECTORY_CIRCLE) task_trajectory.reset(new custom_trajectory::Circle());
+  else if (trajectory_name == CUSTOM_TRAJECTORY_RHOMBUS) task_trajectory.reset(new custom_trajectory::Rhombus());
+  else if (trajectory_name == CUSTOM_TRAJECTORY_HEART) task_trajectory.reset(new custom_trajectory::Heart());
+  else return false;
+  if (trajectory_name != CUSTOM_TRAJECTORY_LINE) task_trajectory->setOption(&drawing_sample_period);
+
+  Manipulator manipulator = planning_manipulator_;
+  manipulator.setAllActiveJointValue(present_joint_value);
+  batch_kinematics_->solveForwardKinematics(&manipulator);
+  TaskWaypoint start_pose = manipulator.getComponentPoseFromWorld(tool_name);
+  task_trajectory->makeTaskTrajectory(move_time, start_pose, arg);
+
+  uint32_t sample_size = (uint32_t)ceil(move_time / control_loop_time_) + 1;
+  std::vector<Pose> target_pose(sample_size);
+
+  for (uint32_t index = 0; index < sample_size; index++)
+    target_pose.at(index) = task_trajectory->getTaskWaypoint(std::min(index * control_loop_time_, move_time));
+
+  return plan_sampled_joint_trajectory(tool_name, target_pose, move_time, present_joint_value, samples, sample_move_time);
+}
+
+void OpenManipulatorX::make_sampled_joint_trajectory(custom_trajectory::JointSamples *samples, double move_time)
+{
+  makeCustomTrajectory(CUSTOM_TRAJECTORY_SAMPLED_JOINT, samples, move_time);
+}
+
+bool OpenManipulatorX::plan_sampled_joint_trajectory(Name tool_name, const std::vector<Pose> &target_pose, double move_time, const JointWaypoint &seed,
+                                                     custom_trajectory::JointSamples *samples, double *sample_move_time)
+{
+  // Repeated motions give the same joint path every time
+  if (is_cached_path(tool_name, target_pose, seed))
+  {
+    *samples = cached_samples_;
+    *sample_move_time = cached_move_time_;
+    return true;
+  }
+
+  samples->sample_period = control_loop_time_;
+
+  if (!solve_inverse_kinematics_batch(tool_name, target_pose, seed, &samples->waypoint))
+    return false;
+
+  if (time_optimal_enabled_)
+  {
+    // Not time_optimal_, the control loop may be parameterizing with it right now
+    custom_trajectory::TimeOptimalParameterization time_optimal;
+    time_optimal.set_joint_limit(joint_limit_.max_velocity, joint_limit_.max_acceleration);
+
+    std::vector<JointWaypoint> path = std::move(samples->waypoint);
+    if (!time_optimal.parameterize(path, control_loop_time_, samples, &move_time))
+      return false;
+  }
+  else
+  {
+    // Central differences, at rest on both ends
+    uint32_t last = samples->waypoint.size() - 1;
+    for (uint32_t index = 1; index < last; index++)
+    {
+      for (uint8_t num = 0; num < samples->waypoint.at(index).size(); num++)
+      {
+        double previous = samples->waypoint.at(index - 1).at(num).position;
+        double present  = samples->waypoint.at(index).at(num).position;
+        double next     = samples->waypoint.at(index + 1).at(num).position;
+
+        samples->waypoint.at(index).at(num).velocity = (next - previous) / (2.0 * control_loop_time_);
+        samples->waypoint.at(index).at(num).acceleration = (next - 2.0 * present + previous) / (control_loop_time_ * control_loop_time_);
+      }
+    }
+  }
+
+  cached_tool_name_ = tool_name;
+  cached_target_pose_ = target_pose;
+  cached_seed_ = seed;
+  cached_samples_ = *samples;
+  cached_move_time_ = move_time;
+
+  *sample_move_time = move_time;
+  return true;
+}
+
+bool OpenManipulatorX::is_cached_path(Name tool_name, const std::vector<Pose> &target_pose, const JointWaypoint &seed)
+{
+  const double position_tolerance = 1E-4;   // m
+  const double orientation_tolerance = 1E-3;  // rad
+  const double joint_tolerance = 2E-3;      // rad, about one encoder step
+
+  if (tool_name != cached_tool_name_) return false;
+  if (target_pose.size() != cached_target_pose_.size() || seed.size() != cached_seed_.size()) return false;
+
+  for (uint8_t index = 0; index < seed.size(); index++)
+    if (fabs(seed.at(index).position - cached_seed_.at(index).position) > joint_tolerance) return false;
+
+  for (uint32_t index = 0; index < target_pose.size(); index++)
+  {
+    if ((target_pose.at(index).kinematic.position - cached_target_pose_.at(index).kinematic.position).norm() > position_tolerance)
+      return false;
+    Eigen::AngleAxisd rotation(cached_target_pose_.at(index).kinematic.orientation.transpose() * target_pose.at(index).kinematic.orientation);
+    if (fabs(rotation.angle()) > orientation_tolerance)
+      return false;
+  }
+  return true;
+}
+
+/*****************************************************************************
+** Time-Optimal Trajectory Functions
+*****************************************************************************/
+void OpenManipulatorX::set_joint_limit(std::vector<double> max_velocity, std::vector<double> max_acceleration, std::vector<double> max_jerk)
+{
+  if (max_jerk.size() == 0)
+    for (uint8_t index = 0; index < max_acceleration.size(); index++) max_jerk.push_back(10.0 * max_acceleration.at(index));
+
+  joint_limit_.max_velocity = max_velocity;
+  joint_limit_.max_acceleration = max_acceleration;
+  joint_limit_.max_jerk = max_jerk;
+  if (custom_joint_trajectory_[1] != nullptr) custom_joint_trajectory_[1]->setOption(&joint_limit_);
+
+  time_optimal_.set_joint_limit(max_velocity, max_acceleration);
+  std::lock_guard<std::mutex> lock(planning_mutex_);
+  cached_tool_name_.clear();
+}
+
+void OpenManipulatorX::enable_time_optimal_trajectory(bool enable)
+{
+  std::lock_guard<std::mutex> lock(planning_mutex_);
+  time_optimal_enabled_ = enable;
+  cached_tool_name_.clear();
+}
+
+bool OpenManipulatorX::is_time_optimal_trajectory_enabled() const
+{
+  return time_optimal_enabled_;
+}
+
+bool OpenManipulatorX::make_time_optimal_joint_trajectory(std::vector<double> goal_joint_position, double *move_time)
+{
+  const uint32_t path_size = 100;
+
+  // The goal waypoint of the active trajectory, not the measured joints, so nothing jumps
+  JointWaypoint start = get_present_joint_waypoint();
+  if (goal_joint_position.size() != start.size())
+  {
+    log::error("[OpenManipulatorX]size of the goal does not match the joints");
+    return false;
+  }
+
+  JointWaypoint goal(start.size());
+  bool moving = false;
+  for (uint8_t num = 0; num < start.size(); num++)
+  {
+    goal.at(num).position = goal_joint_position.at(num);
+    if (fabs(start.at(num).velocity) > 1E-6 || fabs(start.at(num).acceleration) > 1E-6) moving = true;
+  }
+
+  std::vector<JointWaypoint> path(path_size, start);
+  double start_speed = 0.0;
+  if (moving)
+  {
+    // Shape of the blend to the goal, retimed. Its points are evenly spaced in the blend time,
+    // so starting at path_size - 1 points per blend time keeps the present velocity
+    custom_trajectory::BlendedJointPath blended_path;
+    blended_path.setOption(&joint_limit_);
+    double blend_time = blended_path.get_move_time(start, goal, control_loop_time_);
+    blended_path.makeJointTrajectory(blend_time, start, &goal);
+    for (uint32_t index = 0; index < path_size; index++)
+      path.at(index) = blended_path.getJointWaypoint(blend_time * index / (path_size - 1));
+    start_speed = (path_size - 1) / blend_time;
+  }
+  else
+  {
+    for (uint32_t index = 0; index < path_size; index++)
+    {
+      double ratio = (double)index / (path_size - 1);
+      for (uint8_t num = 0; num < start.size(); num++)
+        path.at(index).at(num).position = start.at(num).position + ratio * (goal_joint_position.at(num) - start.at(num).position);
+    }
+  }
+
+  custom_trajectory::JointSamples samples;
+  double time;
+  if (!time_optimal_.parameterize(path, control_loop_time_, &samples, &time, start_speed))
+    return false;
+
+  makeCustomTrajectory(CUSTOM_TRAJECTORY_SAMPLED_JOINT, &samples, time);
+  if (move_time != nullptr) *move_time = time;
+  return true;
+}
+
+/*****************************************************************************
+** Blended Trajectory Functions
+*****************************************************************************/
+bool OpenManipulatorX::make_blended_joint_trajectory(std::vector<double> goal_joint_position, double move_time)
+{
+  // The goal waypoint of the active trajectory, not the measured joints, so nothing jumps
+  JointWaypoint start = get_present_joint_waypoint();
+  if (goal_joint_position.size() != start.size())
+  {
+    log::error("[OpenManipulatorX]size of the goal does not match the joints");
+    return false;
+  }
+
+  JointWaypoint goal(start.size());
+  for (uint8_t num = 0; num < start.size(); num++)
+    goal.at(num).position = goal_joint_position.at(num);
+
+  custom_trajectory::BlendedJointPath *blended_path = (custom_trajectory::BlendedJointPath *)custom_joint_trajectory_[1];
+  makeCustomTrajectory(CUSTOM_TRAJECTORY_BLENDED_JOINT, &goal, blended_path->get_move_time(start, goal, move_time));
+  return true;
+}
+
+JointWaypoint OpenManipulatorX::get_present_joint_waypoint()
+{
+  JointWaypoint present = getTrajectory()->getPresentJointWaypoint();
+  if (present.size() != 0) return present;
+
+  present = getManipulator()->getAllActiveJointValue();
+  for (uint8_t num = 0; num < present.size(); num++)
+  {
+    present.at(num).velocity = 0.0;
+    present.at(num).acceleration = 0.0;
+  }
+  return present;
+}
+
+bool OpenManipulatorX::make_blended_task_trajectory(Name tool_name, KinematicPose goal_pose, double move_time)
+{
+  std::vector<double> goal_joint_position;
+  if (!plan_blended_task_trajectory(tool_name, goal_pose, getManipulator()->getAllActiveJointValue(), &goal_joint_position)) return false;
+  return make_blended_joint_trajectory(goal_joint_position, move_time);
+}
+
+bool OpenManipulatorX::plan_blended_task_trajectory(Name tool_name, KinematicPose goal_pose, const JointWaypoint &present_joint_value, std::vector<double> *goal_joint_position)
+{
+  Pose target_pose;
+  target_pose.kinematic = goal_pose;
+
+  std::lock_guard<std::mutex> lock(planning_mutex_);
+
+  // Seeded with the present joints like solveInverseKinematics, on a copy of the model
+  Manipulator manipulator = planning_manipulator_;
+  manipulator.setAllActiveJointValue(present_joint_value);
+
+  std::vector<JointValue> goal_joint_value;
+  if (!batch_kinematics_->solveInverseKinematics(&manipulator, tool_name, target_pose, &goal_joint_value)) return false;
+
+  goal_joint_position->clear();
+  for (uint8_t num = 0; num < goal_joint_value.size(); num++)
+    goal_joint_position->push_back(goal_joint_value.at(num).position);
+  return true;
+}
+
+/*****************************************************************************
+** Reachability Map Functions
+*****************************************************************************/
+bool OpenManipulatorX::load_reachability_map(STRING file_path)
+{
+  if (!reachability_map_.load(file_path)) return false;
+
+  kinematics::SolverCustomizedforOMChain *solver = dynamic_cast<kinematics::SolverCustomizedforOMChain *>(kinematics_);
+  if (solver != nullptr) solver->set_reachability_map(&reachability_map_);
+  solver = dynamic_cast<kinematics::SolverCustomizedforOMChain *>(batch_kinematics_);
+  if (solver != nullptr) solver->set_reachability_map(&reachability_map_);
+  return true;
+}
+
+const reachability::ReachabilityMap &OpenManipulatorX::get_reachability_map() const
+{
+  return reachability_map_;
+}
+
+bool OpenManipulatorX::is_reachable(KinematicPose target_pose, double pitch_tolerance)
+{
+  if (!reachability_map_.is_loaded()) return true;
+  if (position_only_kinematics_) return reachability_map_.is_reachable(target_pose.position);
+
+  Eigen::Vector3d rpy = math::convertRotationMatrixToRPYVector(target_pose.orientation);
+  return reachability_map_.is_reachable(target_pose.position, rpy(1), pitch_tolerance);
+}
+
+/*****************************************************************************
+** Collision Check Functions
+*****************************************************************************/
+void OpenManipulatorX::enable_collision_check(bool enable)
+{
+  collision_check_enabled_ = enable;
+  last_safe_joint_value_.clear();
+  collision_response_ = COLLISION_RESPONSE_NONE;
+}
+
+bool OpenManipulatorX::is_collision_check_enabled() const
+{
+  return collision_check_enabled_;
+}
+
+collision::CollisionChecker *OpenManipulatorX::get_collision_checker()
+{
+  return &collision_checker_;
+}
+
+bool OpenManipulatorX::is_colliding(std::vector<double> joint_position, double gripper_position)
+{
+  if (joint_position.size() != 4)
+  {
+    log::error("[OpenManipulatorX]collision check needs 4 joint positions");
+    return false;
+  }
+  return collision_checker_.is_colliding(Eigen::Map<const Eigen::Matrix<double, 4, 1>>(joint_position.data()), gripper_position);
+}
+
+uint32_t OpenManipulatorX::get_collision_count() const
+{
+  return collision_count_;
+}
+
+void OpenManipulatorX::get_last_collision(uint8_t *link, uint8_t *other) const
+{
+  *link = last_collision_[0];
+  *other = last_collision_[1];
+}
+
+//private
+bool OpenManipulatorX::hold_if_colliding(double present_time, JointWaypoint *goal_joint_value, const JointWaypoint &goal_tool_value)
+{
+  if (goal_tool_value.size() != 0) last_gripper_position_ = goal_tool_value.at(0).position;
+  if (goal_joint_value->size() != 4) return false;
+
+  Eigen::Matrix<double, 4, 1> joint_position;
+  for (uint8_t index = 0; index < 4; index++)
+    joint_position(index) = goal_joint_value->at(index).position;
+
+  if (!collision_checker_.is_colliding(joint_position, last_gripper_position_, &last_collision_[0], &last_collision_[1]))
+  {
+    last_safe_joint_value_ = *goal_joint_value;
+    if (present_time >= collision_response_end_time_) collision_response_ = COLLISION_RESPONSE_NONE;
+    return false;
+  }
+  collision_count_++;
+
+  // Nothing safe to go back to yet (e.g. enabled in a colliding pose): hold the measured joints
+  // instead of letting the setpoint through, or send nothing before they were read
+  if (last_safe_joint_value_.size() != goal_joint_value->size())
+  {
+    JointWaypoint present_joint_value = getManipulator()->getAllActiveJointValue();
+    if (present_joint_value.size() != goal_joint_value->size())
+    {
+      goal_joint_value->clear();
+      return true;
+    }
+
+    std::vector<double> hold_position;
+    for (uint8_t index = 0; index < present_joint_value.size(); index++)
+    {
+      present_joint_value.at(index).velocity = 0.0;
+      present_joint_value.at(index).acceleration = 0.0;
+      hold_position.push_back(present_joint_value.at(index).position);
+    }
+    *goal_joint_value = present_joint_value;
+
+    if (collision_response_ != COLLISION_RESPONSE_HOLD || present_time >= collision_response_end_time_)
+    {
+      getTrajectory()->setPresentJointWaypoint(present_joint_value);
+      makeJointTrajectory(hold_position, COLLISION_HOLD_TIME);
+      collision_response_ = COLLISION_RESPONSE_HOLD;
+      collision_response_end_time_ = present_time + COLLISION_HOLD_TIME;
+    }
+    return true;
+  }
+
+  // The goal of this cycle is the last safe setpoint at rest, so the velocity feed-forward
+  // doesn't push the actuators on toward the dropped one. The measured joints are left as they were read
+  JointWaypoint hold_joint_value = last_safe_joint_value_;
+  for (uint8_t index = 0; index < hold_joint_value.size(); index++)
+  {
+    hold_joint_value.at(index).velocity = 0.0;
+    hold_joint_value.at(index).acceleration = 0.0;
+  }
+  *goal_joint_value = hold_joint_value;
+
+  // One response per collision event: the stop of the present one goes on
+  if (collision_response_ == COLLISION_RESPONSE_HOLD && present_time < collision_response_end_time_) return true;
+
+  // Brake within the joint acceleration limits from the last safe setpoint, unless a brake is
+  // what collided. Every setpoint of the brake is checked before it is taken
+  if (collision_response_ == COLLISION_RESPONSE_NONE && joint_limit_.max_acceleration.size() >= last_safe_joint_value_.size())
+  {
+    double stop_time = control_loop_time_;
+    for (uint8_t index = 0; index < last_safe_joint_value_.size(); index++)
+      stop_time = std::max(stop_time, fabs(last_safe_joint_value_.at(index).velocity) / joint_limit_.max_acceleration.at(index));
+
+    JointWaypoint stop(last_safe_joint_value_.size());
+    for (uint8_t index = 0; index < last_safe_joint_value_.size(); index++)
+      stop.at(index).position = last_safe_joint_value_.at(index).position + 0.5 * last_safe_joint_value_.at(index).velocity * stop_time;
+
+    custom_trajectory::BlendedJointPath *blended_path = (custom_trajectory::BlendedJointPath *)custom_joint_trajectory_[1];
+    double move_time = blended_path->get_move_time(last_safe_joint_value_, stop, stop_time);
+    blended_path->makeJointTrajectory(move_time, last_safe_joint_value_, &stop);
+
+    bool brake_is_safe = true;
+    for (double time = control_loop_time_; brake_is_safe && time < move_time + control_loop_time_; time += control_loop_time_)
+    {
+      JointWaypoint brake = blended_path->getJointWaypoint(time);
+      for (uint8_t index = 0; index < 4; index++)
+        joint_position(index) = brake.at(index).position;
+      brake_is_safe = !collision_checker_.is_colliding(joint_position, last_gripper_position_);
+    }
+
+    if (brake_is_safe)
+    {
+      // Starts with the velocity of the last safe setpoint
+      getTrajectory()->setPresentJointWaypoint(last_safe_joint_value_);
+      makeCustomTrajectory(CUSTOM_TRAJECTORY_BLENDED_JOINT, &stop, move_time);
+      collision_response_ = COLLISION_RESPONSE_BRAKE;
+      collision_response_end_time_ = present_time + move_time;
+      return true;
+    }
+  }
+
+  // Otherwise stop at the last safe setpoint right away
+  std::vector<double> hold_position;
+  for (uint8_t index = 0; index < hold_joint_value.size(); index++)
+    hold_position.push_back(hold_joint_value.at(index).position);
+  last_safe_joint_value_ = hold_joint_value;
+  getTrajectory()->setPresentJointWaypoint(hold_joint_value);
+  makeJointTrajectory(hold_position, COLLISION_HOLD_TIME);
+  collision_response_ = COLLISION_RESPONSE_HOLD;
+  collision_response_end_time_ = present_time + COLLISION_HOLD_TIME;
+  return true;
 }
@@ -0,0 +1,328 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "../include/open_manipulator_x_libs/reachability_map.hpp"
+#include "../include/open_manipulator_x_libs/kinematics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace reachability;
+
+/*****************************************************************************
+** Reachability Map
+*****************************************************************************/
+ReachabilityMap::ReachabilityMap()
+: voxel_(nullptr),
+  mapped_(nullptr),
+  mapped_size_(0)
+{
+  header_ = {};
+}
+
+ReachabilityMap::~ReachabilityMap()
+{
+  unload();
+}
+
+bool ReachabilityMap::generate(robotis_manipulator::Manipulator *manipulator, double resolution, double angle_step)
+{
+  kinematics::OMChainKernel chain;
+  if (!chain.load(manipulator) || resolution <= 0.0 || angle_step <= 0.0)
+  {
+    log::error("[Reachability Map]only the OpenManipulator chain is supported");
+    return false;
+  }
+  unload();
+
+  //////////////planar sweep//////////  //joint1 = 0, so the tool stays in the x-z plane
+  const Eigen::Vector3d &joint1_position = chain.get_relative_position(0);
+  double reach = 0.0;
+  for (int8_t index = 1; index < 5; index++) reach += chain.get_relative_position(index).norm();
+  reach += resolution;
+
+  // Cells over (signed reach, height) relative to joint1; negative reach : over the shoulder
+  const uint32_t plane_size = (uint32_t)ceil(2.0 * reach / resolution);
+  typedef struct
+  {
+    bool reached;
+    float min_pitch, max_pitch;
+    float seed[3];
+    double seed_distance;
+  } PlaneCell;
+  std::vector<PlaneCell> plane(plane_size * plane_size);
+  for (auto &cell : plane) cell = {false, 0.0f, 0.0f, {0.0f, 0.0f, 0.0f}, -1.0};
+
+  Matrix<double, 4, 1> angle;
+  angle(0) = 0.0;
+  for (angle(1) = -M_PI; angle(1) <= M_PI; angle(1) += angle_step)
+  {
+    if (!manipulator->checkJointLimit(chain.get_joint_name(1), angle(1))) continue;
+    for (angle(2) = -M_PI; angle(2) <= M_PI; angle(2) += angle_step)
+    {
+      if (!manipulator->checkJointLimit(chain.get_joint_name(2), angle(2))) continue;
+      for (angle(3) = -M_PI; angle(3) <= M_PI; angle(3) += angle_step)
+      {
+        if (!manipulator->checkJointLimit(chain.get_joint_name(3), angle(3))) continue;
+
+        chain.forward(angle);
+        Eigen::Vector3d position = chain.get_tool_position() - joint1_position;
+        const Eigen::Matrix3d &orientation = chain.get_tool_orientation();
+        double pitch = atan2(-orientation(2, 0), sqrt(orientation(0, 0) * orientation(0, 0) + orientation(1, 0) * orientation(1, 0)));
+
+        double u = (position(0) + reach) / resolution;
+        double v = (position(2) + reach) / resolution;
+        if (u < 0.0 || v < 0.0 || u >= plane_size || v >= plane_size) continue;
+
+        PlaneCell &cell = plane[(uint32_t)u * plane_size + (uint32_t)v];
+        double du = u - floor(u) - 0.5, dv = v - floor(v) - 0.5;
+        double distance = du * du + dv * dv;
+        if (!cell.reached)
+        {
+          cell.reached = true;
+          cell.min_pitch = cell.max_pitch = pitch;
+        }
+        if (pitch < cell.min_pitch) cell.min_pitch = pitch;
+        if (pitch > cell.max_pitch) cell.max_pitch = pitch;
+        if (cell.seed_distance < 0.0 || distance < cell.seed_distance)
+        {
+          cell.seed_distance = distance;
+          for (int8_t index = 0; index < 3; index++) cell.seed[index] = angle(index + 1);
+        }
+      }
+    }
+  }
+  ///////////////////////////////////////
+
+  //////////////fold around joint1//////////
+  header_.magic = REACHABILITY_MAP_MAGIC;
+  header_.version = REACHABILITY_MAP_VERSION;
+  header_.resolution = resolution;
+  const uint32_t grid_size = (uint32_t)ceil(2.0 * reach / resolution);
+  for (int8_t axis = 0; axis < 3; axis++)
+  {
+    header_.size[axis] = grid_size;
+    header_.origin[axis] = joint1_position(axis) - reach;
+  }
+
+  generated_voxel_.assign((size_t)grid_size * grid_size * grid_size, Voxel());
+  for (auto &voxel : generated_voxel_) voxel = {0, {0, 0, 0}, 0.0f, 0.0f, {0.0f, 0.0f, 0.0f, 0.0f}};
+
+  for (uint32_t x = 0; x < grid_size; x++)
+  {
+    for (uint32_t y = 0; y < grid_size; y++)
+    {
+      double cx = header_.origin[0] + (x + 0.5) * resolution - joint1_position(0);
+      double cy = header_.origin[1] + (y + 0.5) * resolution - joint1_position(1);
+      double yaw = atan2(cy, cx);
+      double planar_reach = sqrt(cx * cx + cy * cy);
+
+      // Facing the voxel first, then reaching over the shoulder
+      const double base_yaw[2] = {yaw, atan2(sin(yaw + M_PI), cos(yaw + M_PI))};
+      const double base_reach[2] = {planar_reach, -planar_reach};
+
+      for (uint32_t z = 0; z < grid_size; z++)
+      {
+        double cz = header_.origin[2] + (z + 0.5) * resolution - joint1_position(2);
+        Voxel &voxel = generated_voxel_[((size_t)x * grid_size + y) * grid_size + z];
+
+        double v = (cz + reach) / resolution;
+        if (v < 0.0 || v >= plane_size) continue;
+
+        // Pitch range of both branches, seed of the first one that reaches the voxel
+        for (int8_t base = 0; base < 2; base++)
+        {
+          if (!manipulator->checkJointLimit(chain.get_joint_name(0), base_yaw[base])) continue;
+
+          double u = (base_reach[base] + reach) / resolution;
+          if (u < 0.0 || u >= plane_size) continue;
+
+          const PlaneCell &cell = plane[(uint32_t)u * plane_size + (uint32_t)v];
+          if (!cell.reached) continue;
+
+          if (voxel.flag & VOXEL_REACHABLE)
+          {
+            voxel.min_pitch = std::min(voxel.min_pitch, cell.min_pitch);
+            voxel.max_pitch = std::max(voxel.max_pitch, cell.max_pitch);
+            continue;
+          }
+          voxel.flag = VOXEL_REACHABLE;
+          voxel.min_pitch = cell.min_pitch;
+          voxel.max_pitch = cell.max_pitch;
+          voxel.seed[0] = base_yaw[base];
+          for (int8_t index = 0; index < 3; index++) voxel.seed[index + 1] = cell.seed[index];
+        }
+      }
+    }
+  }
+  ///////////////////////////////////////
+
+  //////////////mark neighbours//////////
+  const int64_t n = grid_size;
+  for (int64_t x = 0; x < n; x++)
+    for (int64_t y = 0; y < n; y++)
+      for (int64_t z = 0; z < n; z++)
+      {
+        Voxel &voxel = generated_voxel_[(x * n + y) * n + z];
+        if (voxel.flag & VOXEL_REACHABLE) continue;
+
+        for (int64_t i = 0; i < 27 && !(voxel.flag & VOXEL_NEAR); i++)
+        {
+          int64_t nx = x + i / 9 - 1, ny = y + (i / 3) % 3 - 1, nz = z + i % 3 - 1;
+          if (nx < 0 || ny < 0 || nz < 0 || nx >= n || ny >= n || nz >= n) continue;
+
+          const Voxel &neighbour = generated_voxel_[(nx * n + ny) * n + nz];
+          if (!(neighbour.flag & VOXEL_REACHABLE)) continue;
+
+          voxel.flag = VOXEL_NEAR;
+          voxel.min_pitch = neighbour.min_pitch;
+          voxel.max_pitch = neighbour.max_pitch;
+          for (int8_t index = 0; index < 4; index++) voxel.seed[index] = neighbour.seed[index];
+        }
+      }
+  ///////////////////////////////////////
+
+  voxel_ = generated_voxel_.data();
+  return true;
+}
+
+bool ReachabilityMap::save(STRING file_path) const
+{
+  if (!is_loaded()) return false;
+
+  FILE *file = fopen(file_path.c_str(), "wb");
+  if (file == NULL)
+  {
+    log::error("[Reachability Map]fail to open the map file to write");
+    return false;
+  }
+
+  size_t voxel_size = (size_t)header_.size[0] * header_.size[1] * header_.size[2];
+  bool result = fwrite(&header_, sizeof(MapHeader), 1, file) == 1 &&
+                fwrite(voxel_, sizeof(Voxel), voxel_size, file) == voxel_size;
+  fclose(file);
+
+  if (!result) log::error("[Reachability Map]fail to write the map file");
+  return result;
+}
+
+bool ReachabilityMap::load(STRING file_path)
+{
+  unload();
+
+  int fd = open(file_path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    log::error("[Reachability Map]fail to open the map file");
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(MapHeader))
+  {
+    close(fd);
+    log::error("[Reachability Map]the map file is too short");
+    return false;
+  }
+
+  void *mapped = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    log::error("[Reachability Map]fail to map the map file");
+    return false;
+  }
+
+  const MapHeader *header = static_cast<const MapHeader *>(mapped);
+  size_t voxel_size = (size_t)header->size[0] * header->size[1] * header->size[2];
+  if (header->magic != REACHABILITY_MAP_MAGIC || header->version != REACHABILITY_MAP_VERSION ||
+      header->resolution <= 0.0f || (size_t)file_stat.st_size != sizeof(MapHeader) + voxel_size * sizeof(Voxel))
+  {
+    munmap(mapped, file_stat.st_size);
+    log::error("[Reachability Map]the map file is not a valid map of this version");
+    return false;
+  }
+
+  mapped_ = mapped;
+  mapped_size_ = file_stat.st_size;
+  header_ = *header;
+  voxel_ = reinterpret_cast<const Voxel *>(static_cast<const uint8_t *>(mapped) + sizeof(MapHeader));
+  return true;
+}
+
+void ReachabilityMap::unload()
+{
+  if (mapped_ != nullptr) munmap(mapped_, mapped_size_);
+  mapped_ = nullptr;
+  mapped_size_ = 0;
+  generated_voxel_.clear();
+  generated_voxel_.shrink_to_fit();
+  voxel_ = nullptr;
+  header_ = {};
+}
+
+bool ReachabilityMap::is_loaded() const
+{
+  return voxel_ != nullptr;
+}
+
+const MapHeader &ReachabilityMap::get_header() const
+{
+  return header_;
+}
+
+const Voxel *ReachabilityMap::find(const Eigen::Vector3d &position) const
+{
+  size_t index;
+  if (!get_index(position, &index)) return nullptr;
+  return &voxel_[index];
+}
+
+bool ReachabilityMap::is_reachable(const Eigen::Vector3d &position) const
+{
+  const Voxel *voxel = find(position);
+  return voxel != nullptr && voxel->flag != 0;
+}
+
+bool ReachabilityMap::is_reachable(const Eigen::Vector3d &position, double pitch, double pitch_tolerance) const
+{
+  const Voxel *voxel = find(position);
+  if (voxel == nullptr || voxel->flag == 0) return false;
+  return pitch >= voxel->min_pitch - pitch_tolerance && pitch <= voxel->max_pitch + pitch_tolerance;
+}
+
+//private
+bool ReachabilityMap::get_index(const Eigen::Vector3d &position, size_t *index) const
+{
+  if (!is_loaded()) return false;
+
+  uint32_t cell[3];
+  for (int8_t axis = 0; axis < 3; axis++)
+  {
+    double value = (position(axis) - header_.origin[axis]) / header_.resolution;
+    if (value < 0.0 || value >= header_.size[axis]) return false;
+    cell[axis] = (uint32_t)value;
+  }
+  *index = ((size_t)cell[0] * header_.size[1] + cell[1]) * header_.size[2] + cell[2];
+  return true;
+}
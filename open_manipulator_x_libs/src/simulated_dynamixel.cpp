@@ -0,0 +1,403 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "../include/open_manipulator_x_libs/simulated_dynamixel.hpp"
+#include "../include/open_manipulator_x_libs/dynamixel.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace simulation;
+
+/*****************************************************************************
+** Profile Axis
+*****************************************************************************/
+ProfileAxis::ProfileAxis()
+: time_based_(false),
+  profile_velocity_(0),
+  profile_acceleration_(0),
+  time_constant_(0.0),
+  goal_position_(0.0),
+  max_velocity_(0.0),
+  max_acceleration_(0.0),
+  profile_position_(0.0),
+  profile_velocity_value_(0.0),
+  position_(0.0),
+  velocity_(0.0),
+  acceleration_(0.0)
+{}
+
+void ProfileAxis::set_time_based_profile(bool time_based)
+{
+  time_based_ = time_based;
+  update_limit();
+}
+
+void ProfileAxis::set_profile_velocity(uint32_t profile_velocity)
+{
+  profile_velocity_ = profile_velocity;
+  update_limit();
+}
+
+void ProfileAxis::set_profile_acceleration(uint32_t profile_acceleration)
+{
+  profile_acceleration_ = profile_acceleration;
+  update_limit();
+}
+
+void ProfileAxis::set_time_constant(double time_constant)
+{
+  time_constant_ = time_constant;
+}
+
+void ProfileAxis::set_present_position(double position)
+{
+  goal_position_ = profile_position_ = position_ = position;
+  profile_velocity_value_ = velocity_ = acceleration_ = 0.0;
+}
+
+void ProfileAxis::set_goal_position(double goal_position)
+{
+  goal_position_ = goal_position;
+  update_limit();
+}
+
+void ProfileAxis::step(double step_time)
+{
+  double error = goal_position_ - profile_position_;
+
+  if (max_velocity_ <= 0.0 && max_acceleration_ <= 0.0)
+  {
+    profile_position_ = goal_position_;
+    profile_velocity_value_ = 0.0;
+  }
+  else
+  {
+    // Fastest velocity after this step from which the profile can still stop on the goal,
+    // with the position integrated over the step as a trapezoid so it never passes the goal
+    double direction = (error < 0.0) ? -1.0 : 1.0;
+    double velocity = profile_velocity_value_ * direction;
+    double target_velocity = std::fabs(error) / step_time;
+    if (max_acceleration_ > 0.0)
+    {
+      double remaining = std::fabs(error) - 0.5 * velocity * step_time;
+      double velocity_step = max_acceleration_ * step_time;
+      target_velocity = (remaining > 0.0) ?
+        0.5 * (-velocity_step + std::sqrt(velocity_step * velocity_step + 8.0 * max_acceleration_ * remaining)) : 0.0;
+    }
+    if (max_velocity_ > 0.0) target_velocity = std::min(target_velocity, max_velocity_);
+
+    double velocity_change = target_velocity - velocity;
+    if (max_acceleration_ > 0.0)
+    {
+      double max_change = max_acceleration_ * step_time;
+      velocity_change = std::min(std::max(velocity_change, -max_change), max_change);
+    }
+    double next_velocity = velocity + velocity_change;
+    double distance = 0.5 * (velocity + next_velocity) * step_time;
+
+    if (distance >= std::fabs(error))
+    {
+      profile_position_ = goal_position_;
+      profile_velocity_value_ = 0.0;
+    }
+    else
+    {
+      profile_position_ += direction * distance;
+      profile_velocity_value_ = direction * next_velocity;
+    }
+  }
+
+  double previous_position = position_;
+  double previous_velocity = velocity_;
+  double ratio = (time_constant_ > 0.0) ? 1.0 - std::exp(-step_time / time_constant_) : 1.0;
+  position_ += (profile_position_ - position_) * ratio;
+  velocity_ = (position_ - previous_position) / step_time;
+  acceleration_ = (velocity_ - previous_velocity) / step_time;
+}
+
+double ProfileAxis::get_position() const
+{
+  return position_;
+}
+
+double ProfileAxis::get_velocity() const
+{
+  return velocity_;
+}
+
+double ProfileAxis::get_acceleration() const
+{
+  return acceleration_;
+}
+
+//private
+void ProfileAxis::update_limit()
+{
+  if (!time_based_)
+  {
+    max_velocity_ = profile_velocity_ * PROFILE_VELOCITY_UNIT;
+    max_acceleration_ = profile_acceleration_ * PROFILE_ACCELERATION_UNIT;
+    return;
+  }
+
+  // Time-based : Profile_Velocity is the time of the whole move and Profile_Acceleration
+  // the time to accelerate (unit: ms), replanned from the present profile at every goal
+  max_velocity_ = max_acceleration_ = 0.0;
+  if (profile_velocity_ == 0) return;
+
+  double distance = std::fabs(goal_position_ - profile_position_);
+  double move_time = profile_velocity_ * 1e-3;
+  double acceleration_time = std::min(profile_acceleration_ * 1e-3, 0.5 * move_time);
+  if (distance < 1e-9) return;
+
+  max_velocity_ = distance / (move_time - acceleration_time);
+  if (acceleration_time > 0.0) max_acceleration_ = max_velocity_ / acceleration_time;
+}
+
+/*****************************************************************************
+** Simulated Bus
+*****************************************************************************/
+SimulatedBus::SimulatedBus(VirtualClock *clock, double read_latency, double write_latency)
+: clock_(clock),
+  read_latency_(read_latency),
+  write_latency_(write_latency),
+  simulated_time_(0.0),
+  started_(false)
+{}
+
+void SimulatedBus::resize(uint8_t num_of_axis)
+{
+  axis_.resize(num_of_axis);
+}
+
+ProfileAxis *SimulatedBus::get_axis(uint8_t index)
+{
+  return &axis_.at(index);
+}
+
+void SimulatedBus::write(const std::vector<double> &goal_position)
+{
+  run_until(clock_->now());
+  pending_write_.push_back({clock_->now() + write_latency_, goal_position});
+}
+
+std::vector<robotis_manipulator::ActuatorValue> SimulatedBus::read()
+{
+  run_until(clock_->now());
+  return get_sample().value;
+}
+
+//private
+void SimulatedBus::run_until(double time)
+{
+  if (!started_)
+  {
+    simulated_time_ = time;
+    started_ = true;
+    sample_.push_back(get_sample());
+  }
+
+  while (simulated_time_ + SIMULATION_STEP_TIME <= time + 1e-9)
+  {
+    while (!pending_write_.empty() && pending_write_.front().time <= simulated_time_ + 1e-9)
+    {
+      const std::vector<double> &goal_position = pending_write_.front().goal_position;
+      for (uint8_t index = 0; index < axis_.size() && index < goal_position.size(); index++)
+        axis_.at(index).set_goal_position(goal_position.at(index));
+      pending_write_.pop_front();
+    }
+
+    for (uint8_t index = 0; index < axis_.size(); index++)
+      axis_.at(index).step(SIMULATION_STEP_TIME);
+    simulated_time_ += SIMULATION_STEP_TIME;
+
+    Sample sample;
+    sample.time = simulated_time_;
+    for (uint8_t index = 0; index < axis_.size(); index++)
+    {
+      robotis_manipulator::ActuatorValue value;
+      value.position = axis_.at(index).get_position();
+      value.velocity = axis_.at(index).get_velocity();
+      value.acceleration = axis_.at(index).get_acceleration();
+      value.effort = 0.0;
+      sample.value.push_back(value);
+    }
+    sample_.push_back(sample);
+  }
+
+  // Keep what a read of read_latency ago can still return
+  while (sample_.size() > 1 && sample_.at(1).time <= simulated_time_ - read_latency_ + 1e-9)
+    sample_.pop_front();
+}
+
+SimulatedBus::Sample SimulatedBus::get_sample() const
+{
+  if (!sample_.empty()) return sample_.front();
+
+  Sample sample;
+  sample.time = simulated_time_;
+  for (uint8_t index = 0; index < axis_.size(); index++)
+  {
+    robotis_manipulator::ActuatorValue value;
+    value.position = axis_.at(index).get_position();
+    value.velocity = value.acceleration = value.effort = 0.0;
+    sample.value.push_back(value);
+  }
+  return sample;
+}
+
+/*****************************************************************************
+** Simulated Joint Dynamixel
+*****************************************************************************/
+SimulatedJointDynamixel::SimulatedJointDynamixel(VirtualClock *clock, float control_loop_time, double read_latency, double write_latency, double time_constant)
+: bus_(clock, read_latency, write_latency),
+  time_constant_(time_constant),
+  control_loop_time_(control_loop_time),
+  present_loop_time_(control_loop_time)
+{}
+
+void SimulatedJointDynamixel::set_present_loop_time(float present_loop_time)
+{
+  present_loop_time_ = present_loop_time;
+}
+
+void SimulatedJointDynamixel::init(std::vector<uint8_t> actuator_id, const void *arg)
+{
+  id_ = actuator_id;
+  bus_.resize(actuator_id.size());
+
+  // JointDynamixelProfileControl runs the joints on a time-based profile
+  for (uint8_t index = 0; index < id_.size(); index++)
+  {
+    bus_.get_axis(index)->set_time_based_profile(true);
+    bus_.get_axis(index)->set_time_constant(time_constant_);
+  }
+}
+
+void SimulatedJointDynamixel::setMode(std::vector<uint8_t> actuator_id, const void *arg)
+{
+  STRING *get_arg_ = (STRING *)arg;
+  // current_based_position_mode leaves the profile registers as they are
+  if (get_arg_[0] == "current_based_position_mode") return;
+
+  if (get_arg_[0] == "position_mode")
+  {
+    uint32_t profile_velocity = 0;
+    uint32_t profile_acceleration = 0;
+    dynamixel::JointDynamixelProfileControl::get_time_based_profile(control_loop_time_, &profile_velocity, &profile_acceleration);
+    for (uint8_t index = 0; index < id_.size(); index++)
+    {
+      bus_.get_axis(index)->set_profile_velocity(profile_velocity);
+      bus_.get_axis(index)->set_profile_acceleration(profile_acceleration);
+    }
+    return;
+  }
+
+  for (uint8_t index = 0; index < id_.size(); index++)
+  {
+    if (get_arg_[0] == "Profile_Velocity") bus_.get_axis(index)->set_profile_velocity(std::atoi(get_arg_[1].c_str()));
+    else if (get_arg_[0] == "Profile_Acceleration") bus_.get_axis(index)->set_profile_acceleration(std::atoi(get_arg_[1].c_str()));
+  }
+}
+
+std::vector<uint8_t> SimulatedJointDynamixel::getId()
+{
+  return id_;
+}
+
+void SimulatedJointDynamixel::enable()
+{
+  enabled_state_ = true;
+}
+
+void SimulatedJointDynamixel::disable()
+{
+  enabled_state_ = false;
+}
+
+bool SimulatedJointDynamixel::sendJointActuatorValue(std::vector<uint8_t> actuator_id, std::vector<robotis_manipulator::ActuatorValue> value_vector)
+{
+  // Torque off : the goal is not taken
+  if (!enabled_state_) return true;
+
+  std::vector<double> goal_position;
+  for (uint8_t index = 0; index < value_vector.size(); index++)
+    goal_position.push_back(value_vector.at(index).position + 3 * (value_vector.at(index).velocity * present_loop_time_) / 2);
+
+  bus_.write(goal_position);
+  return true;
+}
+
+std::vector<robotis_manipulator::ActuatorValue> SimulatedJointDynamixel::receiveJointActuatorValue(std::vector<uint8_t> actuator_id)
+{
+  return bus_.read();
+}
+
+/*****************************************************************************
+** Simulated Gripper Dynamixel
+*****************************************************************************/
+SimulatedGripperDynamixel::SimulatedGripperDynamixel(VirtualClock *clock, double read_latency, double write_latency, double time_constant)
+: bus_(clock, read_latency, write_latency),
+  id_(0)
+{
+  bus_.resize(1);
+  bus_.get_axis(0)->set_time_constant(time_constant);
+}
+
+void SimulatedGripperDynamixel::init(uint8_t actuator_id, const void *arg)
+{
+  id_ = actuator_id;
+}
+
+void SimulatedGripperDynamixel::setMode(const void *arg)
+{
+  STRING *get_arg_ = (STRING *)arg;
+
+  // GripperDynamixel runs on a velocity-based profile
+  if (get_arg_[0] == "Profile_Velocity") bus_.get_axis(0)->set_profile_velocity(std::atoi(get_arg_[1].c_str()));
+  else if (get_arg_[0] == "Profile_Acceleration") bus_.get_axis(0)->set_profile_acceleration(std::atoi(get_arg_[1].c_str()));
+}
+
+uint8_t SimulatedGripperDynamixel::getId()
+{
+  return id_;
+}
+
+void SimulatedGripperDynamixel::enable()
+{
+  enabled_state_ = true;
+}
+
+void SimulatedGripperDynamixel::disable()
+{
+  enabled_state_ = false;
+}
+
+bool SimulatedGripperDynamixel::sendToolActuatorValue(robotis_manipulator::ActuatorValue value)
+{
+  if (!enabled_state_) return true;
+
+  bus_.write(std::vector<double>(1, value.position));
+  return true;
+}
+
+robotis_manipulator::ActuatorValue SimulatedGripperDynamixel::receiveToolActuatorValue()
+{
+  return bus_.read().at(0);
+}
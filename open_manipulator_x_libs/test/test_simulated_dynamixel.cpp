@@ -0,0 +1,109 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include <gtest/gtest.h>
+
+#include "open_manipulator_x_libs/dynamixel.hpp"
+#include "open_manipulator_x_libs/simulated_dynamixel.hpp"
+
+using namespace simulation;
+
+namespace
+{
+const float CONTROL_LOOP_TIME = 0.010;  // unit: s
+const double GOAL_POSITION = 1.0;       // unit: rad
+
+// Position of the time-based trapezoid the real Dynamixel runs for a move of distance from rest
+double trapezoid_position(double distance, double move_time, double acceleration_time, double time)
+{
+  double max_velocity = distance / (move_time - acceleration_time);
+  double acceleration = max_velocity / acceleration_time;
+
+  if (time <= 0.0) return 0.0;
+  if (time < acceleration_time) return 0.5 * acceleration * time * time;
+  if (time < move_time - acceleration_time) return max_velocity * (time - 0.5 * acceleration_time);
+  if (time < move_time) return distance - 0.5 * acceleration * (move_time - time) * (move_time - time);
+  return distance;
+}
+}  // namespace
+
+TEST(SimulatedJointDynamixel, TimeBasedProfileOfPositionMode)
+{
+  uint32_t profile_velocity = 0;
+  uint32_t profile_acceleration = 0;
+  dynamixel::JointDynamixelProfileControl::get_time_based_profile(CONTROL_LOOP_TIME, &profile_velocity, &profile_acceleration);
+
+  EXPECT_EQ(profile_velocity, 30u);
+  EXPECT_EQ(profile_acceleration, 10u);
+}
+
+TEST(SimulatedJointDynamixel, PositionModeMatchesTheRealProfile)
+{
+  VirtualClock clock;
+  SimulatedJointDynamixel actuator(&clock, CONTROL_LOOP_TIME, 0.0, 0.0, 0.0);
+
+  std::vector<uint8_t> id = {11, 12, 13, 14};
+  STRING mode_arg = "position_mode";
+  actuator.init(id, nullptr);
+  actuator.setMode(id, &mode_arg);
+  actuator.enable();
+
+  std::vector<robotis_manipulator::ActuatorValue> goal(id.size());
+  for (auto &value : goal)
+  {
+    value.position = GOAL_POSITION;
+    value.velocity = 0.0;
+    value.acceleration = 0.0;
+    value.effort = 0.0;
+  }
+  ASSERT_TRUE(actuator.sendJointActuatorValue(id, goal));
+
+  uint32_t profile_velocity = 0;
+  uint32_t profile_acceleration = 0;
+  dynamixel::JointDynamixelProfileControl::get_time_based_profile(CONTROL_LOOP_TIME, &profile_velocity, &profile_acceleration);
+  const double move_time = profile_velocity * 1e-3;
+  const double acceleration_time = profile_acceleration * 1e-3;
+  const double max_velocity = GOAL_POSITION / (move_time - acceleration_time);
+
+  const int num_of_cycle = 10;
+  for (int cycle = 1; cycle <= num_of_cycle; cycle++)
+  {
+    clock.advance(CONTROL_LOOP_TIME);
+    const double time = cycle * CONTROL_LOOP_TIME;
+
+    std::vector<robotis_manipulator::ActuatorValue> present = actuator.receiveJointActuatorValue(id);
+    ASSERT_EQ(present.size(), id.size());
+    for (auto &value : present)
+    {
+      EXPECT_NEAR(value.position, trapezoid_position(GOAL_POSITION, move_time, acceleration_time, time), 1e-6) << "cycle " << cycle;
+      EXPECT_LE(value.position, GOAL_POSITION + 1e-9) << "cycle " << cycle;
+
+      // Cruising between the ramps, at rest on the goal once the move time is over
+      if (time > acceleration_time + 1e-9 && time < move_time - acceleration_time - 1e-9)
+        EXPECT_NEAR(value.velocity, max_velocity, 1e-6) << "cycle " << cycle;
+      if (time > move_time + 1e-9)
+        EXPECT_NEAR(value.velocity, 0.0, 1e-9) << "cycle " << cycle;
+    }
+
+    // An unlimited profile would already sit on the goal after the first cycle
+    if (cycle == 1)
+    {
+      EXPECT_LT(present.at(0).position, GOAL_POSITION);
+    }
+  }
+}
@@ -0,0 +1,149 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef OPEN_MANIPULATOR_X_KINEMATICS_PLUGIN_HPP
+#define OPEN_MANIPULATOR_X_KINEMATICS_PLUGIN_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <moveit/kinematics_base/kinematics_base.h>
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <rclcpp/rclcpp.hpp>
+
+#include "open_manipulator_x_libs/open_manipulator_x.hpp"
+
+namespace open_manipulator_x_moveit
+{
+#define NUM_OF_ARM_JOINT 4
+#define TIP_FRAME "end_effector_link"   // link of the "gripper" tool of open_manipulator_x_libs
+#define TOOL_NAME "gripper"
+#define IK_POSITION_TOLERANCE 1E-4      // unit: m
+#define IK_ORIENTATION_TOLERANCE 1E-3   // unit: rad
+
+/*****************************************************************************
+** MoveIt Kinematics Plugin
+*****************************************************************************/
+// Closed-form IK of kinematics::SolverAnalyticOMChain for the arm group. Every
+// branch is solved at once, so a query never iterates or times out. A 6-D pose
+// the 4-DOF chain cannot take is rejected, unless position_only_ik is set; then
+// the tool pitch is searched from the pitch of the seed.
+class OpenManipulatorXKinematicsPlugin : public kinematics::KinematicsBase
+{
+ public:
+  OpenManipulatorXKinematicsPlugin();
+
+  bool initialize(
+    const rclcpp::Node::SharedPtr &node,
+    const moveit::core::RobotModel &robot_model,
+    const std::string &group_name,
+    const std::string &base_frame,
+    const std::vector<std::string> &tip_frames,
+    double search_discretization) override;
+
+  bool getPositionIK(
+    const geometry_msgs::msg::Pose &ik_pose,
+    const std::vector<double> &ik_seed_state,
+    std::vector<double> &solution,
+    moveit_msgs::msg::MoveItErrorCodes &error_code,
+    const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override;
+
+  // Every branch of ik_pose, closest to ik_seed_state first
+  bool getPositionIK(
+    const std::vector<geometry_msgs::msg::Pose> &ik_poses,
+    const std::vector<double> &ik_seed_state,
+    std::vector<std::vector<double>> &solutions,
+    kinematics::KinematicsResult &result,
+    const kinematics::KinematicsQueryOptions &options) const override;
+
+  bool searchPositionIK(
+    const geometry_msgs::msg::Pose &ik_pose,
+    const std::vector<double> &ik_seed_state,
+    double timeout,
+    std::vector<double> &solution,
+    moveit_msgs::msg::MoveItErrorCodes &error_code,
+    const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override;
+
+  bool searchPositionIK(
+    const geometry_msgs::msg::Pose &ik_pose,
+    const std::vector<double> &ik_seed_state,
+    double timeout,
+    const std::vector<double> &consistency_limits,
+    std::vector<double> &solution,
+    moveit_msgs::msg::MoveItErrorCodes &error_code,
+    const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override;
+
+  bool searchPositionIK(
+    const geometry_msgs::msg::Pose &ik_pose,
+    const std::vector<double> &ik_seed_state,
+    double timeout,
+    std::vector<double> &solution,
+    const IKCallbackFn &solution_callback,
+    moveit_msgs::msg::MoveItErrorCodes &error_code,
+    const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override;
+
+  bool searchPositionIK(
+    const geometry_msgs::msg::Pose &ik_pose,
+    const std::vector<double> &ik_seed_state,
+    double timeout,
+    const std::vector<double> &consistency_limits,
+    std::vector<double> &solution,
+    const IKCallbackFn &solution_callback,
+    moveit_msgs::msg::MoveItErrorCodes &error_code,
+    const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override;
+
+  bool getPositionFK(
+    const std::vector<std::string> &link_names,
+    const std::vector<double> &joint_angles,
+    std::vector<geometry_msgs::msg::Pose> &poses) const override;
+
+  const std::vector<std::string> &getJointNames() const override;
+  const std::vector<std::string> &getLinkNames() const override;
+
+ private:
+  /*****************************************************************************
+  ** Parameters
+  *****************************************************************************/
+  bool position_only_ik_;
+
+  /*****************************************************************************
+  ** Variables
+  *****************************************************************************/
+  rclcpp::Node::SharedPtr node_;
+  const moveit::core::JointModelGroup *joint_model_group_;
+  moveit::core::RobotStatePtr robot_state_;
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> link_names_;
+
+  // Chain model of open_manipulator_x_libs; the solver reads and writes its joint state
+  mutable std::mutex mutex_;
+  mutable OpenManipulatorX open_manipulator_x_;
+  mutable kinematics::SolverAnalyticOMChain solver_;
+
+  // Every solution of ik_pose in the joint limits, sorted by distance to ik_seed_state
+  bool solve(
+    const geometry_msgs::msg::Pose &ik_pose,
+    const std::vector<double> &ik_seed_state,
+    std::vector<std::vector<double>> *solutions) const;
+  bool solve_pose(const Pose &target_pose, std::vector<std::vector<double>> *solutions) const;
+  bool is_reached(const Pose &target_pose, const std::vector<double> &joint_angle) const;
+};
+}  // namespace open_manipulator_x_moveit
+#endif // OPEN_MANIPULATOR_X_KINEMATICS_PLUGIN_HPP
@@ -0,0 +1,100 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef OPEN_MANIPULATOR_X_PLAN_CACHE_ADAPTER_HPP
+#define OPEN_MANIPULATOR_X_PLAN_CACHE_ADAPTER_HPP
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <moveit/planning_request_adapter/planning_request_adapter.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <rclcpp/rclcpp.hpp>
+
+namespace open_manipulator_x_moveit
+{
+#define PLAN_CACHE_SIZE 32
+#define PLAN_CACHE_START_TOLERANCE 0.01   // unit: rad
+
+/*****************************************************************************
+** MoveIt Planning Request Adapter
+*****************************************************************************/
+// Returns a stored plan for a request that was planned before, instead of calling
+// the planner. A plan is reused when the group, planner and scaling match, the start
+// state is within start_tolerance of the stored one and the last waypoint satisfies
+// the goal constraints of the request. A change of the shape or pose of a collision
+// object or attached body, or of any allowed collision entry, empties the cache, and
+// a stored plan is checked against the present scene (octomap included) before it
+// is returned.
+class PlanCacheAdapter : public planning_request_adapter::PlanningRequestAdapter
+{
+ public:
+  PlanCacheAdapter();
+
+  void initialize(const rclcpp::Node::SharedPtr &node, const std::string &parameter_namespace) override;
+  std::string getDescription() const override;
+
+  bool adaptAndPlan(
+    const PlannerFn &planner,
+    const planning_scene::PlanningSceneConstPtr &planning_scene,
+    const planning_interface::MotionPlanRequest &req,
+    planning_interface::MotionPlanResponse &res,
+    std::vector<std::size_t> &added_path_index) const override;
+
+ private:
+  struct CachedPlan
+  {
+    std::string group_name;
+    std::string planner_id;
+    double max_velocity_scaling_factor;
+    double max_acceleration_scaling_factor;
+    std::vector<double> start_position;
+    robot_trajectory::RobotTrajectoryPtr trajectory;
+  };
+
+  /*****************************************************************************
+  ** Parameters
+  *****************************************************************************/
+  int cache_size_;
+  double start_tolerance_;
+
+  /*****************************************************************************
+  ** Variables
+  *****************************************************************************/
+  // Most recently used first
+  mutable std::mutex mutex_;
+  mutable std::list<CachedPlan> cache_;
+  mutable size_t scene_fingerprint_;
+  mutable size_t hit_count_;
+  mutable size_t miss_count_;
+
+  bool is_cacheable(const planning_interface::MotionPlanRequest &req) const;
+  bool is_matched(
+    const CachedPlan &plan,
+    const planning_scene::PlanningSceneConstPtr &planning_scene,
+    const planning_interface::MotionPlanRequest &req,
+    const std::vector<double> &start_position) const;
+  size_t get_scene_fingerprint(
+    const planning_scene::PlanningSceneConstPtr &planning_scene,
+    const moveit::core::RobotState &start_state) const;
+};
+}  // namespace open_manipulator_x_moveit
+#endif // OPEN_MANIPULATOR_X_PLAN_CACHE_ADAPTER_HPP
@@ -0,0 +1,98 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#ifndef OPEN_MANIPULATOR_X_WORKSPACE_CLOUD_FILTER_HPP
+#define OPEN_MANIPULATOR_X_WORKSPACE_CLOUD_FILTER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+
+namespace open_manipulator_x_moveit
+{
+/*****************************************************************************
+** Workspace Cloud Filter
+*****************************************************************************/
+// Prepares a depth camera cloud for the octomap of move_group. The cloud is moved to
+// target_frame, cropped to the workspace box the arm can reach, reduced to one point
+// per voxel_size voxel and published at no more than max_update_rate. The kept points
+// go out in the frame of the camera again, since the PointCloudOctomapUpdater takes
+// that frame as the sensor origin for ray clearing and max_range. The points on the
+// arm itself are removed afterwards by the updater (sensors_3d.yaml).
+class WorkspaceCloudFilter : public rclcpp::Node
+{
+ public:
+  WorkspaceCloudFilter();
+  virtual ~WorkspaceCloudFilter();
+
+ private:
+  /*****************************************************************************
+  ** Parameters
+  *****************************************************************************/
+  std::string target_frame_;
+  std::vector<double> workspace_min_;
+  std::vector<double> workspace_max_;
+  double voxel_size_;
+  double max_update_rate_;
+
+  /*****************************************************************************
+  ** Variables
+  *****************************************************************************/
+  struct Voxel
+  {
+    float sum[3];
+    uint32_t count;
+  };
+
+  std::shared_ptr<tf2_ros::Buffer> tf_buffer_;
+  std::shared_ptr<tf2_ros::TransformListener> tf_listener_;
+  rclcpp::Time last_update_time_;
+  bool updated_;
+
+  // Kept between clouds so the buckets are not allocated again
+  std::unordered_map<uint64_t, Voxel> voxels_;
+
+  /*****************************************************************************
+  ** Init Functions
+  *****************************************************************************/
+  void init_parameters();
+
+  /*****************************************************************************
+  ** ROS Publishers, Subscribers and Callback Functions
+  *****************************************************************************/
+  rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr workspace_points_pub_;
+  rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr points_sub_;
+
+  void points_callback(const sensor_msgs::msg::PointCloud2::SharedPtr msg);
+
+  /*****************************************************************************
+  ** Others
+  *****************************************************************************/
+  bool is_in_workspace(const Eigen::Vector3f &point) const;
+  uint64_t get_voxel_key(const Eigen::Vector3f &point) const;
+};
+}  // namespace open_manipulator_x_moveit
+#endif // OPEN_MANIPULATOR_X_WORKSPACE_CLOUD_FILTER_HPP
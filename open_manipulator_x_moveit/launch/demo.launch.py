@@ -43,6 +43,14 @@ def generate_launch_description():
         "db", default_value="False", description="Database flag"
     )
 
+    camera_arg = DeclareLaunchArgument(
+        "use_camera", default_value="False", description="Build the octomap from a depth camera"
+    )
+
+    point_cloud_topic_arg = DeclareLaunchArgument(
+        "point_cloud_topic", default_value="/camera/depth/points", description="Depth camera cloud"
+    )
+
     # planning_context
     robot_description_config = xacro.process_file(
         os.path.join(
@@ -68,8 +76,11 @@ def generate_launch_description():
     ompl_planning_pipeline_config = {
         "move_group": {
             "planning_plugin": "ompl_interface/OMPLPlanner",
-            "request_adapters": """default_planner_request_adapters/AddTimeOptimalParameterization default_planner_request_adapters/ResolveConstraintFrames default_planner_request_adapters/FixWorkspaceBounds default_planner_request_adapters/FixStartStateBounds default_planner_request_adapters/FixStartStateCollision default_planner_request_adapters/FixStartStatePathConstraints""",
+            "request_adapters": """open_manipulator_x_moveit/PlanCache default_planner_request_adapters/AddTimeOptimalParameterization default_planner_request_adapters/ResolveConstraintFrames default_planner_request_adapters/FixWorkspaceBounds default_planner_request_adapters/FixStartStateBounds default_planner_request_adapters/FixStartStateCollision default_planner_request_adapters/FixStartStatePathConstraints""",
             "start_state_max_bounds_error": 0.1,
+            # PlanCache comes first, so a hit skips the other adapters and the planner
+            "plan_cache_size": 32,
+            "plan_cache_start_tolerance": 0.01,
         }
     }
     ompl_planning_yaml = load_yaml(
@@ -93,6 +104,18 @@ def generate_launch_description():
         "trajectory_execution.allowed_start_tolerance": 0.01,
     }
 
+    # Perception: octomap of the workspace from a cropped and downsampled cloud
+    sensors_yaml = load_yaml(
+        "open_manipulator_x_moveit", "config/sensors_3d.yaml"
+    )
+    workspace_cloud_filter_parameters = {
+        "target_frame": sensors_yaml["octomap_frame"],
+        "workspace_min": [-0.42, -0.42, 0.01],
+        "workspace_max": [0.42, 0.42, 0.50],
+        "voxel_size": sensors_yaml["octomap_resolution"],
+        "max_update_rate": sensors_yaml["workspace_camera"]["max_update_rate"],
+    }
+
     planning_scene_monitor_parameters = {
         "publish_planning_scene": True,
         "publish_geometry_updates": True,
@@ -113,9 +136,19 @@ def generate_launch_description():
             trajectory_execution,
             moveit_controllers,
             planning_scene_monitor_parameters,
+            sensors_yaml,
         ],
     )
 
+    workspace_cloud_filter_node = Node(
+        package="open_manipulator_x_moveit",
+        executable="workspace_cloud_filter",
+        output="screen",
+        parameters=[workspace_cloud_filter_parameters],
+        remappings=[("points", LaunchConfiguration("point_cloud_topic"))],
+        condition=IfCondition(LaunchConfiguration("use_camera")),
+    )
+
     # RViz
     tutorial_mode = LaunchConfiguration("rviz_tutorial")
     rviz_base = os.path.join(get_package_share_directory("open_manipulator_x_moveit"), "rviz")
@@ -213,6 +246,8 @@ def generate_launch_description():
         [
             tutorial_arg,
             db_arg,
+            camera_arg,
+            point_cloud_topic_arg,
             rviz_node,
             rviz_node_tutorial,
             static_tf,
@@ -220,6 +255,7 @@ def generate_launch_description():
             run_move_group_node,
             ros2_control_node,
             mongodb_server_node,
+            workspace_cloud_filter_node,
         ]
         + load_controllers
     )
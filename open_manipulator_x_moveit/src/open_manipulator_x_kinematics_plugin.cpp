@@ -0,0 +1,347 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "open_manipulator_x_moveit/open_manipulator_x_kinematics_plugin.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <pluginlib/class_list_macros.hpp>
+
+namespace open_manipulator_x_moveit
+{
+static rclcpp::Logger logger = rclcpp::get_logger("open_manipulator_x_kinematics_plugin");
+
+OpenManipulatorXKinematicsPlugin::OpenManipulatorXKinematicsPlugin()
+: position_only_ik_(false),
+  joint_model_group_(nullptr)
+{
+}
+
+bool OpenManipulatorXKinematicsPlugin::initialize(
+  const rclcpp::Node::SharedPtr &node,
+  const moveit::core::RobotModel &robot_model,
+  const std::string &group_name,
+  const std::string &base_frame,
+  const std::vector<std::string> &tip_frames,
+  double search_discretization)
+{
+  node_ = node;
+  storeValues(robot_model, group_name, base_frame, tip_frames, search_discretization);
+  lookupParam(node_, "position_only_ik", position_only_ik_, false);
+
+  joint_model_group_ = robot_model.getJointModelGroup(group_name);
+  if (joint_model_group_ == nullptr)
+  {
+    RCLCPP_ERROR(logger, "Unknown group '%s'", group_name.c_str());
+    return false;
+  }
+  if (tip_frames.size() != 1)
+  {
+    RCLCPP_ERROR(logger, "Only one tip frame is supported");
+    return false;
+  }
+  // The libs solve for their gripper tool, which sits where the URDF puts end_effector_link
+  if (tip_frames.at(0) != TIP_FRAME)
+  {
+    RCLCPP_ERROR(logger, "Tip frame '%s' is not supported, only '%s'", tip_frames.at(0).c_str(), TIP_FRAME);
+    return false;
+  }
+
+  joint_names_ = joint_model_group_->getActiveJointModelNames();
+  if (joint_names_.size() != NUM_OF_ARM_JOINT)
+  {
+    RCLCPP_ERROR(logger, "Group '%s' needs joint1-4, got %zu active joints", group_name.c_str(), joint_names_.size());
+    return false;
+  }
+  link_names_ = tip_frames;
+
+  robot_state_.reset(new moveit::core::RobotState(robot_model_));
+  robot_state_->setToDefaultValues();
+
+  // Same chain as the controller, without actuators
+  if (open_manipulator_x_.init_open_manipulator_x(true, "", "", 0.010, {11, 12, 13, 14, 15}, KINEMATICS_SOLVER_OM_CHAIN_ANALYTIC) == false)
+  {
+    RCLCPP_ERROR(logger, "Failed to initialize the OpenManipulator-X chain");
+    return false;
+  }
+
+  RCLCPP_INFO(logger, "OpenManipulator-X kinematics for '%s' (%s), tip '%s'",
+    group_name.c_str(), position_only_ik_ ? "position only" : "full pose", tip_frames.at(0).c_str());
+  return true;
+}
+
+/*****************************************************************************
+** Inverse Kinematics
+*****************************************************************************/
+bool OpenManipulatorXKinematicsPlugin::getPositionIK(
+  const geometry_msgs::msg::Pose &ik_pose,
+  const std::vector<double> &ik_seed_state,
+  std::vector<double> &solution,
+  moveit_msgs::msg::MoveItErrorCodes &error_code,
+  const kinematics::KinematicsQueryOptions &options) const
+{
+  std::vector<double> consistency_limits;
+  return searchPositionIK(ik_pose, ik_seed_state, default_timeout_, consistency_limits, solution, IKCallbackFn(), error_code, options);
+}
+
+bool OpenManipulatorXKinematicsPlugin::getPositionIK(
+  const std::vector<geometry_msgs::msg::Pose> &ik_poses,
+  const std::vector<double> &ik_seed_state,
+  std::vector<std::vector<double>> &solutions,
+  kinematics::KinematicsResult &result,
+  const kinematics::KinematicsQueryOptions &options) const
+{
+  (void)options;
+  result.solution_percentage = 0.0;
+
+  if (ik_poses.size() != 1)
+  {
+    result.kinematic_error = ik_poses.empty() ? kinematics::KinematicErrors::EMPTY_TIP_POSES
+                                              : kinematics::KinematicErrors::MULTIPLE_TIPS_NOT_SUPPORTED;
+    return false;
+  }
+
+  if (!solve(ik_poses.at(0), ik_seed_state, &solutions))
+  {
+    result.kinematic_error = kinematics::KinematicErrors::NO_SOLUTION;
+    return false;
+  }
+
+  result.kinematic_error = kinematics::KinematicErrors::OK;
+  result.solution_percentage = 1.0;
+  return true;
+}
+
+bool OpenManipulatorXKinematicsPlugin::searchPositionIK(
+  const geometry_msgs::msg::Pose &ik_pose,
+  const std::vector<double> &ik_seed_state,
+  double timeout,
+  std::vector<double> &solution,
+  moveit_msgs::msg::MoveItErrorCodes &error_code,
+  const kinematics::KinematicsQueryOptions &options) const
+{
+  std::vector<double> consistency_limits;
+  return searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, IKCallbackFn(), error_code, options);
+}
+
+bool OpenManipulatorXKinematicsPlugin::searchPositionIK(
+  const geometry_msgs::msg::Pose &ik_pose,
+  const std::vector<double> &ik_seed_state,
+  double timeout,
+  const std::vector<double> &consistency_limits,
+  std::vector<double> &solution,
+  moveit_msgs::msg::MoveItErrorCodes &error_code,
+  const kinematics::KinematicsQueryOptions &options) const
+{
+  return searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, IKCallbackFn(), error_code, options);
+}
+
+bool OpenManipulatorXKinematicsPlugin::searchPositionIK(
+  const geometry_msgs::msg::Pose &ik_pose,
+  const std::vector<double> &ik_seed_state,
+  double timeout,
+  std::vector<double> &solution,
+  const IKCallbackFn &solution_callback,
+  moveit_msgs::msg::MoveItErrorCodes &error_code,
+  const kinematics::KinematicsQueryOptions &options) const
+{
+  std::vector<double> consistency_limits;
+  return searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, solution_callback, error_code, options);
+}
+
+bool OpenManipulatorXKinematicsPlugin::searchPositionIK(
+  const geometry_msgs::msg::Pose &ik_pose,
+  const std::vector<double> &ik_seed_state,
+  double timeout,
+  const std::vector<double> &consistency_limits,
+  std::vector<double> &solution,
+  const IKCallbackFn &solution_callback,
+  moveit_msgs::msg::MoveItErrorCodes &error_code,
+  const kinematics::KinematicsQueryOptions &options) const
+{
+  // Closed form: every branch is known after one call, so the timeout is never used
+  (void)timeout;
+  (void)options;
+
+  if (ik_seed_state.size() != NUM_OF_ARM_JOINT ||
+      (!consistency_limits.empty() && consistency_limits.size() != NUM_OF_ARM_JOINT))
+  {
+    error_code.val = moveit_msgs::msg::MoveItErrorCodes::INVALID_ROBOT_STATE;
+    return false;
+  }
+
+  std::vector<std::vector<double>> solutions;
+  if (!solve(ik_pose, ik_seed_state, &solutions))
+  {
+    error_code.val = moveit_msgs::msg::MoveItErrorCodes::NO_IK_SOLUTION;
+    return false;
+  }
+
+  for (const std::vector<double> &candidate : solutions)
+  {
+    bool consistent = true;
+    for (uint8_t index = 0; index < consistency_limits.size(); index++)
+      if (std::fabs(candidate.at(index) - ik_seed_state.at(index)) > consistency_limits.at(index)) consistent = false;
+    if (!consistent) continue;
+
+    solution = candidate;
+    if (!solution_callback)
+    {
+      error_code.val = moveit_msgs::msg::MoveItErrorCodes::SUCCESS;
+      return true;
+    }
+
+    solution_callback(ik_pose, solution, error_code);
+    if (error_code.val == moveit_msgs::msg::MoveItErrorCodes::SUCCESS) return true;
+  }
+
+  error_code.val = moveit_msgs::msg::MoveItErrorCodes::NO_IK_SOLUTION;
+  return false;
+}
+
+/*****************************************************************************
+** Forward Kinematics
+*****************************************************************************/
+bool OpenManipulatorXKinematicsPlugin::getPositionFK(
+  const std::vector<std::string> &link_names,
+  const std::vector<double> &joint_angles,
+  std::vector<geometry_msgs::msg::Pose> &poses) const
+{
+  if (joint_angles.size() != NUM_OF_ARM_JOINT) return false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  robot_state_->setJointGroupPositions(joint_model_group_, joint_angles);
+  robot_state_->updateLinkTransforms();
+
+  const Eigen::Isometry3d base_inverse = robot_state_->getGlobalLinkTransform(base_frame_).inverse();
+
+  poses.resize(link_names.size());
+  for (uint8_t index = 0; index < link_names.size(); index++)
+  {
+    const Eigen::Isometry3d link = base_inverse * robot_state_->getGlobalLinkTransform(link_names.at(index));
+    const Eigen::Quaterniond q(link.rotation());
+    poses.at(index).position.x = link.translation()(0);
+    poses.at(index).position.y = link.translation()(1);
+    poses.at(index).position.z = link.translation()(2);
+    poses.at(index).orientation.w = q.w();
+    poses.at(index).orientation.x = q.x();
+    poses.at(index).orientation.y = q.y();
+    poses.at(index).orientation.z = q.z();
+  }
+  return true;
+}
+
+const std::vector<std::string> &OpenManipulatorXKinematicsPlugin::getJointNames() const
+{
+  return joint_names_;
+}
+
+const std::vector<std::string> &OpenManipulatorXKinematicsPlugin::getLinkNames() const
+{
+  return link_names_;
+}
+
+/*****************************************************************************
+** Private
+*****************************************************************************/
+bool OpenManipulatorXKinematicsPlugin::solve(
+  const geometry_msgs::msg::Pose &ik_pose,
+  const std::vector<double> &ik_seed_state,
+  std::vector<std::vector<double>> *solutions) const
+{
+  solutions->clear();
+  if (ik_seed_state.size() != NUM_OF_ARM_JOINT) return false;
+
+  // The chain of open_manipulator_x_libs starts at the robot origin (world / link1)
+  Pose target_pose;
+  target_pose.kinematic.position = math::vector3(ik_pose.position.x, ik_pose.position.y, ik_pose.position.z);
+  Eigen::Quaterniond q(ik_pose.orientation.w, ik_pose.orientation.x, ik_pose.orientation.y, ik_pose.orientation.z);
+  target_pose.kinematic.orientation = math::convertQuaternionToRotationMatrix(q.normalized());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (!position_only_ik_)
+  {
+    solve_pose(target_pose, solutions);
+  }
+  else
+  {
+    // Any tool pitch will do: search outwards from the pitch of the seed
+    double yaw = atan2(ik_pose.position.y, ik_pose.position.x);
+    double seed_pitch = ik_seed_state.at(1) + ik_seed_state.at(2) + ik_seed_state.at(3);
+    double step = (search_discretization_ > 0.0) ? search_discretization_ : 0.01;
+
+    for (uint32_t count = 0; count * step <= M_PI && solutions->empty(); count++)
+    {
+      for (int8_t sign = 1; sign >= -1 && solutions->empty(); sign -= 2)
+      {
+        if (count == 0 && sign < 0) continue;
+        target_pose.kinematic.orientation = math::convertRPYToRotationMatrix(0.0, seed_pitch + sign * (count * step), yaw);
+        solve_pose(target_pose, solutions);
+      }
+    }
+  }
+
+  if (solutions->empty()) return false;
+
+  auto distance = [&ik_seed_state](const std::vector<double> &solution) -> double
+  {
+    double sum = 0.0;
+    for (uint8_t index = 0; index < NUM_OF_ARM_JOINT; index++)
+      sum += (solution.at(index) - ik_seed_state.at(index)) * (solution.at(index) - ik_seed_state.at(index));
+    return sum;
+  };
+  std::stable_sort(solutions->begin(), solutions->end(),
+    [&distance](const std::vector<double> &a, const std::vector<double> &b) { return distance(a) < distance(b); });
+  return true;
+}
+
+bool OpenManipulatorXKinematicsPlugin::solve_pose(const Pose &target_pose, std::vector<std::vector<double>> *solutions) const
+{
+  std::vector<std::vector<JointValue>> branches;
+  if (!solver_.solve_all_inverse_kinematics(open_manipulator_x_.getManipulator(), TOOL_NAME, target_pose, &branches))
+    return false;
+
+  // Branches are solved from the pitch and yaw of the target only; keep those that reach it
+  for (const std::vector<JointValue> &branch : branches)
+  {
+    std::vector<double> joint_angle(NUM_OF_ARM_JOINT);
+    for (uint8_t index = 0; index < NUM_OF_ARM_JOINT; index++)
+      joint_angle.at(index) = branch.at(index).position;
+    if (is_reached(target_pose, joint_angle)) solutions->push_back(joint_angle);
+  }
+  return !solutions->empty();
+}
+
+bool OpenManipulatorXKinematicsPlugin::is_reached(const Pose &target_pose, const std::vector<double> &joint_angle) const
+{
+  Manipulator *manipulator = open_manipulator_x_.getManipulator();
+  manipulator->setAllActiveJointPosition(joint_angle);
+  solver_.solveForwardKinematics(manipulator);
+
+  Pose pose = manipulator->getComponentPoseFromWorld(TOOL_NAME);
+  if ((pose.kinematic.position - target_pose.kinematic.position).norm() > IK_POSITION_TOLERANCE) return false;
+  if (position_only_ik_) return true;
+
+  Eigen::AngleAxisd error(pose.kinematic.orientation.transpose() * target_pose.kinematic.orientation);
+  return std::fabs(error.angle()) <= IK_ORIENTATION_TOLERANCE;
+}
+}  // namespace open_manipulator_x_moveit
+
+PLUGINLIB_EXPORT_CLASS(open_manipulator_x_moveit::OpenManipulatorXKinematicsPlugin, kinematics::KinematicsBase)
@@ -0,0 +1,285 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "open_manipulator_x_moveit/plan_cache_adapter.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+#include <geometric_shapes/shapes.h>
+#include <moveit/kinematic_constraints/kinematic_constraint.h>
+#include <moveit/robot_state/conversions.h>
+#include <pluginlib/class_list_macros.hpp>
+
+namespace open_manipulator_x_moveit
+{
+static rclcpp::Logger logger = rclcpp::get_logger("open_manipulator_x_plan_cache");
+
+static void combine(size_t *seed, size_t value)
+{
+  *seed ^= value + 0x9e3779b9 + (*seed << 6) + (*seed >> 2);
+}
+
+static void combine(size_t *seed, const Eigen::Isometry3d &pose)
+{
+  for (int i = 0; i < 16; i++)
+    combine(seed, std::hash<double>()(pose.matrix().data()[i]));
+}
+
+static void combine(size_t *seed, const shapes::ShapeConstPtr &shape)
+{
+  combine(seed, static_cast<size_t>(shape->type));
+  switch (shape->type)
+  {
+    case shapes::SPHERE:
+      combine(seed, std::hash<double>()(static_cast<const shapes::Sphere *>(shape.get())->radius));
+      break;
+    case shapes::CYLINDER:
+    {
+      const shapes::Cylinder *cylinder = static_cast<const shapes::Cylinder *>(shape.get());
+      combine(seed, std::hash<double>()(cylinder->radius));
+      combine(seed, std::hash<double>()(cylinder->length));
+      break;
+    }
+    case shapes::CONE:
+    {
+      const shapes::Cone *cone = static_cast<const shapes::Cone *>(shape.get());
+      combine(seed, std::hash<double>()(cone->radius));
+      combine(seed, std::hash<double>()(cone->length));
+      break;
+    }
+    case shapes::BOX:
+    {
+      const shapes::Box *box = static_cast<const shapes::Box *>(shape.get());
+      for (int i = 0; i < 3; i++)
+        combine(seed, std::hash<double>()(box->size[i]));
+      break;
+    }
+    case shapes::PLANE:
+    {
+      const shapes::Plane *plane = static_cast<const shapes::Plane *>(shape.get());
+      combine(seed, std::hash<double>()(plane->a));
+      combine(seed, std::hash<double>()(plane->b));
+      combine(seed, std::hash<double>()(plane->c));
+      combine(seed, std::hash<double>()(plane->d));
+      break;
+    }
+    case shapes::MESH:
+    {
+      const shapes::Mesh *mesh = static_cast<const shapes::Mesh *>(shape.get());
+      combine(seed, mesh->vertex_count);
+      combine(seed, mesh->triangle_count);
+      for (unsigned int i = 0; i < mesh->vertex_count * 3; i++)
+        combine(seed, std::hash<double>()(mesh->vertices[i]));
+      break;
+    }
+    default:
+      // The octree is checked on a hit by isPathValid() instead
+      break;
+  }
+}
+
+PlanCacheAdapter::PlanCacheAdapter()
+: cache_size_(PLAN_CACHE_SIZE),
+  start_tolerance_(PLAN_CACHE_START_TOLERANCE),
+  scene_fingerprint_(0),
+  hit_count_(0),
+  miss_count_(0)
+{
+}
+
+void PlanCacheAdapter::initialize(const rclcpp::Node::SharedPtr &node, const std::string &parameter_namespace)
+{
+  node->get_parameter_or(parameter_namespace + ".plan_cache_size", cache_size_, PLAN_CACHE_SIZE);
+  node->get_parameter_or(parameter_namespace + ".plan_cache_start_tolerance", start_tolerance_, PLAN_CACHE_START_TOLERANCE);
+  if (cache_size_ < 0) cache_size_ = 0;
+
+  RCLCPP_INFO(logger, "Plan cache of %d plans, start tolerance %.4f rad", cache_size_, start_tolerance_);
+}
+
+std::string PlanCacheAdapter::getDescription() const
+{
+  return "Plan Cache";
+}
+
+bool PlanCacheAdapter::adaptAndPlan(
+  const PlannerFn &planner,
+  const planning_scene::PlanningSceneConstPtr &planning_scene,
+  const planning_interface::MotionPlanRequest &req,
+  planning_interface::MotionPlanResponse &res,
+  std::vector<std::size_t> &added_path_index) const
+{
+  (void)added_path_index;
+  if (cache_size_ == 0 || is_cacheable(req) == false) return planner(planning_scene, req, res);
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  moveit::core::RobotState start_state = planning_scene->getCurrentState();
+  moveit::core::robotStateMsgToRobotState(planning_scene->getTransforms(), req.start_state, start_state);
+  const moveit::core::JointModelGroup *group = start_state.getJointModelGroup(req.group_name);
+  if (group == nullptr) return planner(planning_scene, req, res);
+
+  std::vector<double> start_position;
+  start_state.copyJointGroupPositions(group, start_position);
+  size_t fingerprint = get_scene_fingerprint(planning_scene, start_state);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fingerprint != scene_fingerprint_)
+    {
+      if (cache_.size() != 0) RCLCPP_INFO(logger, "Planning scene changed, dropped %zu cached plans", cache_.size());
+      cache_.clear();
+      scene_fingerprint_ = fingerprint;
+    }
+
+    for (auto plan = cache_.begin(); plan != cache_.end(); plan++)
+    {
+      if (is_matched(*plan, planning_scene, req, start_position) == false) continue;
+
+      // The octomap is not part of the fingerprint, so check the stored path itself
+      if (planning_scene->isPathValid(*plan->trajectory, req.group_name) == false)
+      {
+        cache_.erase(plan);
+        break;
+      }
+
+      // Start exactly where the arm is; the stored start is within start_tolerance
+      res.trajectory_ = std::make_shared<robot_trajectory::RobotTrajectory>(*plan->trajectory, true);
+      res.trajectory_->getFirstWayPointPtr()->setJointGroupPositions(group, start_position);
+      res.trajectory_->getFirstWayPointPtr()->update();
+      res.error_code_.val = moveit_msgs::msg::MoveItErrorCodes::SUCCESS;
+      res.planning_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+      cache_.splice(cache_.begin(), cache_, plan);
+      hit_count_++;
+      RCLCPP_DEBUG(logger, "Plan cache hit (%zu hits, %zu misses)", hit_count_, miss_count_);
+      return true;
+    }
+    miss_count_++;
+  }
+
+  if (planner(planning_scene, req, res) == false || res.trajectory_ == nullptr || res.trajectory_->empty())
+    return false;
+
+  CachedPlan plan;
+  plan.group_name = req.group_name;
+  plan.planner_id = req.planner_id;
+  plan.max_velocity_scaling_factor = req.max_velocity_scaling_factor;
+  plan.max_acceleration_scaling_factor = req.max_acceleration_scaling_factor;
+  plan.start_position = start_position;
+  plan.trajectory = std::make_shared<robot_trajectory::RobotTrajectory>(*res.trajectory_, true);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fingerprint != scene_fingerprint_) return true;  // The scene changed while planning
+  cache_.push_front(plan);
+  while (cache_.size() > static_cast<size_t>(cache_size_)) cache_.pop_back();
+  return true;
+}
+
+bool PlanCacheAdapter::is_cacheable(const planning_interface::MotionPlanRequest &req) const
+{
+  // Path and trajectory constraints are not part of the key
+  return req.goal_constraints.size() != 0 &&
+         req.path_constraints.joint_constraints.empty() &&
+         req.path_constraints.position_constraints.empty() &&
+         req.path_constraints.orientation_constraints.empty() &&
+         req.path_constraints.visibility_constraints.empty() &&
+         req.trajectory_constraints.constraints.empty();
+}
+
+bool PlanCacheAdapter::is_matched(
+  const CachedPlan &plan,
+  const planning_scene::PlanningSceneConstPtr &planning_scene,
+  const planning_interface::MotionPlanRequest &req,
+  const std::vector<double> &start_position) const
+{
+  if (plan.group_name != req.group_name || plan.planner_id != req.planner_id) return false;
+  if (plan.max_velocity_scaling_factor != req.max_velocity_scaling_factor) return false;
+  if (plan.max_acceleration_scaling_factor != req.max_acceleration_scaling_factor) return false;
+
+  if (plan.start_position.size() != start_position.size()) return false;
+  for (size_t i = 0; i < start_position.size(); i++)
+    if (std::fabs(plan.start_position.at(i) - start_position.at(i)) > start_tolerance_) return false;
+
+  // Any goal of the request, with its own tolerance
+  const moveit::core::RobotState &goal_state = plan.trajectory->getLastWayPoint();
+  for (const moveit_msgs::msg::Constraints &constraints : req.goal_constraints)
+  {
+    kinematic_constraints::KinematicConstraintSet goal(planning_scene->getRobotModel());
+    goal.add(constraints, planning_scene->getTransforms());
+    if (goal.decide(goal_state).satisfied) return true;
+  }
+  return false;
+}
+
+size_t PlanCacheAdapter::get_scene_fingerprint(
+  const planning_scene::PlanningSceneConstPtr &planning_scene,
+  const moveit::core::RobotState &start_state) const
+{
+  size_t fingerprint = 0;
+
+  // Collision objects, with their shapes and poses in the planning frame
+  const collision_detection::WorldConstPtr &world = planning_scene->getWorld();
+  for (const std::string &id : world->getObjectIds())
+  {
+    collision_detection::World::ObjectConstPtr object = world->getObject(id);
+    combine(&fingerprint, std::hash<std::string>()(id));
+    combine(&fingerprint, object->shapes_.size());
+    for (const shapes::ShapeConstPtr &shape : object->shapes_)
+      combine(&fingerprint, shape);
+    for (const Eigen::Isometry3d &pose : object->shape_poses_)
+      combine(&fingerprint, pose);
+  }
+
+  // Attached bodies, with their link, touch links, shapes and poses on the link
+  std::vector<const moveit::core::AttachedBody *> attached_bodies;
+  start_state.getAttachedBodies(attached_bodies);
+  for (const moveit::core::AttachedBody *body : attached_bodies)
+  {
+    combine(&fingerprint, std::hash<std::string>()(body->getName()));
+    combine(&fingerprint, std::hash<std::string>()(body->getAttachedLinkName()));
+    for (const std::string &touch_link : body->getTouchLinks())
+      combine(&fingerprint, std::hash<std::string>()(touch_link));
+    for (const shapes::ShapeConstPtr &shape : body->getShapes())
+      combine(&fingerprint, shape);
+    for (const Eigen::Isometry3d &pose : body->getFixedTransforms())
+      combine(&fingerprint, pose);
+  }
+
+  // Allowed collision matrix, every pair and every default entry
+  const collision_detection::AllowedCollisionMatrix &acm = planning_scene->getAllowedCollisionMatrix();
+  std::vector<std::string> entry_names;
+  acm.getAllEntryNames(entry_names);
+  for (size_t i = 0; i < entry_names.size(); i++)
+  {
+    collision_detection::AllowedCollision::Type type;
+    combine(&fingerprint, std::hash<std::string>()(entry_names.at(i)));
+    if (acm.getDefaultEntry(entry_names.at(i), type)) combine(&fingerprint, static_cast<size_t>(type) + 1);
+    for (size_t j = i; j < entry_names.size(); j++)
+    {
+      if (acm.getEntry(entry_names.at(i), entry_names.at(j), type) == false) continue;
+      combine(&fingerprint, (i << 16) ^ j);
+      combine(&fingerprint, static_cast<size_t>(type));
+    }
+  }
+  return fingerprint;
+}
+}  // namespace open_manipulator_x_moveit
+
+PLUGINLIB_EXPORT_CLASS(open_manipulator_x_moveit::PlanCacheAdapter, planning_request_adapter::PlanningRequestAdapter)
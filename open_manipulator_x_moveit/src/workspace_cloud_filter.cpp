@@ -0,0 +1,185 @@
+﻿/*******************************************************************************
+* Copyright 2019 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM, Ryan Shim, Yong-Ho Na */
+
+#include "open_manipulator_x_moveit/workspace_cloud_filter.hpp"
+
+#include <cmath>
+#include <functional>
+
+#include <sensor_msgs/point_cloud2_iterator.hpp>
+#include <tf2_eigen/tf2_eigen.h>
+
+using namespace std::placeholders;
+
+namespace open_manipulator_x_moveit
+{
+WorkspaceCloudFilter::WorkspaceCloudFilter()
+: Node("workspace_cloud_filter"),
+  updated_(false)
+{
+  /*****************************************************************************
+  ** Initialise parameters
+  *****************************************************************************/
+  init_parameters();
+
+  tf_buffer_ = std::make_shared<tf2_ros::Buffer>(this->get_clock());
+  tf_listener_ = std::make_shared<tf2_ros::TransformListener>(*tf_buffer_);
+  last_update_time_ = this->now();
+
+  /*****************************************************************************
+  ** Initialise ROS publishers and subscribers
+  *****************************************************************************/
+  workspace_points_pub_ = this->create_publisher<sensor_msgs::msg::PointCloud2>("workspace_points", rclcpp::SensorDataQoS());
+  points_sub_ = this->create_subscription<sensor_msgs::msg::PointCloud2>(
+    "points", rclcpp::SensorDataQoS(), std::bind(&WorkspaceCloudFilter::points_callback, this, _1));
+
+  RCLCPP_INFO(this->get_logger(), "Workspace cloud filter in %s, voxel %.3f m, up to %.1f Hz",
+    target_frame_.c_str(), voxel_size_, max_update_rate_);
+}
+
+WorkspaceCloudFilter::~WorkspaceCloudFilter()
+{
+  RCLCPP_INFO(this->get_logger(), "Workspace cloud filter terminated");
+}
+
+/*****************************************************************************
+** Init Functions
+*****************************************************************************/
+void WorkspaceCloudFilter::init_parameters()
+{
+  this->declare_parameter("target_frame");
+  this->declare_parameter("workspace_min");
+  this->declare_parameter("workspace_max");
+  this->declare_parameter("voxel_size");
+  this->declare_parameter("max_update_rate");
+
+  // The arm reaches about 0.38 m around link1; the box stops just above the table
+  this->get_parameter_or<std::string>("target_frame", target_frame_, "world");
+  this->get_parameter_or<std::vector<double>>("workspace_min", workspace_min_, {-0.42, -0.42, 0.01});
+  this->get_parameter_or<std::vector<double>>("workspace_max", workspace_max_, {0.42, 0.42, 0.50});
+  this->get_parameter_or<double>("voxel_size", voxel_size_, 0.01);
+  this->get_parameter_or<double>("max_update_rate", max_update_rate_, 5.0);
+
+  if (workspace_min_.size() != 3 || workspace_max_.size() != 3)
+  {
+    RCLCPP_WARN(this->get_logger(), "workspace_min and workspace_max need x, y and z, using the defaults");
+    workspace_min_ = {-0.42, -0.42, 0.01};
+    workspace_max_ = {0.42, 0.42, 0.50};
+  }
+  if (voxel_size_ < 0.001) voxel_size_ = 0.001;
+}
+
+/*****************************************************************************
+** Callback Functions
+*****************************************************************************/
+void WorkspaceCloudFilter::points_callback(const sensor_msgs::msg::PointCloud2::SharedPtr msg)
+{
+  // Drop the clouds that come in faster than the octomap is updated
+  rclcpp::Time now = this->now();
+  if (updated_ && max_update_rate_ > 0.0 && (now - last_update_time_).seconds() < 1.0 / max_update_rate_) return;
+
+  Eigen::Isometry3f transform;
+  try
+  {
+    transform = tf2::transformToEigen(
+      tf_buffer_->lookupTransform(target_frame_, msg->header.frame_id, rclcpp::Time(msg->header.stamp), rclcpp::Duration(0, 50000000))).cast<float>();
+  }
+  catch (const tf2::TransformException &exception)
+  {
+    RCLCPP_WARN(this->get_logger(), "No transform from %s to %s: %s",
+      msg->header.frame_id.c_str(), target_frame_.c_str(), exception.what());
+    return;
+  }
+  last_update_time_ = now;
+  updated_ = true;
+
+  // Centroid of the points in each voxel of the workspace
+  voxels_.clear();
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x(*msg, "x");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y(*msg, "y");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z(*msg, "z");
+  for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z)
+  {
+    if (!std::isfinite(*iter_x) || !std::isfinite(*iter_y) || !std::isfinite(*iter_z)) continue;
+
+    Eigen::Vector3f point = transform * Eigen::Vector3f(*iter_x, *iter_y, *iter_z);
+    if (is_in_workspace(point) == false) continue;
+
+    Voxel &voxel = voxels_[get_voxel_key(point)];
+    for (uint8_t i = 0; i < 3; i++) voxel.sum[i] += point[i];
+    voxel.count++;
+  }
+
+  // Back in the camera frame, so the octomap clears along the rays from the camera
+  sensor_msgs::msg::PointCloud2 cloud;
+  cloud.header = msg->header;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  modifier.resize(voxels_.size());
+
+  sensor_msgs::PointCloud2Iterator<float> out_x(cloud, "x");
+  sensor_msgs::PointCloud2Iterator<float> out_y(cloud, "y");
+  sensor_msgs::PointCloud2Iterator<float> out_z(cloud, "z");
+  Eigen::Isometry3f inverse_transform = transform.inverse();
+  for (const auto &voxel : voxels_)
+  {
+    Eigen::Vector3f centroid(voxel.second.sum[0], voxel.second.sum[1], voxel.second.sum[2]);
+    Eigen::Vector3f point = inverse_transform * (centroid / voxel.second.count);
+    *out_x = point[0];
+    *out_y = point[1];
+    *out_z = point[2];
+    ++out_x; ++out_y; ++out_z;
+  }
+
+  workspace_points_pub_->publish(cloud);
+}
+
+/*****************************************************************************
+** Others
+*****************************************************************************/
+bool WorkspaceCloudFilter::is_in_workspace(const Eigen::Vector3f &point) const
+{
+  for (uint8_t i = 0; i < 3; i++)
+    if (point[i] < workspace_min_.at(i) || point[i] > workspace_max_.at(i)) return false;
+  return true;
+}
+
+uint64_t WorkspaceCloudFilter::get_voxel_key(const Eigen::Vector3f &point) const
+{
+  // 21 bits for each axis, counted from the workspace corner
+  uint64_t key = 0;
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    uint64_t index = static_cast<uint64_t>((point[i] - workspace_min_.at(i)) / voxel_size_) & 0x1FFFFF;
+    key |= index << (21 * i);
+  }
+  return key;
+}
+}  // namespace open_manipulator_x_moveit
+
+/*****************************************************************************
+** Main
+*****************************************************************************/
+int main(int argc, char *argv[])
+{
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<open_manipulator_x_moveit::WorkspaceCloudFilter>());
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -19,6 +19,7 @@
 #ifndef OPEN_MANIPULATOR_X_TELEOP_JOYSTICK_HPP_
 #define OPEN_MANIPULATOR_X_TELEOP_JOYSTICK_HPP_
 
+#include <geometry_msgs/msg/pose_stamped.hpp>
 #include <rclcpp/rclcpp.hpp>
 #include <sensor_msgs/msg/joint_state.hpp>
 #include <sensor_msgs/msg/joy.hpp>
@@ -43,6 +44,37 @@ class OpenManipulatorXTeleopJoystick : public rclcpp::Node
   *****************************************************************************/
   std::vector<double> present_joint_angle_;
   std::vector<double> present_kinematic_position_;
+  geometry_msgs::msg::Pose present_kinematics_pose_;
+  bool present_kinematics_pose_received_;
+
+  // Local prediction: task space inputs move a locally integrated target pose that is
+  // streamed on kinematics_pose_setpoint once per command period
+  bool local_prediction_;
+  double command_period_;
+  double prediction_limit_;
+  double prediction_timeout_;
+  geometry_msgs::msg::Pose target_kinematics_pose_;
+  bool target_initialized_;
+  std::vector<double> pending_delta_;
+  bool delta_pending_;
+  rclcpp::Time last_input_time_;
+
+  /*****************************************************************************
+  ** Init Functions
+  *****************************************************************************/
+  void init_parameters();
+
+  /*****************************************************************************
+  ** ROS Timer and callback functions
+  *****************************************************************************/
+  rclcpp::TimerBase::SharedPtr command_timer_;
+
+  void command_callback();
+
+  /*****************************************************************************
+  ** ROS Publishers
+  *****************************************************************************/
+  rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr kinematics_pose_setpoint_pub_;
 
   /*****************************************************************************
   ** ROS Subscribers, Callback Functions and Relevant Functions
@@ -66,6 +98,8 @@ class OpenManipulatorXTeleopJoystick : public rclcpp::Node
   bool set_joint_space_path(std::vector<std::string> joint_name, std::vector<double> joint_angle, double path_time);
   bool set_task_space_path_from_present_position_only(std::vector<double> kinematics_pose, double path_time);
   bool set_tool_control(std::vector<double> joint_angle);
+  void set_task_space_delta(std::vector<double> kinematics_pose, double path_time);
+  void reset_target();
 };
 }  // namespace open_manipulator_x_teleop_joystick
 #endif  // OPEN_MANIPULATOR_X_TELEOP_JOYSTICK_HPP_
@@ -21,6 +21,7 @@
 
 #include <termios.h>
 
+#include <geometry_msgs/msg/pose_stamped.hpp>
 #include <rclcpp/rclcpp.hpp>
 #include <sensor_msgs/msg/joint_state.hpp>
 #include <sensor_msgs/msg/joy.hpp>
@@ -45,13 +46,39 @@ class OpenManipulatorXTeleopKeyboard : public rclcpp::Node
   *****************************************************************************/
   std::vector<double> present_joint_angle_;
   std::vector<double> present_kinematic_position_;
+  geometry_msgs::msg::Pose present_kinematics_pose_;
+  bool present_kinematics_pose_received_;
+
+  // Local prediction: task space keys move a locally integrated target pose that is
+  // streamed on kinematics_pose_setpoint once per command period
+  bool local_prediction_;
+  double command_period_;
+  double prediction_limit_;
+  double prediction_timeout_;
+  geometry_msgs::msg::Pose target_kinematics_pose_;
+  bool target_initialized_;
+  std::vector<double> pending_delta_;
+  bool delta_pending_;
+  rclcpp::Time last_input_time_;
+
+  /*****************************************************************************
+  ** Init Functions
+  *****************************************************************************/
+  void init_parameters();
 
   /*****************************************************************************
   ** ROS Timer and callback functions
   *****************************************************************************/
   rclcpp::TimerBase::SharedPtr update_timer_;
+  rclcpp::TimerBase::SharedPtr command_timer_;
   
   void update_callback(); 
+  void command_callback();
+
+  /*****************************************************************************
+  ** ROS Publishers
+  *****************************************************************************/
+  rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr kinematics_pose_setpoint_pub_;
 
   /*****************************************************************************
   ** ROS Subscribers, Callback Functions and Relevant Functions
@@ -74,6 +101,8 @@ class OpenManipulatorXTeleopKeyboard : public rclcpp::Node
   bool set_task_space_path_from_present_position_only(std::vector<double> kinematics_pose, double path_time);
   bool set_tool_control(std::vector<double> joint_angle);
   bool set_joint_space_path_from_present(std::vector<std::string> joint_name, std::vector<double> joint_angle, double path_time);
+  void set_task_space_delta(std::vector<double> kinematics_pose, double path_time);
+  void reset_target();
 
   /*****************************************************************************
   ** Others
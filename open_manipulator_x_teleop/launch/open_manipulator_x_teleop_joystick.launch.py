@@ -19,12 +19,20 @@
 import os
 
 from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument
 from launch.substitutions import LaunchConfiguration
 from launch_ros.actions import Node
 
 
 def generate_launch_description():
+    local_prediction = LaunchConfiguration('local_prediction')
+
     return LaunchDescription([
+        DeclareLaunchArgument(
+            'local_prediction',
+            default_value='false',
+            description='Stream a locally predicted target pose on kinematics_pose_setpoint'),
+
         Node(
             package='joy',
             node_executable='joy_node',
@@ -35,5 +43,6 @@ def generate_launch_description():
             package='open_manipulator_x_teleop',
             node_executable='open_manipulator_x_teleop_joystick',
             node_name='open_manipulator_x_teleop_joystick',
+            parameters=[{'local_prediction': local_prediction}],
             output='screen')
     ])
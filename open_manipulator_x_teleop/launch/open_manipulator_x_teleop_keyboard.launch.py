@@ -19,15 +19,24 @@
 import os
 
 from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument
 from launch.substitutions import LaunchConfiguration
 from launch_ros.actions import Node
 
 
 def generate_launch_description():
+    local_prediction = LaunchConfiguration('local_prediction')
+
     return LaunchDescription([
+        DeclareLaunchArgument(
+            'local_prediction',
+            default_value='false',
+            description='Stream a locally predicted target pose on kinematics_pose_setpoint'),
+
         Node(
             package='open_manipulator_x_teleop',
             executable='open_manipulator_x_teleop_keyboard',
             name='open_manipulator_x_teleop_keyboard',
+            parameters=[{'local_prediction': local_prediction}],
             output='screen')
     ])
@@ -30,6 +30,13 @@ OpenManipulatorXTeleopJoystick::OpenManipulatorXTeleopJoystick()
   *****************************************************************************/
   present_joint_angle_.resize(NUM_OF_JOINT);
   present_kinematic_position_.resize(3);
+  present_kinematics_pose_received_ = false;
+  target_initialized_ = false;
+  pending_delta_.resize(3);
+  delta_pending_ = false;
+  last_input_time_ = this->now();
+
+  init_parameters();
 
   /*****************************************************************************
   ** Initialise Subscribers
@@ -50,6 +57,16 @@ OpenManipulatorXTeleopJoystick::OpenManipulatorXTeleopJoystick()
   goal_tool_control_client_ = this->create_client<open_manipulator_msgs::srv::SetJointPosition>("goal_tool_control");
   goal_task_space_path_from_present_position_only_client_ = this->create_client<open_manipulator_msgs::srv::SetKinematicsPose>("goal_task_space_path_from_present_position_only");
 
+  /*****************************************************************************
+  ** Initialise Publishers
+  *****************************************************************************/
+  if (local_prediction_)
+  {
+    kinematics_pose_setpoint_pub_ = this->create_publisher<geometry_msgs::msg::PoseStamped>("kinematics_pose_setpoint", qos);
+    command_timer_ = this->create_wall_timer(
+      std::chrono::duration<double>(command_period_), std::bind(&OpenManipulatorXTeleopJoystick::command_callback, this));
+  }
+
   RCLCPP_INFO(this->get_logger(), "OpenManipulator-X Teleop Joystick Initialised");
 }
 
@@ -58,6 +75,23 @@ OpenManipulatorXTeleopJoystick::~OpenManipulatorXTeleopJoystick()
   RCLCPP_INFO(this->get_logger(), "OpenManipulator-X Teleop Joystick Terminated");
 }
 
+/*****************************************************************************
+** Init Functions
+*****************************************************************************/
+void OpenManipulatorXTeleopJoystick::init_parameters()
+{
+  this->declare_parameter("local_prediction");
+  this->declare_parameter("command_period");
+  this->declare_parameter("prediction_limit");
+  this->declare_parameter("prediction_timeout");
+
+  this->get_parameter_or<bool>("local_prediction", local_prediction_, false);
+  this->get_parameter_or<double>("command_period", command_period_, 0.05);
+  this->get_parameter_or<double>("prediction_limit", prediction_limit_, 0.05);
+  this->get_parameter_or<double>("prediction_timeout", prediction_timeout_, 1.0);
+  if (command_period_ < 0.01) command_period_ = 0.01;
+}
+
 /*****************************************************************************
 ** Callback Functions
 *****************************************************************************/
@@ -82,6 +116,8 @@ void OpenManipulatorXTeleopJoystick::kinematics_pose_callback(const open_manipul
   temp_position.push_back(msg->pose.position.y);
   temp_position.push_back(msg->pose.position.z);
   present_kinematic_position_ = temp_position;
+  present_kinematics_pose_ = msg->pose;
+  present_kinematics_pose_received_ = true;
 }
 
 void OpenManipulatorXTeleopJoystick::joy_callback(const sensor_msgs::msg::Joy::SharedPtr msg)
@@ -99,6 +135,51 @@ void OpenManipulatorXTeleopJoystick::joy_callback(const sensor_msgs::msg::Joy::S
   else if (msg->buttons.at(1) == 1) set_goal("gripper open");
 }
 
+void OpenManipulatorXTeleopJoystick::command_callback()
+{
+  if (delta_pending_ == false)
+  {
+    // Follow the arm again after the stick has been released for a while
+    if (target_initialized_ && (this->now() - last_input_time_).seconds() > prediction_timeout_)
+      target_initialized_ = false;
+    return;
+  }
+  delta_pending_ = false;
+
+  // The target pose starts from the present pose and then runs ahead of it,
+  // so it does not lag behind the goals already sent
+  if (target_initialized_ == false)
+  {
+    if (present_kinematics_pose_received_ == false)
+    {
+      pending_delta_.assign(3, 0.0);
+      return;
+    }
+    target_kinematics_pose_ = present_kinematics_pose_;
+    target_initialized_ = true;
+  }
+
+  double *target[3] = {&target_kinematics_pose_.position.x,
+                       &target_kinematics_pose_.position.y,
+                       &target_kinematics_pose_.position.z};
+  for (uint8_t i = 0; i < 3; i ++)
+  {
+    *target[i] += pending_delta_.at(i);
+    pending_delta_.at(i) = 0.0;
+
+    // Keep an unreachable target from running away from the arm
+    double present = present_kinematic_position_.at(i);
+    if (*target[i] > present + prediction_limit_) *target[i] = present + prediction_limit_;
+    if (*target[i] < present - prediction_limit_) *target[i] = present - prediction_limit_;
+  }
+
+  geometry_msgs::msg::PoseStamped msg;
+  msg.header.stamp = this->now();
+  msg.header.frame_id = "world";
+  msg.pose = target_kinematics_pose_;
+  kinematics_pose_setpoint_pub_->publish(msg);
+}
+
 /*****************************************************************************
 ** Callback Functions and Relevant Functions
 *****************************************************************************/
@@ -113,37 +194,37 @@ void OpenManipulatorXTeleopJoystick::set_goal(const char * str)
   {
     printf("increase(++) x axis in cartesian space\n");
     goalPose.at(0) = delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (!strcmp(str, "x-"))
   {
     printf("decrease(--) x axis in cartesian space\n");
     goalPose.at(0) = -delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (!strcmp(str, "y+"))
   {
     printf("increase(++) y axis in cartesian space\n");
     goalPose.at(1) = delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (!strcmp(str, "y-"))
   {
     printf("decrease(--) y axis in cartesian space\n");
     goalPose.at(1) = -delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (!strcmp(str, "z+"))
   {
     printf("increase(++) z axis in cartesian space\n");
     goalPose.at(2) = delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (!strcmp(str, "z-"))
   {
     printf("decrease(--) z axis in cartesian space\n");
     goalPose.at(2) = -delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (!strcmp(str, "gripper open"))
   {
@@ -191,6 +272,7 @@ bool OpenManipulatorXTeleopJoystick::set_joint_space_path(std::vector<std::strin
   request->joint_position.joint_name = joint_name;
   request->joint_position.position = joint_angle;
   request->path_time = path_time;
+  reset_target();
   
   using ServiceResponseFuture = rclcpp::Client<open_manipulator_msgs::srv::SetJointPosition>::SharedFuture;
   auto response_received_callback = [this](ServiceResponseFuture future) 
@@ -239,6 +321,29 @@ bool OpenManipulatorXTeleopJoystick::set_task_space_path_from_present_position_o
 
   return false;
 }
+
+void OpenManipulatorXTeleopJoystick::set_task_space_delta(std::vector<double> kinematics_pose, double path_time)
+{
+  if (local_prediction_ == false)
+  {
+    set_task_space_path_from_present_position_only(kinematics_pose, path_time);
+    return;
+  }
+
+  // Coalesced into one setpoint by command_callback
+  for (uint8_t i = 0; i < 3; i ++)
+    pending_delta_.at(i) += kinematics_pose.at(i);
+  delta_pending_ = true;
+  last_input_time_ = this->now();
+}
+
+void OpenManipulatorXTeleopJoystick::reset_target()
+{
+  // A joint space move takes the arm elsewhere, so start the next target from the present pose
+  target_initialized_ = false;
+  pending_delta_.assign(3, 0.0);
+  delta_pending_ = false;
+}
 }  // namespace open_manipulator_x_teleop_joystick
 
 /*****************************************************************************
@@ -31,6 +31,13 @@ OpenManipulatorXTeleopKeyboard::OpenManipulatorXTeleopKeyboard()
   ********************************************************************************/
   present_joint_angle_.resize(NUM_OF_JOINT);
   present_kinematic_position_.resize(3);
+  present_kinematics_pose_received_ = false;
+  target_initialized_ = false;
+  pending_delta_.resize(3);
+  delta_pending_ = false;
+  last_input_time_ = this->now();
+
+  init_parameters();
 
   /********************************************************************************
   ** Initialise Subscribers
@@ -54,10 +61,26 @@ OpenManipulatorXTeleopKeyboard::OpenManipulatorXTeleopKeyboard()
   goal_joint_space_path_from_present_client_ = this->create_client<open_manipulator_msgs::srv::SetJointPosition>(
     "goal_joint_space_path_from_present");
 
+  /********************************************************************************
+  ** Initialise Publishers
+  ********************************************************************************/
+  if (local_prediction_)
+  {
+    kinematics_pose_setpoint_pub_ = this->create_publisher<geometry_msgs::msg::PoseStamped>("kinematics_pose_setpoint", qos);
+    command_timer_ = this->create_wall_timer(
+      std::chrono::duration<double>(command_period_), std::bind(&OpenManipulatorXTeleopKeyboard::command_callback, this));
+  }
+
   /********************************************************************************
   ** Display in terminal
   ********************************************************************************/
   //this->disable_waiting_for_enter();
+  // Key presses are polled without blocking so the command timer keeps running
+  if (local_prediction_)
+  {
+    this->disable_waiting_for_enter();
+    this->print_text();
+  }
   update_timer_ = this->create_wall_timer(10ms, std::bind(&OpenManipulatorXTeleopKeyboard::update_callback, this));
 
   RCLCPP_INFO(this->get_logger(), "OpenManipulator-X Teleop Keyboard Initialised");
@@ -66,9 +89,27 @@ OpenManipulatorXTeleopKeyboard::OpenManipulatorXTeleopKeyboard()
 OpenManipulatorXTeleopKeyboard::~OpenManipulatorXTeleopKeyboard() 
 {
   //this->restore_terminal_settings();
+  if (local_prediction_) this->restore_terminal_settings();
   RCLCPP_INFO(this->get_logger(), "OpenManipulator-X Teleop Keyboard Terminated");
 }
 
+/********************************************************************************
+** Init Functions
+********************************************************************************/
+void OpenManipulatorXTeleopKeyboard::init_parameters()
+{
+  this->declare_parameter("local_prediction");
+  this->declare_parameter("command_period");
+  this->declare_parameter("prediction_limit");
+  this->declare_parameter("prediction_timeout");
+
+  this->get_parameter_or<bool>("local_prediction", local_prediction_, false);
+  this->get_parameter_or<double>("command_period", command_period_, 0.05);
+  this->get_parameter_or<double>("prediction_limit", prediction_limit_, 0.05);
+  this->get_parameter_or<double>("prediction_timeout", prediction_timeout_, 1.0);
+  if (command_period_ < 0.01) command_period_ = 0.01;
+}
+
 /********************************************************************************
 ** Callback Functions
 ********************************************************************************/
@@ -93,6 +134,53 @@ void OpenManipulatorXTeleopKeyboard::kinematics_pose_callback(const open_manipul
   temp_position.push_back(msg->pose.position.y);
   temp_position.push_back(msg->pose.position.z);
   present_kinematic_position_ = temp_position;
+  present_kinematics_pose_ = msg->pose;
+  present_kinematics_pose_received_ = true;
+}
+
+void OpenManipulatorXTeleopKeyboard::command_callback()
+{
+  if (delta_pending_ == false)
+  {
+    // Follow the arm again after the keys have been released for a while
+    if (target_initialized_ && (this->now() - last_input_time_).seconds() > prediction_timeout_)
+      target_initialized_ = false;
+    return;
+  }
+  delta_pending_ = false;
+
+  // The target pose starts from the present pose and then runs ahead of it,
+  // so it does not lag behind the goals already sent
+  if (target_initialized_ == false)
+  {
+    if (present_kinematics_pose_received_ == false)
+    {
+      pending_delta_.assign(3, 0.0);
+      return;
+    }
+    target_kinematics_pose_ = present_kinematics_pose_;
+    target_initialized_ = true;
+  }
+
+  double *target[3] = {&target_kinematics_pose_.position.x,
+                       &target_kinematics_pose_.position.y,
+                       &target_kinematics_pose_.position.z};
+  for (uint8_t i = 0; i < 3; i ++)
+  {
+    *target[i] += pending_delta_.at(i);
+    pending_delta_.at(i) = 0.0;
+
+    // Keep an unreachable target from running away from the arm
+    double present = present_kinematic_position_.at(i);
+    if (*target[i] > present + prediction_limit_) *target[i] = present + prediction_limit_;
+    if (*target[i] < present - prediction_limit_) *target[i] = present - prediction_limit_;
+  }
+
+  geometry_msgs::msg::PoseStamped msg;
+  msg.header.stamp = this->now();
+  msg.header.frame_id = "world";
+  msg.pose = target_kinematics_pose_;
+  kinematics_pose_setpoint_pub_->publish(msg);
 }
 
 /********************************************************************************
@@ -110,37 +198,37 @@ void OpenManipulatorXTeleopKeyboard::set_goal(char ch)
   {
     printf("input : w \tincrease(++) x axis in task space\n");
     goalPose.at(0) = delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (ch == 's' || ch == 'S')
   {
     printf("input : s \tdecrease(--) x axis in task space\n");
     goalPose.at(0) = -delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (ch == 'a' || ch == 'A')
   {
     printf("input : a \tincrease(++) y axis in task space\n");
     goalPose.at(1) = delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (ch == 'd' || ch == 'D')
   {
     printf("input : d \tdecrease(--) y axis in task space\n");
     goalPose.at(1) = -delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (ch == 'z' || ch == 'Z')
   {
     printf("input : z \tincrease(++) z axis in task space\n");
     goalPose.at(2) = delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (ch == 'x' || ch == 'X')
   {
     printf("input : x \tdecrease(--) z axis in task space\n");
     goalPose.at(2) = -delta;
-    set_task_space_path_from_present_position_only(goalPose, path_time);
+    set_task_space_delta(goalPose, path_time);
   }
   else if (ch == 'y' || ch == 'Y')
   {
@@ -276,6 +364,7 @@ bool OpenManipulatorXTeleopKeyboard::set_joint_space_path(std::vector<std::strin
   request->joint_position.joint_name = joint_name;
   request->joint_position.position = joint_angle;
   request->path_time = path_time;
+  reset_target();
   
   using ServiceResponseFuture = rclcpp::Client<open_manipulator_msgs::srv::SetJointPosition>::SharedFuture;
   auto response_received_callback = [this](ServiceResponseFuture future) 
@@ -331,6 +420,7 @@ bool OpenManipulatorXTeleopKeyboard::set_joint_space_path_from_present(std::vect
   request->joint_position.joint_name = joint_name;
   request->joint_position.position = joint_angle;
   request->path_time = path_time;
+  reset_target();
 
   using ServiceResponseFuture = rclcpp::Client<open_manipulator_msgs::srv::SetJointPosition>::SharedFuture;
   auto response_received_callback = [this](ServiceResponseFuture future) 
@@ -343,6 +433,29 @@ bool OpenManipulatorXTeleopKeyboard::set_joint_space_path_from_present(std::vect
   return false;
 }
 
+void OpenManipulatorXTeleopKeyboard::set_task_space_delta(std::vector<double> kinematics_pose, double path_time)
+{
+  if (local_prediction_ == false)
+  {
+    set_task_space_path_from_present_position_only(kinematics_pose, path_time);
+    return;
+  }
+
+  // Coalesced into one setpoint by command_callback
+  for (uint8_t i = 0; i < 3; i ++)
+    pending_delta_.at(i) += kinematics_pose.at(i);
+  delta_pending_ = true;
+  last_input_time_ = this->now();
+}
+
+void OpenManipulatorXTeleopKeyboard::reset_target()
+{
+  // A joint space move takes the arm elsewhere, so start the next target from the present pose
+  target_initialized_ = false;
+  pending_delta_.assign(3, 0.0);
+  delta_pending_ = false;
+}
+
 /********************************************************************************
 ** Other Functions
 ********************************************************************************/
@@ -386,6 +499,11 @@ void OpenManipulatorXTeleopKeyboard::print_text()
     get_present_kinematics_pose().at(0),
     get_present_kinematics_pose().at(1),
     get_present_kinematics_pose().at(2));
+  if (local_prediction_ && target_initialized_)
+    printf("Target Kinematics Position X: %.3lf Y: %.3lf Z: %.3lf\n",
+      target_kinematics_pose_.position.x,
+      target_kinematics_pose_.position.y,
+      target_kinematics_pose_.position.z);
   printf("---------------------------\n");  
 }
 
@@ -418,6 +536,21 @@ void OpenManipulatorXTeleopKeyboard::disable_waiting_for_enter()
 
 void OpenManipulatorXTeleopKeyboard::update_callback()  
 {
+  if (local_prediction_)
+  {
+    // Take every key that arrived since the last poll; they are sent together by command_callback
+    bool key_read = false;
+    int ch;
+    while ((ch = std::getchar()) != EOF)
+    {
+      this->set_goal(static_cast<char>(ch));
+      key_read = true;
+    }
+    clearerr(stdin);
+    if (key_read) this->print_text();
+    return;
+  }
+
   this->print_text();  
   
   char ch = std::getchar();